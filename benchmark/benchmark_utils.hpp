@@ -0,0 +1,55 @@
+#ifndef DET_RK3588__BENCHMARK_UTILS_HPP_
+#define DET_RK3588__BENCHMARK_UTILS_HPP_
+
+#include <stdio.h>
+
+#include <algorithm>
+#include <chrono>
+#include <vector>
+
+namespace det_rk3588
+{
+
+inline double NowUs()
+{
+  return std::chrono::duration<double, std::micro>(
+           std::chrono::steady_clock::now().time_since_epoch())
+    .count();
+}
+
+struct TimingStats
+{
+  double median;
+  double p99;
+  double mean;
+};
+
+inline TimingStats Summarize(std::vector<double> samples)
+{
+  TimingStats stats = {0.0, 0.0, 0.0};
+  if (samples.empty()) {
+    return stats;
+  }
+  std::sort(samples.begin(), samples.end());
+  size_t n = samples.size();
+  stats.median = n % 2 ? samples[n / 2] : 0.5 * (samples[n / 2 - 1] + samples[n / 2]);
+  stats.p99 = samples[std::min(n - 1, (n * 99 + 99) / 100 - 1)];
+  double sum = 0.0;
+  for (double s : samples) {
+    sum += s;
+  }
+  stats.mean = sum / n;
+  return stats;
+}
+
+inline void PrintStats(const char * name, const std::vector<double> & samples)
+{
+  TimingStats stats = Summarize(samples);
+  printf(
+    "  %-24s median %9.2f us  p99 %9.2f us  mean %9.2f us\n", name, stats.median, stats.p99,
+    stats.mean);
+}
+
+}  // namespace det_rk3588
+
+#endif  // DET_RK3588__BENCHMARK_UTILS_HPP_
@@ -0,0 +1,136 @@
+// Compares NmsEngine with the per-class NmsPerClass() loop on synthetic dense scenes.
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <random>
+#include <set>
+#include <vector>
+
+#include "benchmark_utils.hpp"
+#include "nms.hpp"
+
+#define SCENE_SIZE 640
+#define MAX_KEEP 64
+#define NMS_THRESHOLD 0.45f
+
+using namespace det_rk3588;
+
+struct Scene
+{
+  std::vector<float> box_x1;
+  std::vector<float> box_y1;
+  std::vector<float> box_x2;
+  std::vector<float> box_y2;
+  std::vector<int> class_ids;
+  std::vector<int> order;
+};
+
+// candidates cluster around objects the way a detector fires on neighbouring cells and anchors
+static Scene MakeScene(int candidate_num, int class_num, unsigned seed)
+{
+  std::mt19937 rng(seed);
+  std::uniform_real_distribution<float> pos(0.f, SCENE_SIZE);
+  std::uniform_real_distribution<float> size(12.f, 160.f);
+  std::normal_distribution<float> jitter(0.f, 0.08f);
+  std::uniform_int_distribution<int> cls(0, class_num - 1);
+
+  int object_num = std::max(1, candidate_num / 16);
+  std::vector<float> obj(object_num * 4);
+  std::vector<int> obj_cls(object_num);
+  for (int i = 0; i < object_num; ++i) {
+    obj[i * 4 + 2] = size(rng);
+    obj[i * 4 + 3] = size(rng);
+    obj[i * 4 + 0] = pos(rng) - obj[i * 4 + 2] / 2;
+    obj[i * 4 + 1] = pos(rng) - obj[i * 4 + 3] / 2;
+    obj_cls[i] = cls(rng);
+  }
+
+  Scene scene;
+  std::uniform_int_distribution<int> pick(0, object_num - 1);
+  std::uniform_real_distribution<float> unit(0.f, 1.f);
+  for (int i = 0; i < candidate_num; ++i) {
+    int o = pick(rng);
+    float w = obj[o * 4 + 2] * (1.f + jitter(rng));
+    float h = obj[o * 4 + 3] * (1.f + jitter(rng));
+    float x = obj[o * 4 + 0] + obj[o * 4 + 2] * jitter(rng);
+    float y = obj[o * 4 + 1] + obj[o * 4 + 3] * jitter(rng);
+    scene.box_x1.push_back(x);
+    scene.box_y1.push_back(y);
+    scene.box_x2.push_back(x + w);
+    scene.box_y2.push_back(y + h);
+    // a few candidates vote for another class
+    scene.class_ids.push_back(unit(rng) < 0.1f ? cls(rng) : obj_cls[o]);
+    scene.order.push_back(i);
+  }
+  // the candidate order stands in for the descending score order
+  std::shuffle(scene.order.begin(), scene.order.end(), rng);
+  return scene;
+}
+
+static int RunPerClass(const Scene & scene, std::vector<int> & order, int * keep)
+{
+  int count = (int)scene.order.size();
+  order = scene.order;
+  std::set<int> class_set(scene.class_ids.begin(), scene.class_ids.end());
+  for (int c : class_set) {
+    NmsPerClass(
+      count, scene.box_x1.data(), scene.box_y1.data(), scene.box_x2.data(), scene.box_y2.data(),
+      scene.class_ids.data(), order.data(), c, NMS_THRESHOLD);
+  }
+  int keep_count = 0;
+  for (int i = 0; i < count && keep_count < MAX_KEEP; ++i) {
+    if (order[i] != -1) {
+      keep[keep_count++] = order[i];
+    }
+  }
+  return keep_count;
+}
+
+int main(int argc, char ** argv)
+{
+  int iterations = argc > 1 ? atoi(argv[1]) : 200;
+  const int candidate_nums[] = {256, 1024, 4096};
+  const int class_nums[] = {3, 80};
+
+  for (int class_num : class_nums) {
+    for (int candidate_num : candidate_nums) {
+      Scene scene = MakeScene(candidate_num, class_num, candidate_num * 131 + class_num);
+      int count = (int)scene.order.size();
+      NmsEngine engine;
+      engine.Init(SCENE_SIZE, SCENE_SIZE, class_num);
+
+      std::vector<int> order;
+      int keep_ref[MAX_KEEP];
+      int keep[MAX_KEEP];
+      std::vector<double> per_class_us;
+      std::vector<double> engine_us;
+      int keep_ref_count = 0;
+      int keep_count = 0;
+      for (int it = 0; it < iterations; ++it) {
+        double t0 = NowUs();
+        keep_ref_count = RunPerClass(scene, order, keep_ref);
+        double t1 = NowUs();
+        keep_count = engine.Run(
+          scene.box_x1.data(), scene.box_y1.data(), scene.box_x2.data(), scene.box_y2.data(),
+          scene.class_ids.data(), scene.order.data(), count, NMS_THRESHOLD, MAX_KEEP, keep);
+        double t2 = NowUs();
+        per_class_us.push_back(t1 - t0);
+        engine_us.push_back(t2 - t1);
+      }
+
+      bool same = keep_count == keep_ref_count;
+      for (int i = 0; same && i < keep_count; ++i) {
+        same = keep[i] == keep_ref[i];
+      }
+      printf(
+        "candidates %d, classes %d, kept %d, keep set %s\n", candidate_num, class_num, keep_count,
+        same ? "identical" : "MISMATCH");
+      PrintStats("per-class Nms", per_class_us);
+      PrintStats("NmsEngine", engine_us);
+      if (!same) {
+        return 1;
+      }
+    }
+  }
+  return 0;
+}
@@ -0,0 +1,87 @@
+// Throughput and frame latency of RknnPool with the NV12 input path: preprocessing, pool
+// scheduling, inference and postprocessing. On a host build (-DRKNN_STUB=ON) the NPU is the stub
+// runtime, so RKNN_STUB_LATENCY_US and RKNN_STUB_JITTER_US set what the cores cost.
+// usage: pipeline_benchmark <model path> [frames] [threads] [frame width] [frame height] [models]
+//        [core strategy]
+// models 0, the default, gives every thread its own context, the core strategy is per-core,
+// all-cores or auto
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <queue>
+#include <vector>
+
+#include "benchmark_utils.hpp"
+#include "rknn_model.hpp"
+#include "rknn_pool.hpp"
+
+using namespace det_rk3588;
+
+int main(int argc, char ** argv)
+{
+  if (argc < 2) {
+    printf(
+      "usage: %s <model path> [frames] [threads] [frame width] [frame height] [models] "
+      "[core strategy]\n",
+      argv[0]);
+    return -1;
+  }
+  const char * model_path = argv[1];
+  int frames = argc > 2 ? atoi(argv[2]) : 600;
+  int threads = argc > 3 ? atoi(argv[3]) : 6;
+  int width = argc > 4 ? atoi(argv[4]) : 1920;
+  int height = argc > 5 ? atoi(argv[5]) : 1080;
+  int models = argc > 6 ? atoi(argv[6]) : 0;
+  RknnModelOptions options;
+  if (argc > 7 && ParseCoreStrategy(argv[7], &options.core_strategy) != 0) {
+    return -1;
+  }
+  if (
+    frames <= 0 || threads <= 0 || models < 0 || width <= 0 || height <= 0 || width % 2 ||
+    height % 2) {
+    printf("frames and threads must be positive, models not negative, the frame size even\n");
+    return -1;
+  }
+
+  RknnPool<RknnModel, Nv12Frame, DetectResultGroup> rknn_pool(
+    model_path, threads, options, models);
+  if (rknn_pool.Init(cv::Size(width, height)) != 0) {
+    printf("rknn pool init failed.\n");
+    return -1;
+  }
+
+  cv::Mat nv12(height * 3 / 2, width, CV_8UC1);
+  cv::randu(nv12, cv::Scalar(16), cv::Scalar(235));
+  Nv12Frame frame = WrapNv12(nv12);
+
+  // as many frames in flight as the pool has threads, like main_video
+  std::queue<double> put_times;
+  std::vector<double> latency_us;
+  DetectResultGroup group;
+  double start = NowUs();
+  for (int i = 0; i < frames; ++i) {
+    put_times.push(NowUs());
+    if (rknn_pool.Put(frame) != 0) {
+      return -1;
+    }
+    if (i >= threads - 1) {
+      if (rknn_pool.Get(group) != 0) {
+        return -1;
+      }
+      latency_us.push_back(NowUs() - put_times.front());
+      put_times.pop();
+    }
+  }
+  while (rknn_pool.Get(group) == 0) {
+    latency_us.push_back(NowUs() - put_times.front());
+    put_times.pop();
+  }
+  double elapsed = NowUs() - start;
+
+  printf(
+    "%d frames of %dx%d, %d threads, %d models %s: %.1f fps, last frame %d detections\n", frames,
+    width, height, threads, models > 0 ? models : threads,
+    CoreStrategyName(options.core_strategy), frames / elapsed * 1e6, group.count);
+  PrintStats("frame latency", latency_us);
+  return 0;
+}
@@ -0,0 +1,100 @@
+// Times the PostProcessor stages on synthetic int8 YOLOv5 outputs, no NPU needed.
+// usage: postprocess_benchmark [input size] [density] [class num] [decode threads] [iterations]
+// without arguments a default matrix of sizes, densities and class counts is run.
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <vector>
+
+#include "benchmark_utils.hpp"
+#include "postprocess.hpp"
+#include "test/synthetic_outputs.hpp"
+
+using namespace det_rk3588;
+
+static int RunCase(int input_size, float density, int class_num, int decode_threads, int iterations)
+{
+  SyntheticOutputs outputs;
+  MakeSyntheticOutputs(input_size, density, class_num, input_size * 7919 + class_num, &outputs);
+
+  HeadConfig head;
+  int ret = LoadHeadConfig(
+    "", "", input_size, input_size, outputs.attrs, SyntheticOutputs::kHeadNum, &head);
+  if (ret < 0) {
+    return -1;
+  }
+  PostProcessor post_processor;
+  post_processor.SetDecodeThreads(decode_threads);
+  ret = post_processor.Init(
+    input_size, input_size, head, outputs.attrs, SyntheticOutputs::kHeadNum);
+  if (ret < 0) {
+    return -1;
+  }
+  post_processor.EnableStageTimes(true);
+
+  int8_t * const * output_bufs = outputs.bufs;
+  // letterboxed 1920x1080 frame
+  BoxRect pads = {0, 0, (input_size - input_size * 1080 / 1920) / 2, 0};
+  float scale = (float)input_size / 1920;
+
+  std::vector<double> decode_us;
+  std::vector<double> sort_us;
+  std::vector<double> nms_us;
+  std::vector<double> map_us;
+  std::vector<double> total_us;
+  DetectResultGroup group;
+  // warm up caches and the decode threads
+  post_processor.Run(output_bufs, pads, scale, scale, &group);
+  for (int it = 0; it < iterations; ++it) {
+    double t0 = NowUs();
+    post_processor.Run(output_bufs, pads, scale, scale, &group);
+    double t1 = NowUs();
+    const StageTimes & times = post_processor.GetStageTimes();
+    decode_us.push_back(times.decode_us);
+    sort_us.push_back(times.sort_us);
+    nms_us.push_back(times.nms_us);
+    map_us.push_back(times.map_us);
+    total_us.push_back(t1 - t0);
+  }
+
+  printf(
+    "input %d, density %.4f, classes %d, decode threads %d, detections %d\n", input_size,
+    density, class_num, decode_threads, group.count);
+  PrintStats("decode", decode_us);
+  PrintStats("sort", sort_us);
+  PrintStats("nms", nms_us);
+  PrintStats("box mapping", map_us);
+  PrintStats("total", total_us);
+  return 0;
+}
+
+int main(int argc, char ** argv)
+{
+  if (argc > 1) {
+    int input_size = atoi(argv[1]);
+    float density = argc > 2 ? atof(argv[2]) : 0.01f;
+    int class_num = argc > 3 ? atoi(argv[3]) : 80;
+    int decode_threads = argc > 4 ? atoi(argv[4]) : 1;
+    int iterations = argc > 5 ? atoi(argv[5]) : 200;
+    if (input_size <= 0 || input_size % 32 != 0 || class_num <= 0 ||
+        class_num > OBJ_CLASS_MAX_NUM) {
+      printf("input size must be a multiple of 32 and class num in [1, %d]\n", OBJ_CLASS_MAX_NUM);
+      return -1;
+    }
+    return RunCase(input_size, density, class_num, decode_threads, iterations);
+  }
+
+  const int input_sizes[] = {640, 1280};
+  const float densities[] = {0.001f, 0.01f, 0.05f};
+  const int class_nums[] = {3, 80};
+  for (int input_size : input_sizes) {
+    for (int class_num : class_nums) {
+      for (float density : densities) {
+        if (RunCase(input_size, density, class_num, 1, 200) < 0) {
+          return -1;
+        }
+      }
+    }
+  }
+  return 0;
+}
@@ -0,0 +1,95 @@
+// Compares the cvtColor + LetterBox() chain with the fused LetterBoxBgrToRgb() kernel and with
+// LetterBoxBuffer, which only rewrites the active region once the border is in place.
+// NV12 frames compare a full resolution cvtColor to BGR with the NV12 LetterBoxBuffer path.
+// usage: preprocess_benchmark [model input size] [iterations]
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <algorithm>
+#include <vector>
+
+#include "benchmark_utils.hpp"
+#include "preprocess.hpp"
+
+using namespace det_rk3588;
+
+int main(int argc, char ** argv)
+{
+  int input_size = argc > 1 ? atoi(argv[1]) : 640;
+  int iterations = argc > 2 ? atoi(argv[2]) : 100;
+  const cv::Size frame_sizes[] = {cv::Size(1280, 720), cv::Size(1920, 1080), cv::Size(3840, 2160)};
+  cv::Size target_size(input_size, input_size);
+
+  for (const cv::Size & frame_size : frame_sizes) {
+    cv::Mat frame(frame_size, CV_8UC3);
+    cv::randu(frame, cv::Scalar(0, 0, 0), cv::Scalar(255, 255, 255));
+    // smooth the noise, bilinear rounding differences stay small on natural images
+    cv::GaussianBlur(frame, frame, cv::Size(5, 5), 0);
+    float scale = std::min(
+      (float)target_size.width / frame_size.width, (float)target_size.height / frame_size.height);
+
+    std::vector<double> chain_us;
+    std::vector<double> fused_us;
+    std::vector<double> buffer_us;
+    std::vector<double> nv12_chain_us;
+    std::vector<double> nv12_us;
+    LetterBoxBuffer buffer;
+    buffer.Init(target_size);
+    cv::Mat rgb;
+    cv::Mat padded;
+    std::vector<uint8_t> input(target_size.area() * 3);
+    BoxRect chain_pads;
+    BoxRect fused_pads;
+    cv::Mat yuv;
+    cv::cvtColor(frame, yuv, cv::COLOR_BGR2YUV_I420);
+    // I420 to NV12, interleave the U and V planes
+    cv::Mat nv12 = yuv.clone();
+    int luma_len = frame_size.area();
+    int chroma_len = luma_len / 4;
+    for (int i = 0; i < chroma_len; ++i) {
+      nv12.data[luma_len + i * 2] = yuv.data[luma_len + i];
+      nv12.data[luma_len + i * 2 + 1] = yuv.data[luma_len + chroma_len + i];
+    }
+    Nv12Frame nv12_frame = WrapNv12(nv12);
+    LetterBoxBuffer nv12_buffer;
+    nv12_buffer.Init(target_size);
+    cv::Mat bgr;
+    for (int it = 0; it < iterations; ++it) {
+      double t0 = NowUs();
+      cv::cvtColor(frame, rgb, cv::COLOR_BGR2RGB);
+      LetterBox(rgb, padded, chain_pads, scale, target_size);
+      double t1 = NowUs();
+      LetterBoxBgrToRgb(frame, input.data(), fused_pads, scale, target_size);
+      double t2 = NowUs();
+      buffer.Write(frame);
+      double t3 = NowUs();
+      cv::cvtColor(nv12, bgr, cv::COLOR_YUV2BGR_NV12);
+      nv12_buffer.Write(bgr);
+      double t4 = NowUs();
+      nv12_buffer.Write(nv12_frame);
+      double t5 = NowUs();
+      chain_us.push_back(t1 - t0);
+      fused_us.push_back(t2 - t1);
+      buffer_us.push_back(t3 - t2);
+      nv12_chain_us.push_back(t4 - t3);
+      nv12_us.push_back(t5 - t4);
+    }
+
+    cv::Mat fused(target_size, CV_8UC3, input.data());
+    cv::Mat diff;
+    cv::absdiff(padded, fused, diff);
+    double max_diff = 0.0;
+    cv::minMaxLoc(diff.reshape(1), nullptr, &max_diff);
+    bool same_pads = chain_pads.left == fused_pads.left && chain_pads.top == fused_pads.top &&
+                     chain_pads.right == fused_pads.right && chain_pads.bottom == fused_pads.bottom;
+    printf(
+      "%dx%d -> %dx%d, pads %s, max abs diff %.0f\n", frame_size.width, frame_size.height,
+      target_size.width, target_size.height, same_pads ? "identical" : "MISMATCH", max_diff);
+    PrintStats("cvtColor + LetterBox", chain_us);
+    PrintStats("LetterBoxBgrToRgb", fused_us);
+    PrintStats("LetterBoxBuffer", buffer_us);
+    PrintStats("NV12 cvtColor + LetterBoxBuffer", nv12_chain_us);
+    PrintStats("NV12 LetterBoxBuffer", nv12_us);
+  }
+  return 0;
+}
@@ -0,0 +1,68 @@
+// Compares cv::resize() with BilinearResizer on the letterbox geometry of a 1080p stream.
+// usage: resize_benchmark [source width] [source height] [model input size] [iterations]
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <algorithm>
+#include <vector>
+
+#include "benchmark_utils.hpp"
+#include "preprocess.hpp"
+
+using namespace det_rk3588;
+
+int main(int argc, char ** argv)
+{
+  int src_w = argc > 1 ? atoi(argv[1]) : 1920;
+  int src_h = argc > 2 ? atoi(argv[2]) : 1080;
+  int input_size = argc > 3 ? atoi(argv[3]) : 640;
+  int iterations = argc > 4 ? atoi(argv[4]) : 200;
+
+  cv::Mat frame(src_h, src_w, CV_8UC3);
+  cv::randu(frame, cv::Scalar(0, 0, 0), cv::Scalar(255, 255, 255));
+  cv::GaussianBlur(frame, frame, cv::Size(5, 5), 0);
+  float scale = std::min((float)input_size / src_w, (float)input_size / src_h);
+
+  LetterBoxGeometry geometry;
+  if (GetLetterBoxGeometry(frame.size(), cv::Size(input_size, input_size), scale, &geometry) < 0) {
+    return -1;
+  }
+  const cv::Size & dst_size = geometry.resized_size;
+  cv::Mat reference;
+  cv::Mat resized(dst_size, CV_8UC3);
+  BilinearResizer cached;
+  cached.Prepare(frame.size(), dst_size, scale);
+
+  std::vector<double> opencv_us;
+  std::vector<double> cached_us;
+  std::vector<double> rebuilt_us;
+  for (int it = 0; it < iterations; ++it) {
+    double t0 = NowUs();
+    cv::resize(frame, reference, cv::Size(), scale, scale);
+    double t1 = NowUs();
+    cached.Run(frame, resized.data, resized.step, false);
+    double t2 = NowUs();
+    // what a per-call resize pays, tables built from scratch every time
+    BilinearResizer rebuilt;
+    rebuilt.Prepare(frame.size(), dst_size, scale);
+    rebuilt.Run(frame, resized.data, resized.step, false);
+    double t3 = NowUs();
+    opencv_us.push_back(t1 - t0);
+    cached_us.push_back(t2 - t1);
+    rebuilt_us.push_back(t3 - t2);
+  }
+
+  double max_diff = -1.0;
+  if (reference.size() == resized.size()) {
+    cv::Mat diff;
+    cv::absdiff(reference, resized, diff);
+    cv::minMaxLoc(diff.reshape(1), nullptr, &max_diff);
+  }
+  printf(
+    "%dx%d -> %dx%d, max abs diff to cv::resize %.0f\n", src_w, src_h, dst_size.width,
+    dst_size.height, max_diff);
+  PrintStats("cv::resize", opencv_us);
+  PrintStats("BilinearResizer cached", cached_us);
+  PrintStats("BilinearResizer rebuilt", rebuilt_us);
+  return max_diff < 0.0 ? 1 : 0;
+}
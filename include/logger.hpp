@@ -0,0 +1,219 @@
+#ifndef DET_RK3588__LOGGER_HPP_
+#define DET_RK3588__LOGGER_HPP_
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+
+namespace det_rk3588
+{
+
+enum class LogLevel
+{
+  kDebug,
+  kInfo,
+  kWarn,
+  kError,
+};
+
+// printf checking of the LOG_* arguments at compile time, never called
+inline void CheckLogFormat(const char *, ...) __attribute__((format(printf, 1, 2)));
+
+inline void CheckLogFormat(const char *, ...) {}
+
+// Process wide logger for the inference threads. Log() claims a slot of a fixed ring with a
+// compare-and-swap and stores the format pointer and the arguments in it, and a drain thread
+// formats the slots and writes them in order. Integers, floating point values and pointers are
+// stored by value and strings are copied into the slot, so a caller pays for the claim and a few
+// stores, never for the formatting, and the format has to be a literal, as the LOG_* macros
+// check. No caller waits on a stream: when the ring is full the message is dropped and counted,
+// and the drain thread reports the losses. The drain thread sleeps on a condition variable once
+// the ring is empty and the next message wakes it, only that message takes a lock, to notify, and
+// a timed wait backs the wakeup up.
+class Logger
+{
+public:
+  static constexpr int kSlotNum = 1024;  // a power of two
+  static constexpr int kMessageSize = 256;
+  static constexpr int kMaxArgs = 8;
+
+  static Logger & Instance();
+
+  ~Logger();
+
+  Logger(const Logger &) = delete;
+  Logger & operator=(const Logger &) = delete;
+
+  // messages below level are discarded at the call site, kInfo by default
+  void SetLevel(LogLevel level);
+
+  bool Enabled(LogLevel level) const;
+
+  // kDebug and kInfo go to out, kWarn, kError and the drop reports to err, stdout and stderr by
+  // default
+  void SetStreams(FILE * out, FILE * err);
+
+  template <typename... Args>
+  void Log(LogLevel level, const char * format, Args... args);
+
+  // writes everything logged so far from the calling thread
+  void Flush();
+
+  uint64_t GetDroppedCount() const;
+
+private:
+  struct Arg
+  {
+    enum class Type
+    {
+      kInt,
+      kUint,
+      kDouble,
+      kString,  // offset of the copy in Slot::text
+      kPointer,
+    };
+    Type type;
+    union
+    {
+      long long i;
+      unsigned long long u;
+      double d;
+      int offset;
+      const void * p;
+    };
+  };
+
+  // sequence == position: free for the producer of that position, position + 1: written
+  struct Slot
+  {
+    std::atomic<uint64_t> sequence;
+    LogLevel level;
+    const char * format;
+    int arg_num;
+    Arg args[kMaxArgs];
+    // the string arguments, each NUL terminated
+    int text_size;
+    char text[kMessageSize];
+  };
+
+  Logger();
+
+  // the slot at head_ and its position, nullptr when the ring is full
+  Slot * Claim(uint64_t * pos);
+
+  template <typename T>
+  static typename std::enable_if<std::is_integral<T>::value && std::is_signed<T>::value>::type
+  Capture(Slot & slot, T value)
+  {
+    Arg & arg = slot.args[slot.arg_num++];
+    arg.type = Arg::Type::kInt;
+    arg.i = value;
+  }
+
+  template <typename T>
+  static typename std::enable_if<std::is_integral<T>::value && std::is_unsigned<T>::value>::type
+  Capture(Slot & slot, T value)
+  {
+    Arg & arg = slot.args[slot.arg_num++];
+    arg.type = Arg::Type::kUint;
+    arg.u = value;
+  }
+
+  // printf takes the unscoped enums as their underlying integer
+  template <typename T>
+  static typename std::enable_if<std::is_enum<T>::value>::type Capture(Slot & slot, T value)
+  {
+    Capture(slot, static_cast<typename std::underlying_type<T>::type>(value));
+  }
+
+  template <typename T>
+  static typename std::enable_if<std::is_floating_point<T>::value>::type Capture(
+    Slot & slot, T value)
+  {
+    Arg & arg = slot.args[slot.arg_num++];
+    arg.type = Arg::Type::kDouble;
+    arg.d = value;
+  }
+
+  static void Capture(Slot & slot, const char * value);
+
+  static void Capture(Slot & slot, const void * value);
+
+  // the message of a written slot into line, returns its size
+  static int Format(const Slot & slot, char * line);
+
+  void Drain();
+
+  // the drain thread found the ring empty and waits, called by the message that ends it
+  void Wake();
+
+  // writes the written slots, returns how many, called with drain_mutex_ held
+  int DrainOnce();
+
+  std::unique_ptr<Slot[]> slots_;
+  std::atomic<uint64_t> head_;
+  std::atomic<uint64_t> dropped_;
+  std::atomic<int> level_;
+  std::atomic<bool> quit_;
+  // the drain thread is about to wait or waits for woken_
+  std::atomic<bool> sleeping_;
+  std::mutex wake_mutex_;
+  std::condition_variable wake_cv_;
+  bool woken_;
+  // the consumer side: tail_, the dropped count already reported and the streams
+  std::mutex drain_mutex_;
+  uint64_t tail_;
+  uint64_t reported_dropped_;
+  FILE * out_;
+  FILE * err_;
+  std::thread thread_;
+};
+
+template <typename... Args>
+void Logger::Log(LogLevel level, const char * format, Args... args)
+{
+  static_assert(sizeof...(Args) <= kMaxArgs, "too many log arguments");
+  if (!Enabled(level)) {
+    return;
+  }
+  uint64_t pos;
+  Slot * slot = Claim(&pos);
+  if (slot == nullptr) {
+    return;
+  }
+  slot->level = level;
+  slot->format = format;
+  slot->arg_num = 0;
+  slot->text_size = 0;
+  int captured[] = {0, (Capture(*slot, args), 0)...};
+  (void)captured;
+  // sequentially consistent like the idle check of Drain(), either it sees this slot or this sees
+  // it sleeping
+  slot->sequence.store(pos + 1, std::memory_order_seq_cst);
+  if (sleeping_.load(std::memory_order_seq_cst)) {
+    Wake();
+  }
+}
+
+}  // namespace det_rk3588
+
+#define DET_RK3588_LOG(level, ...)                              \
+  do {                                                          \
+    if (false) {                                                \
+      ::det_rk3588::CheckLogFormat(__VA_ARGS__);                \
+    }                                                           \
+    ::det_rk3588::Logger::Instance().Log(level, __VA_ARGS__);   \
+  } while (0)
+
+#define LOG_DEBUG(...) DET_RK3588_LOG(::det_rk3588::LogLevel::kDebug, __VA_ARGS__)
+#define LOG_INFO(...) DET_RK3588_LOG(::det_rk3588::LogLevel::kInfo, __VA_ARGS__)
+#define LOG_WARN(...) DET_RK3588_LOG(::det_rk3588::LogLevel::kWarn, __VA_ARGS__)
+#define LOG_ERROR(...) DET_RK3588_LOG(::det_rk3588::LogLevel::kError, __VA_ARGS__)
+
+#endif  // DET_RK3588__LOGGER_HPP_
@@ -0,0 +1,38 @@
+#ifndef DET_RK3588__MODEL_LOADER_HPP_
+#define DET_RK3588__MODEL_LOADER_HPP_
+
+#include <stddef.h>
+
+namespace det_rk3588
+{
+
+// Read-only mapping of a .rknn file for rknn_init(). The pages come from the page cache, so
+// nothing is copied on load and several processes loading the same model share them. The
+// runtime copies the model by the time rknn_init() returns, so the mapping can be closed then
+// and is not resident for the lifetime of the context.
+class ModelFile
+{
+public:
+  ModelFile();
+
+  ~ModelFile();
+
+  ModelFile(const ModelFile &) = delete;
+  ModelFile & operator=(const ModelFile &) = delete;
+
+  int Open(const char * path);
+
+  void Close();
+
+  void * GetData() const { return data_; }
+
+  size_t GetSize() const { return size_; }
+
+private:
+  void * data_;
+  size_t size_;
+};
+
+}  // namespace det_rk3588
+
+#endif  // DET_RK3588__MODEL_LOADER_HPP_
@@ -0,0 +1,63 @@
+#ifndef DET_RK3588__NMS_HPP_
+#define DET_RK3588__NMS_HPP_
+
+#include <stdint.h>
+
+#include <vector>
+
+namespace det_rk3588
+{
+
+// Greedy class-aware NMS over candidates sorted by descending score, for all classes in one
+// pass. Kept boxes are registered in a coarse spatial grid and in a per-class bitmask, so each
+// candidate is only compared with the kept boxes of its class that share a grid cell with it.
+// Those comparisons run on SIMD blocks of the structure-of-arrays kept boxes. The keep set
+// matches running NmsPerClass() once per class, truncated to max_keep.
+class NmsEngine
+{
+public:
+  static constexpr int kMaxKeep = 64;
+  static constexpr int kDefaultCellSize = 64;
+  // kept boxes tested per step of the IoU kernel
+  static constexpr int kIouBlock = 8;
+
+  NmsEngine();
+
+  // width/height of the box coordinate space, boxes outside it fall into the border cells
+  void Init(int width, int height, int class_num, int cell_size = kDefaultCellSize);
+
+  // boxes are given by their corners, order holds count candidate indices sorted by score, the
+  // indices of the kept candidates are written to keep in score order and their number is returned
+  int Run(
+    const float * box_x1, const float * box_y1, const float * box_x2, const float * box_y2,
+    const int * class_ids, const int * order, int count, float threshold, int max_keep,
+    int * keep);
+
+private:
+  int CellIndex(float v, int cell_num) const;
+
+  uint64_t OverlapMask(
+    float x1, float y1, float x2, float y2, float threshold, uint64_t candidates) const;
+
+  int cols_;
+  int rows_;
+  float inv_cell_size_;
+
+  std::vector<uint64_t> cell_masks_;
+  std::vector<uint64_t> class_masks_;
+
+  float kept_x1_[kMaxKeep];
+  float kept_y1_[kMaxKeep];
+  float kept_x2_[kMaxKeep];
+  float kept_y2_[kMaxKeep];
+  float kept_area_[kMaxKeep];
+};
+
+// reference per-class NMS, suppressed entries of order are set to -1
+int NmsPerClass(
+  int valid_count, const float * box_x1, const float * box_y1, const float * box_x2,
+  const float * box_y2, const int * class_ids, int * order, int filter_id, float threshold);
+
+}  // namespace det_rk3588
+
+#endif  // DET_RK3588__NMS_HPP_
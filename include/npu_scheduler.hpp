@@ -0,0 +1,53 @@
+#ifndef DET_RK3588__NPU_SCHEDULER_HPP_
+#define DET_RK3588__NPU_SCHEDULER_HPP_
+
+#include <mutex>
+
+#include "rknn_api.h"
+
+#define RK3588_CORE_NUM 3
+
+namespace det_rk3588
+{
+
+// how the contexts of a process are placed on the NPU cores
+enum class CoreStrategy
+{
+  kPerCore,   // each context on one core, the core with the fewest contexts, for throughput
+  kAllCores,  // RKNN_NPU_CORE_0_1_2, one inference split over all cores, for single stream latency
+  kAuto,      // RKNN_NPU_CORE_AUTO, the runtime picks an idle core per run
+};
+
+const char * CoreStrategyName(CoreStrategy strategy);
+
+// "per-core", "all-cores" or "auto", -1 for anything else
+int ParseCoreStrategy(const char * name, CoreStrategy * strategy);
+
+// Process wide count of the contexts bound to each NPU core. Acquire() picks the core mask of a
+// new context by strategy and reports the decision, Release() takes the context off its cores
+// again when it is destroyed.
+class NpuCoreScheduler
+{
+public:
+  static NpuCoreScheduler & Instance();
+
+  rknn_core_mask Acquire(CoreStrategy strategy);
+
+  void Release(rknn_core_mask core_mask);
+
+  // contexts bound to core, the auto ones are not counted on any core
+  int GetContextNum(int core);
+
+  int GetAutoContextNum();
+
+private:
+  NpuCoreScheduler();
+
+  std::mutex mutex_;
+  int context_num_[RK3588_CORE_NUM];
+  int auto_context_num_;
+};
+
+}  // namespace det_rk3588
+
+#endif  // DET_RK3588__NPU_SCHEDULER_HPP_
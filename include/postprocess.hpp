@@ -3,14 +3,24 @@
 
 #include <stdint.h>
 
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <thread>
 #include <vector>
 
+#include "nms.hpp"
+#include "rknn_api.h"
+
+#define LABEL_NALE_TXT_PATH "./model/labels_list.txt"
+
 #define OBJ_NAME_MAX_SIZE 16
 #define OBJ_NUMB_MAX_SIZE 64
-#define OBJ_CLASS_NUM 3
+#define OBJ_CLASS_MAX_NUM 256
+#define OBJ_HEAD_MAX_NUM 4
+#define OBJ_ANCHOR_NUM 3
 #define NMS_THRESH 0.45
 #define BOX_THRESH 0.25
-#define PROP_BOX_SIZE (5 + OBJ_CLASS_NUM)
 
 namespace det_rk3588
 {
@@ -26,6 +36,7 @@ struct BoxRect
 struct DetectResult
 {
   char name[OBJ_NAME_MAX_SIZE];
+  int class_id;
   BoxRect box;
   float prop;
 };
@@ -37,12 +48,207 @@ struct DetectResultGroup
   DetectResult results[OBJ_NUMB_MAX_SIZE];
 };
 
-int PostProcess(
-  int8_t * input0, int8_t * input1, int8_t * input2, int model_in_h, int model_in_w,
-  float conf_threshold, float nms_threshold, BoxRect pads, float scale_w, float scale_h,
-  std::vector<int32_t> & qnt_zps, std::vector<float> & qnt_scales, DetectResultGroup * group);
+// Layout of the detection heads. Read from a "<model>.head" sidecar file or the model's
+// RKNN_QUERY_CUSTOM_STRING, e.g.
+//   classes=80;strides=8,16,32;anchors=10,13,16,30,33,23|30,61,62,45,59,119|116,90,...
+// Entries may also be separated by newlines. Missing entries are taken from the output attrs
+// (classes, strides) and from the default YOLOv5 P5/P6 anchors (anchors).
+struct HeadConfig
+{
+  int class_num;
+  int head_num;
+  int strides[OBJ_HEAD_MAX_NUM];
+  int anchors[OBJ_HEAD_MAX_NUM][OBJ_ANCHOR_NUM * 2];
+};
+
+// dequantized values of every int8 code of one output tensor, indexed by (uint8_t)code
+struct DequantTable
+{
+  float raw[256];  // (q - zp) * scale
+  float xy[256];   // raw * 2 - 0.5, box center offset
+  float wh[256];   // (raw * 2)^2, box size factor
+};
+
+// parse the text form of HeadConfig, entries not present are left at zero
+int ParseHeadConfig(const char * text, HeadConfig * head);
+
+// resolve the head layout of a model, the sidecar file takes priority over custom_string
+int LoadHeadConfig(
+  const char * model_path, const char * custom_string, int model_in_h, int model_in_w,
+  const rknn_tensor_attr * output_attrs, int n_output, HeadConfig * head);
+
+// collect the indices of the cells whose quantized objectness is >= threshold, in ascending order
+int ScanObjectness(const int8_t * conf, int count, int8_t threshold, int * indices);
+
+// scalar reference of ScanObjectness(), both return the same indices
+int ScanObjectnessScalar(const int8_t * conf, int count, int8_t threshold, int * indices);
+
+// wall time of the stages of one PostProcessor::Run()
+struct StageTimes
+{
+  double decode_us;  // objectness scan, class and box decode, merge of the bands
+  double sort_us;    // pre-NMS top-K and score sort
+  double nms_us;     // class-aware NMS
+  double map_us;     // letterbox removal, scaling to the source image, labels
+};
+
+// Decodes the YOLOv5 heads into a DetectResultGroup. The candidate storage is sized once in
+// Init() from the output attrs and reused by every Run(), so steady state does not allocate.
+// All state, labels and head config included, belongs to the instance: every model owns its own
+// PostProcessor and any number of them run concurrently, one Run() at a time per instance.
+class PostProcessor
+{
+public:
+  static constexpr int kMaxHeadNum = OBJ_HEAD_MAX_NUM;
+  static constexpr int kDefaultPreNmsTopK = 1024;
+
+  PostProcessor();
+
+  ~PostProcessor();
+
+  PostProcessor(const PostProcessor &) = delete;
+  PostProcessor & operator=(const PostProcessor &) = delete;
+
+  // keep only the pre_nms_top_k best candidates before sorting and NMS, and at most max_per_head
+  // candidates from each stride head, a value <= 0 disables the limit
+  void SetCandidateLimits(int pre_nms_top_k, int max_per_head);
+
+  // Decode the heads on num_threads threads, the largest head is cut into row bands. Every band
+  // has its own slice of the candidate storage and the slices are merged in a fixed order, so the
+  // results are the same as with the default of 1, which decodes on the calling thread only.
+  // The num_threads - 1 workers are started here and keep their bands from frame to frame, a
+  // Run() only wakes them and waits for them, so it does not allocate with more threads either.
+  void SetDecodeThreads(int num_threads);
+
+  // output_attrs may describe the NCHW outputs or the native NHWC / NC1HWC2 ones
+  int Init(
+    int model_in_h, int model_in_w, const HeadConfig & head, const rknn_tensor_attr * output_attrs,
+    int n_output);
+
+  const HeadConfig & GetHeadConfig() const { return head_; }
+
+  // one label per line, classes without a label are named "unknown"
+  int LoadLabels(const char * path);
+
+  // The score filters below are converted to int8 thresholds per head as soon as they are set, so
+  // Run() compares raw outputs only. They may be changed between two Run() calls, not during one.
 
-void DeinitPostProcess();
+  // conf_threshold applies to every class without a threshold of its own
+  void SetThresholds(float conf_threshold, float nms_threshold);
+
+  // a negative threshold falls back to conf_threshold
+  int SetClassThreshold(int class_id, float threshold);
+
+  int SetClassEnabled(int class_id, bool enabled);
+
+  // enable only the listed classes, an empty list enables all of them
+  int SetClassAllowList(const std::vector<int> & class_ids);
+
+  int Run(
+    int8_t * const * outputs, BoxRect pads, float scale_w, float scale_h,
+    DetectResultGroup * group);
+
+  // time the stages of every Run(), off by default, the times of the last call are kept
+  void EnableStageTimes(bool enable);
+
+  const StageTimes & GetStageTimes() const { return stage_times_; }
+
+private:
+  // rows of one head, candidates of anchor a go to base + a * grid_len + cell, where cell is in
+  // [cell_begin, cell_end)
+  struct DecodeTask
+  {
+    int head;
+    int8_t * input;
+    int cell_begin;
+    int cell_end;
+    int base;
+    int scan_base;
+    int counts[OBJ_ANCHOR_NUM];
+  };
+
+  void UpdateQuantizedThresholds();
+
+  void BuildDecodeTasks();
+
+  void StartDecodeWorkers();
+
+  void StopDecodeWorkers();
+
+  // generation is the one of the last Decode() before the worker started
+  void DecodeWorker(int worker, unsigned generation);
+
+  // the bands of worker w are the tasks t with t % decode_threads_ == w, worker 0 is the caller
+  void DecodeBands(int worker);
+
+  void Decode(int8_t * const * outputs);
+
+  void DecodeBand(DecodeTask * task);
+
+  // kClassNum > 0 is a compile time specialization of head_.class_num
+  template <int kClassNum>
+  void DecodeHead(DecodeTask * task);
+
+  // decoder for the native NHWC / NC1HWC2 output layouts
+  template <int kClassNum>
+  void DecodeHeadInterleaved(DecodeTask * task);
+
+  void MoveCandidates(int src, int dst, int count);
+
+  int KeepTopK(int start, int count, int k);
+
+  int model_in_h_;
+  int model_in_w_;
+  int n_output_;
+  int pre_nms_top_k_;
+  int max_per_head_;
+  HeadConfig head_;
+  std::vector<std::string> labels_;
+  int grid_h_[kMaxHeadNum];
+  int grid_w_[kMaxHeadNum];
+  int cell_strides_[kMaxHeadNum];
+  std::vector<int> channel_offsets_[kMaxHeadNum];
+  int32_t zps_[kMaxHeadNum];
+  float scales_[kMaxHeadNum];
+  DequantTable tables_[kMaxHeadNum];
+
+  // score filters, float as set and quantized per head
+  float conf_threshold_;
+  float nms_threshold_;
+  bool any_class_enabled_;
+  std::vector<float> class_thresholds_;
+  std::vector<uint8_t> class_enabled_;
+  int8_t obj_thresholds_i8_[kMaxHeadNum];
+  std::vector<int8_t> class_thresholds_i8_[kMaxHeadNum];
+
+  int decode_threads_;
+  std::vector<DecodeTask> tasks_;
+  // a reusable barrier: Decode() bumps the generation to start the workers and waits until
+  // decode_pending_ drops to 0
+  std::vector<std::thread> decode_workers_;
+  std::mutex decode_mutex_;
+  std::condition_variable decode_start_cv_;
+  std::condition_variable decode_done_cv_;
+  unsigned decode_generation_;
+  int decode_pending_;
+  bool decode_quit_;
+  bool stage_times_enabled_;
+  StageTimes stage_times_;
+
+  // structure-of-arrays candidate storage, boxes are kept as corners
+  int valid_count_;
+  std::vector<float> box_x1_;
+  std::vector<float> box_y1_;
+  std::vector<float> box_x2_;
+  std::vector<float> box_y2_;
+  std::vector<float> obj_probs_;
+  std::vector<int> class_ids_;
+  std::vector<int> order_;
+  std::vector<int> cell_indices_;
+
+  NmsEngine nms_;
+  int keep_[OBJ_NUMB_MAX_SIZE];
+};
 
 }  // namespace det_rk3588
 
@@ -1,8 +1,11 @@
 #ifndef DET_RK3588__PREPROCESS_HPP_
 #define DET_RK3588__PREPROCESS_HPP_
 
+#include <stdint.h>
 #include <stdio.h>
 
+#include <vector>
+
 #include <opencv2/opencv.hpp>
 
 #include "im2d.h"
@@ -16,6 +19,109 @@ void LetterBox(
   const cv::Mat & image, cv::Mat & padded_image, BoxRect & pads, const float scale,
   const cv::Size & target_size, const cv::Scalar & pad_color = cv::Scalar(128, 128, 128));
 
+// placement of a source image in the letterboxed model input
+struct LetterBoxGeometry
+{
+  cv::Size src_size;
+  cv::Size target_size;
+  cv::Size resized_size;
+  float scale;
+  BoxRect pads;
+};
+
+int GetLetterBoxGeometry(
+  const cv::Size & src_size, const cv::Size & target_size, const float scale,
+  LetterBoxGeometry * geometry);
+
+// Single pass replacement of cvtColor(BGR2RGB) + LetterBox(): the BGR image is resized by scale
+// with bilinear interpolation, swapped to RGB and written centred into dst, a packed
+// target_size RGB buffer, whose border is filled with pad_value.
+int LetterBoxBgrToRgb(
+  const cv::Mat & image, uint8_t * dst, BoxRect & pads, const float scale,
+  const cv::Size & target_size, uint8_t pad_value = 128);
+
+// Bilinear resize of 8-bit images with 1 to 3 channels and the pixel mapping of
+// cv::resize(INTER_LINEAR). The tap offsets and the fixed-point weights, Q8 horizontal and Q15
+// vertical, are built once per (src size, dst size, scale, channels) by Prepare(), so Run() is a
+// table lookup per column followed by a SIMD vertical blend per row, without allocating.
+class BilinearResizer
+{
+public:
+  BilinearResizer();
+
+  // rebuilds the tables only when the geometry differs from the cached one
+  int Prepare(
+    const cv::Size & src_size, const cv::Size & dst_size, float scale, int channels = 3);
+
+  // dst is a dst_size region with dst_stride bytes per row, swap_rb turns BGR into RGB and is
+  // ignored below 3 channels
+  void Run(const cv::Mat & image, uint8_t * dst, size_t dst_stride, bool swap_rb);
+
+private:
+  cv::Size src_size_;
+  cv::Size dst_size_;
+  float scale_;
+  int channels_;
+  std::vector<int> x_taps_;
+  std::vector<uint16_t> x_weights_;
+  std::vector<int> y_taps_;
+  std::vector<uint16_t> y_weights_;
+  std::vector<uint16_t> rows_;
+};
+
+// NV12 frame as decoders and camera pipelines deliver it: a full resolution Y plane and an
+// interleaved UV plane at half resolution in each direction. The planes are cv::Mat headers, so
+// a frame can wrap decoder buffers with any stride and is cheap to copy into a RknnPool task.
+struct Nv12Frame
+{
+  cv::Mat y;   // CV_8UC1, width x height
+  cv::Mat uv;  // CV_8UC2, width / 2 x height / 2, U first
+};
+
+// planes of a contiguous (height * 3 / 2) x width CV_8UC1 NV12 image, the layout cv::cvtColor()
+// takes, empty planes when nv12 does not have it
+Nv12Frame WrapNv12(const cv::Mat & nv12);
+
+// Model input buffer that keeps its letterbox border between frames. The geometry, pads and
+// scale included, is computed again only when the source size changes, the border is filled at
+// that point and every Write() rewrites the scaled image region alone.
+class LetterBoxBuffer
+{
+public:
+  LetterBoxBuffer();
+
+  int Init(const cv::Size & target_size, uint8_t pad_value = 128);
+
+  // writes into external memory instead, e.g. an NPU input tensor, with stride bytes per row
+  int Init(const cv::Size & target_size, uint8_t * data, size_t stride, uint8_t pad_value = 128);
+
+  // BGR image to the RGB active region
+  int Write(const cv::Mat & image);
+
+  // NV12 frame to the RGB active region, both planes are downscaled first and converted to RGB
+  // at model resolution
+  int Write(const Nv12Frame & frame);
+
+  const LetterBoxGeometry & GetGeometry() const { return geometry_; }
+
+  uint8_t * GetData() { return data_; }
+
+private:
+  int UpdateGeometry(const cv::Size & src_size);
+
+  bool ready_;
+  uint8_t pad_value_;
+  LetterBoxGeometry geometry_;
+  BilinearResizer resizer_;
+  BilinearResizer luma_resizer_;
+  BilinearResizer chroma_resizer_;
+  std::vector<uint8_t> luma_;
+  std::vector<uint8_t> chroma_;
+  uint8_t * data_;
+  size_t stride_;
+  std::vector<uint8_t> buffer_;
+};
+
 int ResizeRga(
   rga_buffer_t & src, rga_buffer_t & dst, const cv::Mat & image, cv::Mat & resized_image,
   const cv::Size & target_size);
@@ -1,31 +1,93 @@
 #ifndef DET_RK3588__RKNN_MODEL_HPP_
 #define DET_RK3588__RKNN_MODEL_HPP_
 
+#include <condition_variable>
+#include <deque>
 #include <mutex>
+#include <string>
+#include <vector>
 
+#include "npu_scheduler.hpp"
 #include "opencv2/core/core.hpp"
+#include "postprocess.hpp"
+#include "preprocess.hpp"
 #include "rknn_api.h"
-
-#define RK3588_CORE_NUM 3
+#include "tiling.hpp"
 
 namespace det_rk3588
 {
-int GetCoreNum();
+
+// layout the model outputs are read in
+enum class OutputLayout
+{
+  kNchw,     // converted to NCHW by the runtime
+  kNc1hwc2,  // native NPU layout, bound with rknn_set_io_mem, no conversion
+  kNhwc,     // native NHWC layout, bound with rknn_set_io_mem, no conversion
+};
+
+// how the tensors are exchanged with the runtime
+enum class IoMode
+{
+  kCopy,      // rknn_inputs_set and rknn_outputs_get copy both every frame
+  kZeroCopy,  // tensors allocated once by rknn_create_mem and bound with rknn_set_io_mem
+};
+
+struct RknnModelOptions
+{
+  OutputLayout output_layout = OutputLayout::kNchw;
+  IoMode io_mode = IoMode::kCopy;
+  CoreStrategy core_strategy = CoreStrategy::kPerCore;
+  // postprocess decode threads per model, 1 decodes on the inference thread
+  int decode_threads = 1;
+  // inferences on a grey frame before the first real one, 0 disables the warm-up
+  int warmup_runs = 2;
+  std::string labels_path = LABEL_NALE_TXT_PATH;
+};
 
 static void DumpTensorAttr(rknn_tensor_attr * attr);
 
 double GetUs(struct timeval t);
 
-static unsigned char * LoadData(FILE * fp, size_t ofst, size_t sz);
+// BGR frame for RknnPool<RknnModel, FrameJob, InferResult>, the image is not written to
+struct FrameJob
+{
+  long long frame_id;
+  cv::Mat image;
+};
+
+// detections of one frame, the times are GetUs() timestamps of its stages
+struct InferResult
+{
+  long long frame_id;
+  int status;     // 0, or -1 when the frame failed and group is empty
+  cv::Mat image;  // the job image, shared and unannotated
+  DetectResultGroup group;
+  double start_us;      // a pool thread took the job
+  double submitted_us;  // preprocessed and queued for the NPU
+  double done_us;       // postprocessed
+};
 
-static unsigned char * LoadModel(const char * filename, int * model_size);
+// boxes and labels of a detection group drawn onto the frame they belong to, the annotation
+// stage of InferResult, which runs wherever the caller wants it or not at all
+void DrawDetectResults(cv::Mat & image, const DetectResultGroup & detect_result_group);
 
 static int SaveFloat(const char * filename, float * output, int element_size);
 
+// cold start of one model context, in microseconds
+struct RknnModelTimings
+{
+  double load_us = 0;         // mapping the model file, 0 for a duplicated context
+  double init_us = 0;         // rknn_init() or rknn_dup_context()
+  double first_run_us = 0;    // first rknn_run() to its outputs, 0 until it has finished
+  double warmup_us = 0;       // all warm-up runs
+};
+
 class RknnModel
 {
 public:
-  RknnModel(const std::string & model_path);
+  using Options = RknnModelOptions;
+
+  RknnModel(const std::string & model_path, const Options & options = Options());
 
   ~RknnModel();
 
@@ -33,30 +95,159 @@ public:
 
   rknn_context * GetPctx();
 
+  const RknnModelTimings & GetTimings() const { return timings_; }
+
+  // Runs options.warmup_runs inferences through every slot on a grey InputType frame of
+  // frame_size, the stream resolution, or the tile size for TileJob. Besides the lazy
+  // allocations of the runtime and the slot buffers, that builds the letterbox geometry, the pad
+  // fill and the resize tables of the stream before its first frame. An empty frame_size uses the
+  // model input size and so only warms up the NPU side.
+  template <typename InputType>
+  int Warmup(const cv::Size & frame_size = cv::Size());
+
+  // Staged inference, safe to call from several threads. Submit() preprocesses a frame into a
+  // free slot and queues it for the NPU without waiting for the run, Wait() blocks until the
+  // outputs of the slot are in memory and Collect() postprocesses them and frees the slot. With
+  // kSlotNum slots, frame N+1 is preprocessed and submitted while frame N is postprocessed, so
+  // the NPU core does not idle during the cpu stages. Submit() returns the slot or -1 and blocks
+  // while every slot is in use, so a caller must Collect() before submitting kSlotNum + 1 frames.
+  static constexpr int kSlotNum = 2;
+
+  int Submit(const cv::Mat & image);
+
+  int Submit(const Nv12Frame & frame);
+
+  int Wait(int slot);
+
+  int Collect(int slot, DetectResultGroup * detect_result_group);
+
+  // detects on a BGR frame and draws the results on it
   cv::Mat Infer(cv::Mat & original_img);
 
+  // detects on a BGR frame without drawing, nothing beyond the detections runs on the
+  // inference thread
+  InferResult Infer(FrameJob & job);
+
+  // detects on a decoder NV12 frame without a full resolution colour conversion, boxes are in
+  // frame coordinates
+  DetectResultGroup Infer(Nv12Frame & frame);
+
+  // detects on one tile of a larger frame, boxes are in tile coordinates
+  TileResult Infer(TileJob & job);
+
+  // score filters of the postprocessing, they take effect from the next Collect() call and do
+  // not touch the rknn context
+  void SetThresholds(float conf_threshold, float nms_threshold);
+
+  int SetClassThreshold(int class_id, float threshold);
+
+  int SetClassEnabled(int class_id, bool enabled);
+
+  int SetClassAllowList(const std::vector<int> & class_ids);
+
 private:
+  enum class SlotState
+  {
+    kFree,
+    kWriting,  // preprocessing
+    kQueued,   // waiting for the NPU
+    kRunning,
+    kDone,
+  };
+
+  // One frame in flight with its own input and output buffers. A context has one set of bound
+  // tensors, so when the tensors are bound every slot runs on a context of its own, a
+  // rknn_dup_context() of ctx_ on the same cores, and binds them once at init. Otherwise the
+  // slots share ctx_.
+  struct Slot
+  {
+    SlotState state;
+    int status;
+    rknn_context ctx;
+    LetterBoxBuffer input;
+    rknn_tensor_mem * input_mem;
+    rknn_tensor_mem * output_mems[PostProcessor::kMaxHeadNum];
+    // rknn_outputs_get() writes into these when the outputs are not bound
+    std::vector<int8_t> outputs[PostProcessor::kMaxHeadNum];
+    int8_t * output_bufs[PostProcessor::kMaxHeadNum];
+    rknn_run_extend run;
+  };
+
+  int InitNativeOutputs();
+
+  int InitSlots(rknn_tensor_attr * output_attrs);
+
+  int InitInputMem(Slot & slot);
+
+  int InitOutputMems(Slot & slot);
+
+  int BindSlot(Slot & slot);
+
+  // outputs are read from the slot output mems instead of rknn_outputs_get
+  bool OutputsBound() const;
+
+  template <typename ImageType>
+  int SubmitImage(const ImageType & image);
+
+  template <typename ImageType>
+  int WarmupImage(const ImageType & image);
+
+  // starts the next queued slot when the NPU is idle, called with slot_mutex_ held
+  void StartQueued(std::unique_lock<std::mutex> & lock);
+
+  // rknn calls of one run, only one thread at a time is inside them (npu_busy_)
+  int StartRun(Slot & slot);
+
+  int FinishRun(Slot & slot);
+
   int ret_;
+  // guards the postprocessor
   std::mutex mutex_;
+  // guards the slot states, the queue and the NPU ownership
+  std::mutex slot_mutex_;
+  std::condition_variable slot_cv_;
+  Slot slots_[kSlotNum];
+  std::deque<int> queued_;
+  int running_slot_;
+  bool npu_busy_;
   std::string model_path_;
-  unsigned char * model_data_;
+  Options options_;
 
   rknn_context ctx_;
+  // cores the context is counted on by the NpuCoreScheduler
+  rknn_core_mask core_mask_;
   rknn_input_output_num io_num_;
   rknn_tensor_attr * input_attrs_;
   rknn_tensor_attr * output_attrs_;
-  rknn_input inputs_[1];
+  rknn_tensor_attr * native_output_attrs_;
+  // attrs the slot mems are bound with
+  rknn_tensor_attr input_mem_attr_;
+  rknn_tensor_attr * output_mem_attrs_;
 
   int channel_;
   int width_;
   int height_;
-  int img_width_;
-  int img_height_;
 
-  float nms_threshold_;
-  float box_conf_threshold_;
+  PostProcessor post_processor_;
+
+  RknnModelTimings timings_;
+  // start of the first run, written and read by the thread that owns the NPU (npu_busy_)
+  double first_run_start_us_;
 };
 
+// the input types of RknnModel::Infer()
+template <>
+int RknnModel::Warmup<cv::Mat>(const cv::Size & frame_size);
+
+template <>
+int RknnModel::Warmup<FrameJob>(const cv::Size & frame_size);
+
+template <>
+int RknnModel::Warmup<Nv12Frame>(const cv::Size & frame_size);
+
+template <>
+int RknnModel::Warmup<TileJob>(const cv::Size & frame_size);
+
 }  // namespace det_rk3588
 
 #endif  // DET_RK3588__RKNN_MODEL_HPP_
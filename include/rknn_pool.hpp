@@ -1,26 +1,56 @@
 #ifndef DET_RK3588__RKNN_POOL_HPP_
 #define DET_RK3588__RKNN_POOL_HPP_
 
-#include <iostream>
+#include <algorithm>
+#include <chrono>
+#include <future>
 #include <memory>
 #include <mutex>
 #include <queue>
 #include <vector>
 
+#include "logger.hpp"
+#include "opencv2/core/core.hpp"
 #include "thread_pool.hpp"
 
 namespace det_rk3588
 {
 
+// wall clock of the pool start, in microseconds
+struct RknnPoolTimings
+{
+  double primary_init_us = 0;  // model load and the first context
+  double dup_us = 0;           // the other contexts, created in parallel
+  double warmup_us = 0;        // warm-up inferences of all contexts, in parallel
+  double total_us = 0;
+};
+
 template <typename ModelType, typename InputType, typename OutputType>
 class RknnPool
 {
 public:
-  RknnPool(const std::string model_path, int thread_num);
+  // model_num contexts are shared by thread_num threads, 0 gives every thread its own. A model
+  // takes more than one thread when its stages overlap, see RknnModel::Submit().
+  RknnPool(
+    const std::string model_path, int thread_num,
+    const typename ModelType::Options & options = typename ModelType::Options(),
+    int model_num = 0);
 
   ~RknnPool();
 
-  int Init();
+  // creates and warms up the contexts, returns once the pool is ready. frame_size is the size of
+  // the InputType frames the pool will be given, see ModelType::Warmup(), empty for the model
+  // input size.
+  int Init(const cv::Size & frame_size = cv::Size());
+
+  // the same in the background, the future holds the result of Init() and Put() waits for it
+  std::shared_future<int> InitAsync(const cv::Size & frame_size = cv::Size());
+
+  // future of the started initialisation, invalid before Init() or InitAsync()
+  std::shared_future<int> Ready() const { return ready_; }
+
+  // complete once Ready() is
+  const RknnPoolTimings & GetTimings() const { return timings_; }
 
   // model inference
   int Put(InputType & input_data);
@@ -31,9 +61,13 @@ public:
 protected:
   int GetModelId();
 
+  int InitModels(const cv::Size & frame_size);
+
 private:
   int thread_num_;
+  int model_num_;
   std::string model_path_;
+  typename ModelType::Options options_;
 
   long long id_;
 
@@ -43,34 +77,96 @@ private:
   std::unique_ptr<ThreadPool> thread_pool_;
   std::queue<std::future<OutputType>> futures_;
   std::vector<std::shared_ptr<ModelType>> models_;
+
+  RknnPoolTimings timings_;
+  std::shared_future<int> ready_;
 };
 
 template <typename ModelType, typename InputType, typename OutputType>
-RknnPool<ModelType, InputType, OutputType>::RknnPool(const std::string model_path, int thread_num)
+RknnPool<ModelType, InputType, OutputType>::RknnPool(
+  const std::string model_path, int thread_num, const typename ModelType::Options & options,
+  int model_num)
 {
   model_path_ = model_path;
   thread_num_ = thread_num;
+  model_num_ = model_num > 0 ? std::min(model_num, thread_num) : thread_num;
+  options_ = options;
   id_ = 0;
 }
 
 template <typename ModelType, typename InputType, typename OutputType>
-int RknnPool<ModelType, InputType, OutputType>::Init()
+int RknnPool<ModelType, InputType, OutputType>::Init(const cv::Size & frame_size)
+{
+  return InitAsync(frame_size).get();
+}
+
+template <typename ModelType, typename InputType, typename OutputType>
+std::shared_future<int> RknnPool<ModelType, InputType, OutputType>::InitAsync(
+  const cv::Size & frame_size)
 {
+  if (!ready_.valid()) {
+    ready_ =
+      std::async(std::launch::async, [this, frame_size]() { return InitModels(frame_size); })
+        .share();
+  }
+  return ready_;
+}
+
+template <typename ModelType, typename InputType, typename OutputType>
+int RknnPool<ModelType, InputType, OutputType>::InitModels(const cv::Size & frame_size)
+{
+  using Clock = std::chrono::steady_clock;
+  auto elapsed_us = [](Clock::time_point since) {
+    return std::chrono::duration<double, std::micro>(Clock::now() - since).count();
+  };
+  Clock::time_point start = Clock::now();
+
   try {
     thread_pool_ = std::make_unique<ThreadPool>(thread_num_);
-    for (int i = 0; i < thread_num_; i++)
-      models_.push_back(std::make_shared<ModelType>(model_path_.c_str()));
+    for (int i = 0; i < model_num_; i++)
+      models_.push_back(std::make_shared<ModelType>(model_path_.c_str(), options_));
   } catch (const std::bad_alloc & e) {
-    std::cout << "Out of memory: " << e.what() << std::endl;
+    LOG_ERROR("Out of memory: %s\n", e.what());
     return -1;
   }
-  // initialize rknn model
-  for (int i = 0, ret = 0; i < thread_num_; i++) {
-    // all models share weights with the first one
-    ret = models_[i]->Init(models_[0]->GetPctx(), i != 0);
-    if (ret != 0) return ret;
+  // the first context loads the model
+  int ret = models_[0]->Init(models_[0]->GetPctx(), false);
+  if (ret != 0) return ret;
+  timings_.primary_init_us = elapsed_us(start);
+
+  // the others share its weights and are independent of each other, they are created on the
+  // pool threads, which starts those threads as well
+  Clock::time_point phase_start = Clock::now();
+  std::vector<std::future<int>> results;
+  for (int i = 1; i < model_num_; i++) {
+    results.push_back(thread_pool_->Submit(
+      [this, i]() { return models_[i]->Init(models_[0]->GetPctx(), true); }));
   }
-
+  for (auto & result : results) {
+    if (result.get() != 0) ret = -1;
+  }
+  if (ret != 0) return ret;
+  timings_.dup_us = elapsed_us(phase_start);
+
+  // every context warms up its own core at the same time, on frames like the stream ones
+  phase_start = Clock::now();
+  results.clear();
+  for (int i = 0; i < model_num_; i++) {
+    results.push_back(thread_pool_->Submit(
+      [this, i, frame_size]() { return models_[i]->template Warmup<InputType>(frame_size); }));
+  }
+  for (auto & result : results) {
+    if (result.get() != 0) ret = -1;
+  }
+  if (ret != 0) return ret;
+  timings_.warmup_us = elapsed_us(phase_start);
+  timings_.total_us = elapsed_us(start);
+
+  LOG_INFO(
+    "rknn pool ready in %.2f ms: first context %.2f ms, %d more contexts %.2f ms, warm-up "
+    "%.2f ms\n",
+    timings_.total_us / 1000.0, timings_.primary_init_us / 1000.0, model_num_ - 1,
+    timings_.dup_us / 1000.0, timings_.warmup_us / 1000.0);
   return 0;
 }
 
@@ -78,7 +174,7 @@ template <typename ModelType, typename InputType, typename OutputType>
 int RknnPool<ModelType, InputType, OutputType>::GetModelId()
 {
   std::lock_guard<std::mutex> lock(id_mutex_);
-  int model_id = id_ % thread_num_;
+  int model_id = id_ % model_num_;
   id_++;
   return model_id;
 }
@@ -86,7 +182,14 @@ int RknnPool<ModelType, InputType, OutputType>::GetModelId()
 template <typename ModelType, typename InputType, typename OutputType>
 int RknnPool<ModelType, InputType, OutputType>::Put(InputType & input_data)
 {
-  futures_.push(thread_pool_->Submit(&ModelType::Infer, models_[GetModelId()], input_data));
+  // frames wait for the warm-up instead of running on half initialised contexts
+  if (!ready_.valid() || ready_.get() != 0) {
+    LOG_ERROR("rknn pool is not ready\n");
+    return -1;
+  }
+  // Infer is overloaded per input type, pick the one this pool was instantiated for
+  OutputType (ModelType::*infer)(InputType &) = &ModelType::Infer;
+  futures_.push(thread_pool_->Submit(infer, models_[GetModelId()], input_data));
   return 0;
 }
 
@@ -103,6 +206,10 @@ int RknnPool<ModelType, InputType, OutputType>::Get(OutputType & output_data)
 template <typename ModelType, typename InputType, typename OutputType>
 RknnPool<ModelType, InputType, OutputType>::~RknnPool()
 {
+  // the initialisation uses the models and the thread pool
+  if (ready_.valid()) {
+    ready_.wait();
+  }
   while (!futures_.empty()) {
     OutputType tmp = futures_.front().get();
     futures_.pop();
@@ -84,8 +84,10 @@ private:
       {
         std::unique_lock<std::mutex> lock(mutex_);
         ++idle_threads_;
-        auto has_timed_out = !cv_.wait_for(
-          lock, std::chrono::seconds(kWaitSeconds), [this]() { return quit_ || !tasks_.empty(); });
+        // the cast reads the constant, so the header can be included by several sources
+        auto wait_time = std::chrono::seconds(static_cast<std::chrono::seconds::rep>(kWaitSeconds));
+        auto has_timed_out =
+          !cv_.wait_for(lock, wait_time, [this]() { return quit_ || !tasks_.empty(); });
         --idle_threads_;
         if (tasks_.empty()) {
           if (quit_) {
@@ -136,8 +138,6 @@ private:
   std::unordered_map<std::thread::id, std::thread> threads_;
 };
 
-constexpr size_t ThreadPool::kWaitSeconds;
-
 }  // namespace det_rk3588
 
 #endif  // DET_RK3588__THREAD_POOL_HPP_
@@ -0,0 +1,92 @@
+#ifndef DET_RK3588__TILING_HPP_
+#define DET_RK3588__TILING_HPP_
+
+#include <vector>
+
+#include <opencv2/opencv.hpp>
+
+#include "nms.hpp"
+#include "postprocess.hpp"
+
+namespace det_rk3588
+{
+
+// one model-sized window of a frame, image is a header into the frame so no pixels are copied
+struct TileJob
+{
+  long long frame_id;
+  int tile_id;
+  cv::Rect rect;
+  cv::Mat image;
+};
+
+// detections of one tile in tile coordinates, with the time the tile spent in each stage:
+// preprocess_us covers the submission, detect_us the NPU run left after it and postprocessing
+struct TileResult
+{
+  long long frame_id;
+  int tile_id;
+  cv::Rect rect;
+  DetectResultGroup group;
+  double preprocess_us;
+  double detect_us;
+};
+
+// Covers frame_size with overlapping windows of at most tile_size, neighbours share at least
+// overlap pixels and the last row and column are moved back to end on the frame border. Objects
+// smaller than overlap are therefore seen whole by at least one tile.
+int MakeTiles(
+  const cv::Size & frame_size, const cv::Size & tile_size, int overlap,
+  std::vector<cv::Rect> * tiles);
+
+// Merges the tile results of one frame: boxes are moved to frame coordinates and duplicates from
+// overlapping tiles are removed by class-aware NMS. An object cut by a seam, a tile border inside
+// the frame, leaves boxes that NMS alone keeps apart, so afterwards two kept boxes of the same
+// class from different tiles, one of them on a seam, are merged into their union when
+// - the intersection covers at least kSeamContainment of the smaller box, a piece of an object
+//   that the other tile saw whole, or
+// - they meet across facing seams, a right and a left or a bottom and a top one, and overlap by
+//   at least kSeamAgreement of the shorter extent along the seam, two pieces of one object.
+// Only the merged boxes are cut to OBJ_NUMB_MAX_SIZE, the buffers are reused across frames.
+class TileMerger
+{
+public:
+  static constexpr float kSeamContainment = 0.7f;
+  static constexpr float kSeamAgreement = 0.6f;
+  // a box edge this close to a seam is cut by it
+  static constexpr int kSeamMargin = 2;
+
+  int Merge(
+    const TileResult * results, int result_num, const cv::Size & frame_size, float nms_threshold,
+    DetectResultGroup * merged);
+
+private:
+  // which seams of its tile a box touches
+  enum SeamFlags
+  {
+    kSeamLeft = 1,
+    kSeamRight = 2,
+    kSeamTop = 4,
+    kSeamBottom = 8,
+  };
+
+  bool CutBySameObject(int a, int b) const;
+
+  int MergeSeams(int keep_count);
+
+  std::vector<DetectResult> detections_;
+  std::vector<int> tile_ids_;
+  std::vector<int> seam_flags_;
+  std::vector<float> box_x1_;
+  std::vector<float> box_y1_;
+  std::vector<float> box_x2_;
+  std::vector<float> box_y2_;
+  std::vector<int> class_ids_;
+  std::vector<int> classes_;
+  std::vector<int> order_;
+  std::vector<int> keep_;
+};
+
+}  // namespace det_rk3588
+
+#endif  // DET_RK3588__TILING_HPP_
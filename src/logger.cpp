@@ -0,0 +1,296 @@
+#include "logger.hpp"
+
+#include <ctype.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <algorithm>
+#include <chrono>
+
+namespace det_rk3588
+{
+
+constexpr int Logger::kSlotNum;
+constexpr int Logger::kMessageSize;
+constexpr int Logger::kMaxArgs;
+
+Logger & Logger::Instance()
+{
+  static Logger logger;
+  return logger;
+}
+
+Logger::Logger()
+: slots_(new Slot[kSlotNum]),
+  head_(0),
+  dropped_(0),
+  level_(static_cast<int>(LogLevel::kInfo)),
+  quit_(false),
+  sleeping_(false),
+  woken_(false),
+  tail_(0),
+  reported_dropped_(0),
+  out_(stdout),
+  err_(stderr)
+{
+  static_assert((kSlotNum & (kSlotNum - 1)) == 0, "kSlotNum must be a power of two");
+  for (int i = 0; i < kSlotNum; i++) {
+    slots_[i].sequence.store(i, std::memory_order_relaxed);
+  }
+  thread_ = std::thread(&Logger::Drain, this);
+}
+
+Logger::~Logger()
+{
+  quit_.store(true, std::memory_order_release);
+  Wake();
+  thread_.join();
+}
+
+void Logger::SetLevel(LogLevel level)
+{
+  level_.store(static_cast<int>(level), std::memory_order_relaxed);
+}
+
+bool Logger::Enabled(LogLevel level) const
+{
+  return static_cast<int>(level) >= level_.load(std::memory_order_relaxed);
+}
+
+void Logger::SetStreams(FILE * out, FILE * err)
+{
+  // what is already logged goes to the old streams
+  std::lock_guard<std::mutex> lock(drain_mutex_);
+  DrainOnce();
+  out_ = out;
+  err_ = err;
+}
+
+Logger::Slot * Logger::Claim(uint64_t * pos)
+{
+  // claim the slot at head_, unless the drain thread has not freed it yet
+  uint64_t head = head_.load(std::memory_order_relaxed);
+  while (true) {
+    Slot * slot = &slots_[head & (kSlotNum - 1)];
+    uint64_t sequence = slot->sequence.load(std::memory_order_acquire);
+    int64_t diff = static_cast<int64_t>(sequence - head);
+    if (diff == 0) {
+      if (head_.compare_exchange_weak(head, head + 1, std::memory_order_relaxed)) {
+        *pos = head;
+        return slot;
+      }
+    } else if (diff < 0) {
+      dropped_.fetch_add(1, std::memory_order_relaxed);
+      return nullptr;
+    } else {
+      head = head_.load(std::memory_order_relaxed);
+    }
+  }
+}
+
+void Logger::Capture(Slot & slot, const char * value)
+{
+  // the caller's buffer may be gone by the time the slot is formatted
+  if (value == nullptr) {
+    value = "(null)";
+  }
+  Arg & arg = slot.args[slot.arg_num++];
+  arg.type = Arg::Type::kString;
+  arg.offset = slot.text_size;
+  int size = std::min((int)strlen(value), kMessageSize - 1 - slot.text_size);
+  memcpy(slot.text + slot.text_size, value, size);
+  slot.text[slot.text_size + size] = '\0';
+  slot.text_size = std::min(slot.text_size + size + 1, kMessageSize - 1);
+}
+
+void Logger::Capture(Slot & slot, const void * value)
+{
+  Arg & arg = slot.args[slot.arg_num++];
+  arg.type = Arg::Type::kPointer;
+  arg.p = value;
+}
+
+int Logger::Format(const Slot & slot, char * line)
+{
+  const char * p = slot.format;
+  int size = 0;
+  int arg_id = 0;
+  bool truncated = false;
+  while (*p != '\0' && !truncated) {
+    if (size == kMessageSize - 1) {
+      truncated = true;
+      break;
+    }
+    if (*p != '%') {
+      line[size++] = *p++;
+      continue;
+    }
+    if (p[1] == '%') {
+      line[size++] = '%';
+      p += 2;
+      continue;
+    }
+    // %[flags][width][.precision][length]conversion, the length is replaced by the one of the
+    // stored type
+    char spec[32];
+    int n = 0;
+    spec[n++] = *p++;
+    while (*p != '\0' && strchr("-+ #0", *p) != nullptr && n < 8) {
+      spec[n++] = *p++;
+    }
+    while (isdigit((unsigned char)*p) && n < 16) {
+      spec[n++] = *p++;
+    }
+    if (*p == '.') {
+      spec[n++] = *p++;
+      while (isdigit((unsigned char)*p) && n < 24) {
+        spec[n++] = *p++;
+      }
+    }
+    int short_length = 0;  // 1 for h, 2 for hh
+    while (*p != '\0' && strchr("hlLqjzt", *p) != nullptr) {
+      short_length += *p == 'h' ? 1 : 0;
+      p++;
+    }
+    char conversion = *p;
+    if (conversion == '\0' || arg_id >= slot.arg_num) {
+      // the format checker rules this out
+      break;
+    }
+    p++;
+
+    const Arg & arg = slot.args[arg_id++];
+    char * out = line + size;
+    int capacity = kMessageSize - size;
+    int written = 0;
+    if (arg.type == Arg::Type::kInt || arg.type == Arg::Type::kUint) {
+      unsigned long long value = arg.type == Arg::Type::kInt ? arg.i : arg.u;
+      bool is_signed = conversion == 'd' || conversion == 'i';
+      if (short_length == 2) {
+        value = is_signed ? (long long)(signed char)value : (unsigned char)value;
+      } else if (short_length == 1) {
+        value = is_signed ? (long long)(short)value : (unsigned short)value;
+      }
+      if (conversion == 'c') {
+        spec[n++] = 'c';
+        spec[n] = '\0';
+        written = snprintf(out, capacity, spec, (int)value);
+      } else {
+        spec[n++] = 'l';
+        spec[n++] = 'l';
+        spec[n++] = conversion;
+        spec[n] = '\0';
+        written = snprintf(out, capacity, spec, value);
+      }
+    } else if (arg.type == Arg::Type::kDouble) {
+      spec[n++] = conversion;
+      spec[n] = '\0';
+      written = snprintf(out, capacity, spec, arg.d);
+    } else if (arg.type == Arg::Type::kString) {
+      spec[n++] = 's';
+      spec[n] = '\0';
+      written = snprintf(out, capacity, spec, slot.text + arg.offset);
+    } else {
+      spec[n++] = 'p';
+      spec[n] = '\0';
+      written = snprintf(out, capacity, spec, arg.p);
+    }
+    truncated = written >= capacity;
+    size += std::max(0, std::min(written, capacity - 1));
+  }
+  if (truncated) {
+    // truncated, the line still ends
+    size = kMessageSize - 1;
+    line[size - 1] = '\n';
+  }
+  return size;
+}
+
+void Logger::Flush()
+{
+  std::lock_guard<std::mutex> lock(drain_mutex_);
+  DrainOnce();
+}
+
+uint64_t Logger::GetDroppedCount() const { return dropped_.load(std::memory_order_relaxed); }
+
+int Logger::DrainOnce()
+{
+  int count = 0;
+  bool out_written = false;
+  bool err_written = false;
+  char line[kMessageSize];
+  while (true) {
+    Slot & slot = slots_[tail_ & (kSlotNum - 1)];
+    // a claimed slot that is still being written ends this pass, it is taken up in the next
+    if (slot.sequence.load(std::memory_order_acquire) != tail_ + 1) {
+      break;
+    }
+    int size = Format(slot, line);
+    if (slot.level >= LogLevel::kWarn) {
+      fwrite(line, 1, size, err_);
+      err_written = true;
+    } else {
+      fwrite(line, 1, size, out_);
+      out_written = true;
+    }
+    slot.sequence.store(tail_ + kSlotNum, std::memory_order_release);
+    tail_++;
+    count++;
+  }
+
+  uint64_t dropped = dropped_.load(std::memory_order_relaxed);
+  if (dropped != reported_dropped_) {
+    fprintf(
+      err_, "logger: %llu messages dropped, the ring was full\n",
+      static_cast<unsigned long long>(dropped - reported_dropped_));
+    reported_dropped_ = dropped;
+    err_written = true;
+  }
+  if (out_written) {
+    fflush(out_);
+  }
+  if (err_written) {
+    fflush(err_);
+  }
+  return count;
+}
+
+void Logger::Wake()
+{
+  sleeping_.store(false, std::memory_order_relaxed);
+  {
+    std::lock_guard<std::mutex> lock(wake_mutex_);
+    woken_ = true;
+  }
+  wake_cv_.notify_one();
+}
+
+void Logger::Drain()
+{
+  while (true) {
+    // the quit flag is read first, so the last pass sees every message logged before it
+    bool quit = quit_.load(std::memory_order_acquire);
+    bool idle = false;
+    {
+      std::lock_guard<std::mutex> lock(drain_mutex_);
+      if (DrainOnce() == 0 && !quit) {
+        // a message written before the flag was set is seen here, any later one wakes us
+        sleeping_.store(true, std::memory_order_seq_cst);
+        const Slot & slot = slots_[tail_ & (kSlotNum - 1)];
+        idle = slot.sequence.load(std::memory_order_seq_cst) != tail_ + 1;
+      }
+    }
+    if (quit) {
+      break;
+    }
+    if (idle) {
+      std::unique_lock<std::mutex> lock(wake_mutex_);
+      wake_cv_.wait_for(lock, std::chrono::milliseconds(100), [this]() { return woken_; });
+      woken_ = false;
+      sleeping_.store(false, std::memory_order_relaxed);
+    }
+  }
+}
+
+}  // namespace det_rk3588
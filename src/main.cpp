@@ -7,6 +7,7 @@
 #define _BASETSD_H
 
 #include "RgaUtils.h"
+#include "model_loader.hpp"
 #include "postprocess.hpp"
 #include "preprocess.hpp"
 #include "rknn_api.h"
@@ -35,54 +36,6 @@ static void DumpTensorAttr(rknn_tensor_attr * attr)
 
 double GetUs(struct timeval t) { return (t.tv_sec * 1000000 + t.tv_usec); }
 
-static unsigned char * LoadData(FILE * fp, size_t ofst, size_t sz)
-{
-  unsigned char * data;
-  int ret;
-
-  data = NULL;
-
-  if (NULL == fp) {
-    return NULL;
-  }
-
-  ret = fseek(fp, ofst, SEEK_SET);
-  if (ret != 0) {
-    printf("blob seek failure.\n");
-    return NULL;
-  }
-
-  data = (unsigned char *)malloc(sz);
-  if (data == NULL) {
-    printf("buffer malloc failure.\n");
-    return NULL;
-  }
-  ret = fread(data, 1, sz, fp);
-  return data;
-}
-
-static unsigned char * LoadModel(const char * filename, int * model_size)
-{
-  FILE * fp;
-  unsigned char * data;
-
-  fp = fopen(filename, "rb");
-  if (NULL == fp) {
-    printf("Open file %s failed.\n", filename);
-    return NULL;
-  }
-
-  fseek(fp, 0, SEEK_END);
-  int size = ftell(fp);
-
-  data = LoadData(fp, 0, size);
-
-  fclose(fp);
-
-  *model_size = size;
-  return data;
-}
-
 static int SaveFloat(const char * file_name, float * output, int element_size)
 {
   FILE * fp;
@@ -138,13 +91,25 @@ int main(int argc, char ** argv)
 
   /* Create the neural network */
   printf("Loading mode...\n");
-  int model_data_size = 0;
-  unsigned char * model_data = LoadModel(model_name, &model_data_size);
-  ret = rknn_init(&ctx, model_data, model_data_size, 0, NULL);
+  gettimeofday(&start_time, NULL);
+  ModelFile model_file;
+  if (model_file.Open(model_name) != 0) {
+    return -1;
+  }
+  gettimeofday(&stop_time, NULL);
+  double load_ms = (GetUs(stop_time) - GetUs(start_time)) / 1000;
+  gettimeofday(&start_time, NULL);
+  ret = rknn_init(&ctx, model_file.GetData(), model_file.GetSize(), 0, NULL);
+  // the runtime keeps its own copy of the model
+  model_file.Close();
   if (ret < 0) {
     printf("rknn_init error ret=%d\n", ret);
     return -1;
   }
+  gettimeofday(&stop_time, NULL);
+  printf(
+    "model load %f ms, context init %f ms\n", load_ms,
+    (GetUs(stop_time) - GetUs(start_time)) / 1000);
 
   rknn_sdk_version version;
   ret = rknn_query(ctx, RKNN_QUERY_SDK_VERSION, &version, sizeof(rknn_sdk_version));
@@ -271,20 +236,36 @@ int main(int argc, char ** argv)
   ret = rknn_run(ctx, NULL);
   ret = rknn_outputs_get(ctx, io_num.n_output, outputs, NULL);
   gettimeofday(&stop_time, NULL);
+  // the first run, lazy allocations of the runtime included
   printf("once run use %f ms\n", (GetUs(stop_time) - GetUs(start_time)) / 1000);
 
   // 后处理
+  rknn_custom_string custom_string;
+  memset(&custom_string, 0, sizeof(custom_string));
+  if (rknn_query(ctx, RKNN_QUERY_CUSTOM_STRING, &custom_string, sizeof(custom_string)) < 0) {
+    custom_string.string[0] = '\0';
+  }
+  HeadConfig head;
+  ret = LoadHeadConfig(
+    model_name, custom_string.string, height, width, output_attrs, io_num.n_output, &head);
+  if (ret < 0) {
+    printf("load head config error ret=%d\n", ret);
+    return -1;
+  }
+  PostProcessor post_processor;
+  ret = post_processor.Init(height, width, head, output_attrs, io_num.n_output);
+  if (ret < 0) {
+    printf("postprocess init error ret=%d\n", ret);
+    return -1;
+  }
+  post_processor.SetThresholds(box_conf_threshold, nms_threshold);
+  post_processor.LoadLabels(LABEL_NALE_TXT_PATH);
   DetectResultGroup detect_result_group;
-  std::vector<float> out_scales;
-  std::vector<int32_t> out_zps;
+  int8_t * output_bufs[PostProcessor::kMaxHeadNum];
   for (int i = 0; i < io_num.n_output; ++i) {
-    out_scales.push_back(output_attrs[i].scale);
-    out_zps.push_back(output_attrs[i].zp);
+    output_bufs[i] = (int8_t *)outputs[i].buf;
   }
-  PostProcess(
-    (int8_t *)outputs[0].buf, (int8_t *)outputs[1].buf, (int8_t *)outputs[2].buf, height, width,
-    box_conf_threshold, nms_threshold, pads, scale_w, scale_h, out_zps, out_scales,
-    &detect_result_group);
+  post_processor.Run(output_bufs, pads, scale_w, scale_h, &detect_result_group);
 
   // 画框和概率
   char text[256];
@@ -316,10 +297,10 @@ int main(int argc, char ** argv)
     ret = rknn_run(ctx, NULL);
     ret = rknn_outputs_get(ctx, io_num.n_output, outputs, NULL);
 #if PERF_WITH_POST
-    PostProcess(
-      (int8_t *)outputs[0].buf, (int8_t *)outputs[1].buf, (int8_t *)outputs[2].buf, height, width,
-      box_conf_threshold, nms_threshold, pads, scale_w, scale_h, out_zps, out_scales,
-      &detect_result_group);
+    for (int j = 0; j < io_num.n_output; ++j) {
+      output_bufs[j] = (int8_t *)outputs[j].buf;
+    }
+    post_processor.Run(output_bufs, pads, scale_w, scale_h, &detect_result_group);
 #endif
     ret = rknn_outputs_release(ctx, io_num.n_output, outputs);
   }
@@ -328,14 +309,8 @@ int main(int argc, char ** argv)
     "loop count = %d , average run  %f ms\n", test_count,
     (GetUs(stop_time) - GetUs(start_time)) / 1000.0 / test_count);
 
-  DeinitPostProcess();
-
   // release
   ret = rknn_destroy(ctx);
 
-  if (model_data) {
-    free(model_data);
-  }
-
   return 0;
 }
@@ -4,34 +4,115 @@
 
 #include <memory>
 #include <opencv2/opencv.hpp>
+#include <vector>
 
 #include "rknn_model.hpp"
 #include "rknn_pool.hpp"
+#include "tiling.hpp"
 
 #define THREAD_NUM 6
+#define TILE_SIZE 640
 
 using namespace det_rk3588;
 
+// Every frame is split into overlapping model-sized tiles that run as independent jobs on the
+// pool, so all NPU cores work on the same frame, and the tile detections are merged afterwards.
+static int RunTiled(
+  const char * model_path, cv::VideoCapture & video_capture, cv::VideoWriter & video_writer,
+  const cv::Size & frame_size, int overlap)
+{
+  std::vector<cv::Rect> tiles;
+  if (MakeTiles(frame_size, cv::Size(TILE_SIZE, TILE_SIZE), overlap, &tiles) < 0) {
+    return -1;
+  }
+  int tile_num = tiles.size();
+  printf(
+    "%dx%d frames in %d tiles, overlap %d\n", frame_size.width, frame_size.height, tile_num,
+    overlap);
+
+  RknnPool<RknnModel, TileJob, TileResult> rknn_pool(model_path, THREAD_NUM);
+  if (rknn_pool.Init(tiles[0].size()) != 0) {
+    printf("rknn pool init failed.\n");
+    return -1;
+  }
+
+  TileMerger merger;
+  std::vector<TileResult> results(tile_num);
+  std::vector<double> preprocess_us(tile_num, 0.0);
+  std::vector<double> detect_us(tile_num, 0.0);
+  double merge_us = 0.0;
+  DetectResultGroup merged;
+  timeval time;
+  gettimeofday(&time, nullptr);
+  auto before_time = GetUs(time);
+
+  int frames = 0;
+  while (video_capture.isOpened()) {
+    cv::Mat img;
+    if (video_capture.read(img) == false) {
+      break;
+    }
+    for (int i = 0; i < tile_num; ++i) {
+      TileJob job;
+      job.frame_id = frames;
+      job.tile_id = i;
+      job.rect = tiles[i];
+      job.image = img(tiles[i]);
+      if (rknn_pool.Put(job) != 0) {
+        return -1;
+      }
+    }
+    // results come back in submission order
+    for (int i = 0; i < tile_num; ++i) {
+      if (rknn_pool.Get(results[i]) != 0) {
+        return -1;
+      }
+      preprocess_us[i] += results[i].preprocess_us;
+      detect_us[i] += results[i].detect_us;
+    }
+    gettimeofday(&time, nullptr);
+    auto merge_start = GetUs(time);
+    merger.Merge(results.data(), tile_num, frame_size, NMS_THRESH, &merged);
+    gettimeofday(&time, nullptr);
+    merge_us += GetUs(time) - merge_start;
+    DrawDetectResults(img, merged);
+    frames++;
+
+    if (frames % 120 == 0) {
+      gettimeofday(&time, nullptr);
+      auto current_time = GetUs(time);
+      printf("120 frames, average fps: %f\n", 120.0 / float(current_time - before_time) * 1e6);
+      for (int i = 0; i < tile_num; ++i) {
+        const cv::Rect & rect = tiles[i];
+        printf(
+          "  tile %d (%d, %d) preprocess %.0f us, detect %.0f us\n", i, rect.x, rect.y,
+          preprocess_us[i] / 120, detect_us[i] / 120);
+        preprocess_us[i] = 0.0;
+        detect_us[i] = 0.0;
+      }
+      printf("  merge %.0f us\n", merge_us / 120);
+      merge_us = 0.0;
+      before_time = current_time;
+    }
+
+    video_writer.write(img);
+  }
+  return 0;
+}
+
 int main(int argc, char ** argv)
 {
   char * model_path = nullptr;
   char * video_path = nullptr;
   char * save_path = nullptr;
-  if (argc != 4) {
-    printf("Usage: %s <model path> <video path> <save path> \n", argv[0]);
+  if (argc != 4 && argc != 5) {
+    printf("Usage: %s <model path> <video path> <save path> [tile overlap]\n", argv[0]);
     return -1;
   }
   model_path = (char *)argv[1];
   video_path = (char *)argv[2];
   save_path = (char *)argv[3];
 
-  // initialize rknn thread pool
-  RknnPool<RknnModel, cv::Mat, cv::Mat> rknn_pool(model_path, THREAD_NUM);
-  if (rknn_pool.Init() != 0) {
-    printf("rknn pool init failed.\n");
-    return -1;
-  }
-
   cv::VideoCapture video_capture;
   if (strlen(video_path) <= 2) {
     video_capture.open(22);
@@ -46,46 +127,67 @@ int main(int argc, char ** argv)
   cv::VideoWriter video_writer(
     save_path, cv::VideoWriter::fourcc('X', '2', '6', '4'), fps, frame_size);
 
+  // a tile overlap switches to tiled inference
+  if (argc == 5) {
+    return RunTiled(model_path, video_capture, video_writer, frame_size, atoi(argv[4]));
+  }
+
+  // initialize rknn thread pool
+  // two threads per context keep each NPU core fed while the other one pre/postprocesses
+  RknnPool<RknnModel, FrameJob, InferResult> rknn_pool(
+    model_path, THREAD_NUM, RknnModel::Options(), RK3588_CORE_NUM);
+  if (rknn_pool.Init(frame_size) != 0) {
+    printf("rknn pool init failed.\n");
+    return -1;
+  }
+
   timeval time;
   gettimeofday(&time, nullptr);
   auto start_time = GetUs(time);
 
+  long long frame_id = 0;
   int frames = 0;
+  double infer_us = 0.0;
   auto before_time = start_time;
+  InferResult result;
   while (video_capture.isOpened()) {
-    cv::Mat img;
-    if (video_capture.read(img) == false) {
+    FrameJob job;
+    job.frame_id = frame_id++;
+    if (video_capture.read(job.image) == false) {
       break;
     }
-    if (rknn_pool.Put(img) != 0) {
+    if (rknn_pool.Put(job) != 0) {
       break;
     }
+    if (frame_id <= THREAD_NUM) {
+      continue;
+    }
 
-    if (frames >= THREAD_NUM && rknn_pool.Get(img) != 0) {
+    if (rknn_pool.Get(result) != 0) {
       break;
     }
     frames++;
+    infer_us += result.done_us - result.start_us;
 
     if (frames % 120 == 0) {
       gettimeofday(&time, nullptr);
       auto current_time = GetUs(time);
-      printf("120 frames, average fps: %f\n", 120.0 / float(current_time - before_time) * 1e6);
+      printf(
+        "120 frames, average fps: %f, inference %.0f us\n",
+        120.0 / float(current_time - before_time) * 1e6, infer_us / 120);
+      infer_us = 0.0;
       before_time = current_time;
     }
 
-    usleep(1);
-
-    video_writer.write(img);
+    // the pool threads only detect, the boxes are drawn here
+    DrawDetectResults(result.image, result.group);
+    video_writer.write(result.image);
   }
 
-  while (true) {
-    cv::Mat img;
-    if (rknn_pool.Get(img) != 0) {
-      break;
-    }
+  while (rknn_pool.Get(result) == 0) {
     frames++;
-
-    usleep(1);
+    DrawDetectResults(result.image, result.group);
+    video_writer.write(result.image);
   }
 
   gettimeofday(&time, nullptr);
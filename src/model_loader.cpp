@@ -0,0 +1,61 @@
+#include "model_loader.hpp"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "logger.hpp"
+
+namespace det_rk3588
+{
+
+ModelFile::ModelFile()
+{
+  data_ = nullptr;
+  size_ = 0;
+}
+
+ModelFile::~ModelFile() { Close(); }
+
+int ModelFile::Open(const char * path)
+{
+  Close();
+
+  int fd = open(path, O_RDONLY | O_CLOEXEC);
+  if (fd < 0) {
+    LOG_ERROR("Open file %s failed.\n", path);
+    return -1;
+  }
+  struct stat st;
+  if (fstat(fd, &st) != 0 || st.st_size <= 0) {
+    LOG_ERROR("model file %s is empty or unreadable.\n", path);
+    close(fd);
+    return -1;
+  }
+
+  void * data = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  // the mapping keeps its own reference to the file
+  close(fd);
+  if (data == MAP_FAILED) {
+    LOG_ERROR("mmap model file %s failed.\n", path);
+    return -1;
+  }
+  // rknn_init() reads the file front to back, start the readahead now
+  madvise(data, st.st_size, MADV_WILLNEED);
+
+  data_ = data;
+  size_ = st.st_size;
+  return 0;
+}
+
+void ModelFile::Close()
+{
+  if (data_) {
+    munmap(data_, size_);
+  }
+  data_ = nullptr;
+  size_ = 0;
+}
+
+}  // namespace det_rk3588
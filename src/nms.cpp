@@ -0,0 +1,265 @@
+#include "nms.hpp"
+
+#include <math.h>
+#include <string.h>
+
+#include <algorithm>
+
+#if !defined(DET_RK3588_DISABLE_SIMD)
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define DET_RK3588_IOU_NEON 1
+#elif defined(__AVX2__)
+#include <immintrin.h>
+#define DET_RK3588_IOU_AVX2 1
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#define DET_RK3588_IOU_SSE2 1
+#endif
+#endif
+
+namespace det_rk3588
+{
+
+constexpr int NmsEngine::kMaxKeep;
+constexpr int NmsEngine::kDefaultCellSize;
+constexpr int NmsEngine::kIouBlock;
+
+static_assert(NmsEngine::kMaxKeep % NmsEngine::kIouBlock == 0, "kept boxes come in whole blocks");
+
+static float CalculateOverlap(
+  float xmin0, float ymin0, float xmax0, float ymax0, float xmin1, float ymin1, float xmax1,
+  float ymax1)
+{
+  float w = fmax(0.f, fmin(xmax0, xmax1) - fmax(xmin0, xmin1) + 1.0);
+  float h = fmax(0.f, fmin(ymax0, ymax1) - fmax(ymin0, ymin1) + 1.0);
+  float i = w * h;
+  float u = (xmax0 - xmin0 + 1.0) * (ymax0 - ymin0 + 1.0) +
+            (xmax1 - xmin1 + 1.0) * (ymax1 - ymin1 + 1.0) - i;
+  return u <= 0.f ? 0.f : (i / u);
+}
+
+NmsEngine::NmsEngine() : cols_(0), rows_(0), inv_cell_size_(0.f)
+{
+  // the lanes past the kept boxes are computed too, keep them finite
+  memset(kept_x1_, 0, sizeof(kept_x1_));
+  memset(kept_y1_, 0, sizeof(kept_y1_));
+  memset(kept_x2_, 0, sizeof(kept_x2_));
+  memset(kept_y2_, 0, sizeof(kept_y2_));
+  memset(kept_area_, 0, sizeof(kept_area_));
+}
+
+// Tests one box against the kept boxes selected by candidates, kIouBlock kept boxes at a time, and
+// skips the blocks without a candidate. Bit k of the result is set when IoU > threshold, which is
+// evaluated as inter > threshold * union to stay free of divisions.
+uint64_t NmsEngine::OverlapMask(
+  float x1, float y1, float x2, float y2, float threshold, uint64_t candidates) const
+{
+  const float area = (x2 - x1 + 1.f) * (y2 - y1 + 1.f);
+  uint64_t overlaps = 0;
+#if defined(DET_RK3588_IOU_NEON)
+  const float32x4_t bx1 = vdupq_n_f32(x1);
+  const float32x4_t by1 = vdupq_n_f32(y1);
+  const float32x4_t bx2 = vdupq_n_f32(x2);
+  const float32x4_t by2 = vdupq_n_f32(y2);
+  const float32x4_t barea = vdupq_n_f32(area);
+  const float32x4_t thres = vdupq_n_f32(threshold);
+  const float32x4_t one = vdupq_n_f32(1.f);
+  const float32x4_t zero = vdupq_n_f32(0.f);
+  const uint8_t weights[8] = {1, 2, 4, 8, 16, 32, 64, 128};
+  const uint8x8_t lane_bits = vld1_u8(weights);
+#elif defined(DET_RK3588_IOU_AVX2)
+  const __m256 bx1 = _mm256_set1_ps(x1);
+  const __m256 by1 = _mm256_set1_ps(y1);
+  const __m256 bx2 = _mm256_set1_ps(x2);
+  const __m256 by2 = _mm256_set1_ps(y2);
+  const __m256 barea = _mm256_set1_ps(area);
+  const __m256 thres = _mm256_set1_ps(threshold);
+  const __m256 one = _mm256_set1_ps(1.f);
+  const __m256 zero = _mm256_setzero_ps();
+#elif defined(DET_RK3588_IOU_SSE2)
+  const __m128 bx1 = _mm_set1_ps(x1);
+  const __m128 by1 = _mm_set1_ps(y1);
+  const __m128 bx2 = _mm_set1_ps(x2);
+  const __m128 by2 = _mm_set1_ps(y2);
+  const __m128 barea = _mm_set1_ps(area);
+  const __m128 thres = _mm_set1_ps(threshold);
+  const __m128 one = _mm_set1_ps(1.f);
+  const __m128 zero = _mm_setzero_ps();
+#endif
+  for (int b = 0; b < kMaxKeep; b += kIouBlock) {
+    uint64_t block = (candidates >> b) & ((1ULL << kIouBlock) - 1);
+    if (block == 0) {
+      continue;
+    }
+    uint64_t bits = 0;
+#if defined(DET_RK3588_IOU_NEON)
+    // two quads per block, the compare masks are narrowed to one byte per box
+    uint32x4_t hit[2];
+    for (int q = 0; q < 2; ++q) {
+      int k = b + q * 4;
+      float32x4_t w = vaddq_f32(
+        vsubq_f32(vminq_f32(bx2, vld1q_f32(kept_x2_ + k)), vmaxq_f32(bx1, vld1q_f32(kept_x1_ + k))),
+        one);
+      float32x4_t h = vaddq_f32(
+        vsubq_f32(vminq_f32(by2, vld1q_f32(kept_y2_ + k)), vmaxq_f32(by1, vld1q_f32(kept_y1_ + k))),
+        one);
+      float32x4_t inter = vmulq_f32(vmaxq_f32(w, zero), vmaxq_f32(h, zero));
+      float32x4_t uni = vsubq_f32(vaddq_f32(barea, vld1q_f32(kept_area_ + k)), inter);
+      hit[q] = vandq_u32(vcgtq_f32(inter, vmulq_f32(thres, uni)), vcgtq_f32(uni, zero));
+    }
+    uint8x8_t hit8 = vmovn_u16(vcombine_u16(vmovn_u32(hit[0]), vmovn_u32(hit[1])));
+    uint8x8_t sum = vand_u8(hit8, lane_bits);
+    sum = vpadd_u8(sum, sum);
+    sum = vpadd_u8(sum, sum);
+    sum = vpadd_u8(sum, sum);
+    bits = vget_lane_u8(sum, 0);
+#elif defined(DET_RK3588_IOU_AVX2)
+    __m256 w = _mm256_add_ps(
+      _mm256_sub_ps(
+        _mm256_min_ps(bx2, _mm256_loadu_ps(kept_x2_ + b)),
+        _mm256_max_ps(bx1, _mm256_loadu_ps(kept_x1_ + b))),
+      one);
+    __m256 h = _mm256_add_ps(
+      _mm256_sub_ps(
+        _mm256_min_ps(by2, _mm256_loadu_ps(kept_y2_ + b)),
+        _mm256_max_ps(by1, _mm256_loadu_ps(kept_y1_ + b))),
+      one);
+    __m256 inter = _mm256_mul_ps(_mm256_max_ps(w, zero), _mm256_max_ps(h, zero));
+    __m256 uni = _mm256_sub_ps(_mm256_add_ps(barea, _mm256_loadu_ps(kept_area_ + b)), inter);
+    __m256 hit = _mm256_and_ps(
+      _mm256_cmp_ps(inter, _mm256_mul_ps(thres, uni), _CMP_GT_OQ),
+      _mm256_cmp_ps(uni, zero, _CMP_GT_OQ));
+    bits = (uint32_t)_mm256_movemask_ps(hit);
+#elif defined(DET_RK3588_IOU_SSE2)
+    for (int q = 0; q < 2; ++q) {
+      int k = b + q * 4;
+      __m128 w = _mm_add_ps(
+        _mm_sub_ps(
+          _mm_min_ps(bx2, _mm_loadu_ps(kept_x2_ + k)), _mm_max_ps(bx1, _mm_loadu_ps(kept_x1_ + k))),
+        one);
+      __m128 h = _mm_add_ps(
+        _mm_sub_ps(
+          _mm_min_ps(by2, _mm_loadu_ps(kept_y2_ + k)), _mm_max_ps(by1, _mm_loadu_ps(kept_y1_ + k))),
+        one);
+      __m128 inter = _mm_mul_ps(_mm_max_ps(w, zero), _mm_max_ps(h, zero));
+      __m128 uni = _mm_sub_ps(_mm_add_ps(barea, _mm_loadu_ps(kept_area_ + k)), inter);
+      __m128 hit =
+        _mm_and_ps(_mm_cmpgt_ps(inter, _mm_mul_ps(thres, uni)), _mm_cmpgt_ps(uni, zero));
+      bits |= (uint64_t)_mm_movemask_ps(hit) << (q * 4);
+    }
+#else
+    for (int i = 0; i < kIouBlock; ++i) {
+      int k = b + i;
+      float w = std::max(0.f, std::min(x2, kept_x2_[k]) - std::max(x1, kept_x1_[k]) + 1.f);
+      float h = std::max(0.f, std::min(y2, kept_y2_[k]) - std::max(y1, kept_y1_[k]) + 1.f);
+      float inter = w * h;
+      float uni = area + kept_area_[k] - inter;
+      if (uni > 0.f && inter > threshold * uni) {
+        bits |= 1ULL << i;
+      }
+    }
+#endif
+    overlaps |= (bits & block) << b;
+  }
+  return overlaps;
+}
+
+void NmsEngine::Init(int width, int height, int class_num, int cell_size)
+{
+  cols_ = std::max(1, (width + cell_size - 1) / cell_size);
+  rows_ = std::max(1, (height + cell_size - 1) / cell_size);
+  inv_cell_size_ = 1.f / cell_size;
+  cell_masks_.assign(cols_ * rows_, 0);
+  class_masks_.assign(class_num, 0);
+}
+
+inline int NmsEngine::CellIndex(float v, int cell_num) const
+{
+  if (!(v > 0.f)) {
+    return 0;
+  }
+  float cell = v * inv_cell_size_;
+  return cell >= cell_num ? cell_num - 1 : (int)cell;
+}
+
+int NmsEngine::Run(
+  const float * box_x1, const float * box_y1, const float * box_x2, const float * box_y2,
+  const int * class_ids, const int * order, int count, float threshold, int max_keep, int * keep)
+{
+  max_keep = std::min(max_keep, kMaxKeep);
+  std::fill(cell_masks_.begin(), cell_masks_.end(), 0);
+  std::fill(class_masks_.begin(), class_masks_.end(), 0);
+
+  int keep_count = 0;
+  for (int i = 0; i < count && keep_count < max_keep; ++i) {
+    int n = order[i];
+    int c = class_ids[n];
+    float xmin = box_x1[n];
+    float ymin = box_y1[n];
+    float xmax = box_x2[n];
+    float ymax = box_y2[n];
+
+    // the overlap uses inclusive pixel bounds, boxes closer than one pixel still intersect
+    int col0 = CellIndex(xmin, cols_);
+    int col1 = CellIndex(xmax + 1.f, cols_);
+    int row0 = CellIndex(ymin, rows_);
+    int row1 = CellIndex(ymax + 1.f, rows_);
+
+    uint64_t nearby = 0;
+    for (int r = row0; r <= row1; ++r) {
+      const uint64_t * masks = cell_masks_.data() + r * cols_;
+      for (int col = col0; col <= col1; ++col) {
+        nearby |= masks[col];
+      }
+    }
+    nearby &= class_masks_[c];
+
+    if (nearby != 0 && OverlapMask(xmin, ymin, xmax, ymax, threshold, nearby) != 0) {
+      continue;
+    }
+
+    kept_x1_[keep_count] = xmin;
+    kept_y1_[keep_count] = ymin;
+    kept_x2_[keep_count] = xmax;
+    kept_y2_[keep_count] = ymax;
+    kept_area_[keep_count] = (xmax - xmin + 1.f) * (ymax - ymin + 1.f);
+    uint64_t bit = 1ULL << keep_count;
+    class_masks_[c] |= bit;
+    for (int r = row0; r <= row1; ++r) {
+      uint64_t * masks = cell_masks_.data() + r * cols_;
+      for (int col = col0; col <= col1; ++col) {
+        masks[col] |= bit;
+      }
+    }
+    keep[keep_count++] = n;
+  }
+  return keep_count;
+}
+
+int NmsPerClass(
+  int valid_count, const float * box_x1, const float * box_y1, const float * box_x2,
+  const float * box_y2, const int * class_ids, int * order, int filter_id, float threshold)
+{
+  for (int i = 0; i < valid_count; ++i) {
+    int n = order[i];
+    if (n == -1 || class_ids[n] != filter_id) {
+      continue;
+    }
+    for (int j = i + 1; j < valid_count; ++j) {
+      int m = order[j];
+      if (m == -1 || class_ids[m] != filter_id) {
+        continue;
+      }
+      float iou = CalculateOverlap(
+        box_x1[n], box_y1[n], box_x2[n], box_y2[n], box_x1[m], box_y1[m], box_x2[m], box_y2[m]);
+
+      if (iou > threshold) {
+        order[j] = -1;
+      }
+    }
+  }
+  return 0;
+}
+
+}  // namespace det_rk3588
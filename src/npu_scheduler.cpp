@@ -0,0 +1,111 @@
+#include "npu_scheduler.hpp"
+
+#include <string.h>
+
+#include "logger.hpp"
+
+namespace det_rk3588
+{
+
+const char * CoreStrategyName(CoreStrategy strategy)
+{
+  switch (strategy) {
+    case CoreStrategy::kPerCore:
+      return "per-core";
+    case CoreStrategy::kAllCores:
+      return "all-cores";
+    case CoreStrategy::kAuto:
+      return "auto";
+  }
+  return "unknown";
+}
+
+int ParseCoreStrategy(const char * name, CoreStrategy * strategy)
+{
+  const CoreStrategy strategies[] = {
+    CoreStrategy::kPerCore, CoreStrategy::kAllCores, CoreStrategy::kAuto};
+  for (CoreStrategy candidate : strategies) {
+    if (strcmp(name, CoreStrategyName(candidate)) == 0) {
+      *strategy = candidate;
+      return 0;
+    }
+  }
+  LOG_ERROR("unknown core strategy %s, use per-core, all-cores or auto\n", name);
+  return -1;
+}
+
+NpuCoreScheduler & NpuCoreScheduler::Instance()
+{
+  static NpuCoreScheduler scheduler;
+  return scheduler;
+}
+
+NpuCoreScheduler::NpuCoreScheduler()
+{
+  memset(context_num_, 0, sizeof(context_num_));
+  auto_context_num_ = 0;
+}
+
+rknn_core_mask NpuCoreScheduler::Acquire(CoreStrategy strategy)
+{
+  std::lock_guard<std::mutex> lock(mutex_);
+
+  rknn_core_mask core_mask;
+  if (strategy == CoreStrategy::kPerCore) {
+    // least loaded core, the lowest one on a tie
+    int core = 0;
+    for (int i = 1; i < RK3588_CORE_NUM; i++) {
+      if (context_num_[i] < context_num_[core]) {
+        core = i;
+      }
+    }
+    core_mask = static_cast<rknn_core_mask>(RKNN_NPU_CORE_0 << core);
+  } else if (strategy == CoreStrategy::kAllCores) {
+    core_mask = RKNN_NPU_CORE_0_1_2;
+  } else {
+    core_mask = RKNN_NPU_CORE_AUTO;
+  }
+
+  if (core_mask == RKNN_NPU_CORE_AUTO) {
+    auto_context_num_++;
+  }
+  for (int i = 0; i < RK3588_CORE_NUM; i++) {
+    if (core_mask & (RKNN_NPU_CORE_0 << i)) {
+      context_num_[i]++;
+    }
+  }
+
+  LOG_INFO(
+    "npu core strategy %s: core mask 0x%x, contexts per core %d/%d/%d, auto %d\n",
+    CoreStrategyName(strategy), core_mask, context_num_[0], context_num_[1], context_num_[2],
+    auto_context_num_);
+  return core_mask;
+}
+
+void NpuCoreScheduler::Release(rknn_core_mask core_mask)
+{
+  std::lock_guard<std::mutex> lock(mutex_);
+
+  if (core_mask == RKNN_NPU_CORE_AUTO) {
+    auto_context_num_--;
+  }
+  for (int i = 0; i < RK3588_CORE_NUM; i++) {
+    if (core_mask & (RKNN_NPU_CORE_0 << i)) {
+      context_num_[i]--;
+    }
+  }
+}
+
+int NpuCoreScheduler::GetContextNum(int core)
+{
+  std::lock_guard<std::mutex> lock(mutex_);
+  return context_num_[core];
+}
+
+int NpuCoreScheduler::GetAutoContextNum()
+{
+  std::lock_guard<std::mutex> lock(mutex_);
+  return auto_context_num_;
+}
+
+}  // namespace det_rk3588
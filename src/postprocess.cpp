@@ -7,345 +7,975 @@
 #include <string.h>
 #include <sys/time.h>
 
-#include <set>
+#include <algorithm>
+#include <chrono>
+#include <string>
 #include <vector>
 
-#define LABEL_NALE_TXT_PATH "./model/labels_list.txt"
+#include "logger.hpp"
+
+#if !defined(DET_RK3588_DISABLE_SIMD)
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define DET_RK3588_SCAN_NEON 1
+#elif defined(__AVX2__)
+#include <immintrin.h>
+#define DET_RK3588_SCAN_AVX2 1
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#define DET_RK3588_SCAN_SSE2 1
+#endif
+#endif
 
 namespace det_rk3588
 {
 
-static char * labels[OBJ_CLASS_NUM];
-
-const int anchor0[6] = {10, 13, 16, 30, 33, 23};
-const int anchor1[6] = {30, 61, 62, 45, 59, 119};
-const int anchor2[6] = {116, 90, 156, 198, 373, 326};
+// default anchors of the YOLOv5 P5 (three heads, 640 input) and P6 (four heads, 1280 input) models
+const int anchors_p5[3][OBJ_ANCHOR_NUM * 2] = {
+  {10, 13, 16, 30, 33, 23}, {30, 61, 62, 45, 59, 119}, {116, 90, 156, 198, 373, 326}};
+const int anchors_p6[4][OBJ_ANCHOR_NUM * 2] = {
+  {19, 27, 44, 40, 38, 94},
+  {96, 68, 86, 152, 180, 137},
+  {140, 301, 303, 264, 238, 542},
+  {436, 615, 739, 380, 925, 792}};
 
 inline static int Clamp(float val, int min, int max)
 {
   return val > min ? (val < max ? val : max) : min;
 }
 
-char * ReadLine(FILE * fp, char * buffer, int * len)
+static int ReadTextFile(const char * filename, std::string * text)
 {
-  int ch;
-  int i = 0;
-  size_t buff_len = 0;
+  FILE * fp = fopen(filename, "rb");
+  if (fp == NULL) {
+    return -1;
+  }
+  char buffer[512];
+  size_t n;
+  text->clear();
+  while ((n = fread(buffer, 1, sizeof(buffer), fp)) > 0) {
+    text->append(buffer, n);
+  }
+  fclose(fp);
+  return 0;
+}
 
-  buffer = (char *)malloc(buff_len + 1);
-  if (!buffer) return NULL;  // Out of memory
+// parse a comma separated list of integers, returns how many were read
+static int ParseIntList(const std::string & text, int * values, int max_num)
+{
+  int num = 0;
+  const char * p = text.c_str();
+  while (*p != '\0' && num < max_num) {
+    char * end;
+    long value = strtol(p, &end, 10);
+    if (end == p) {
+      break;
+    }
+    values[num++] = (int)value;
+    p = end;
+    while (*p == ' ' || *p == ',') {
+      p++;
+    }
+  }
+  return num;
+}
+
+static std::string Trim(const std::string & text)
+{
+  size_t begin = text.find_first_not_of(" \t\r");
+  size_t end = text.find_last_not_of(" \t\r");
+  return begin == std::string::npos ? std::string() : text.substr(begin, end - begin + 1);
+}
 
-  while ((ch = fgetc(fp)) != '\n' && ch != EOF) {
-    buff_len++;
-    void * tmp = realloc(buffer, buff_len + 1);
-    if (tmp == NULL) {
-      free(buffer);
-      return NULL;  // Out of memory
+int ParseHeadConfig(const char * text, HeadConfig * head)
+{
+  memset(head, 0, sizeof(HeadConfig));
+  std::string entries(text);
+  size_t begin = 0;
+  while (begin < entries.size()) {
+    size_t end = entries.find_first_of(";\n", begin);
+    if (end == std::string::npos) {
+      end = entries.size();
+    }
+    std::string entry = entries.substr(begin, end - begin);
+    begin = end + 1;
+    size_t eq = entry.find('=');
+    if (eq == std::string::npos) {
+      continue;
+    }
+    std::string key = Trim(entry.substr(0, eq));
+    std::string value = Trim(entry.substr(eq + 1));
+    int head_num = 0;
+    if (key == "classes") {
+      head->class_num = atoi(value.c_str());
+      if (head->class_num <= 0 || head->class_num > OBJ_CLASS_MAX_NUM) {
+        LOG_ERROR("head config: invalid classes=%s\n", value.c_str());
+        return -1;
+      }
+      continue;
+    } else if (key == "strides") {
+      head_num = ParseIntList(value, head->strides, OBJ_HEAD_MAX_NUM);
+    } else if (key == "anchors") {
+      // the anchors of consecutive heads are separated by '|'
+      size_t anchor_begin = 0;
+      while (anchor_begin <= value.size() && head_num < OBJ_HEAD_MAX_NUM) {
+        size_t anchor_end = value.find('|', anchor_begin);
+        if (anchor_end == std::string::npos) {
+          anchor_end = value.size();
+        }
+        std::string anchor = value.substr(anchor_begin, anchor_end - anchor_begin);
+        if (ParseIntList(anchor, head->anchors[head_num], OBJ_ANCHOR_NUM * 2) !=
+            OBJ_ANCHOR_NUM * 2) {
+          LOG_ERROR("head config: head %d needs %d anchor values\n", head_num, OBJ_ANCHOR_NUM * 2);
+          return -1;
+        }
+        head_num++;
+        anchor_begin = anchor_end + 1;
+      }
+    } else {
+      continue;
     }
-    buffer = (char *)tmp;
+    if (head_num == 0 || (head->head_num != 0 && head->head_num != head_num)) {
+      LOG_ERROR("head config: inconsistent number of heads in %s\n", key.c_str());
+      return -1;
+    }
+    head->head_num = head_num;
+  }
+  return 0;
+}
 
-    buffer[i] = (char)ch;
-    i++;
+// channel count and grid size of an output, whatever its layout
+static void GetOutputShape(const rknn_tensor_attr & attr, int * channel, int * grid_h, int * grid_w)
+{
+  if (attr.fmt == RKNN_TENSOR_NHWC) {
+    *grid_h = attr.dims[1];
+    *grid_w = attr.dims[2];
+    *channel = attr.dims[3];
+  } else if (attr.fmt == RKNN_TENSOR_NC1HWC2) {
+    // channel count including the padding of the last C2 block
+    *grid_h = attr.dims[2];
+    *grid_w = attr.dims[3];
+    *channel = attr.dims[1] * attr.dims[4];
+  } else {
+    *channel = attr.dims[1];
+    *grid_h = attr.dims[2];
+    *grid_w = attr.dims[3];
   }
-  buffer[i] = '\0';
+}
 
-  *len = buff_len;
+int LoadHeadConfig(
+  const char * model_path, const char * custom_string, int model_in_h, int model_in_w,
+  const rknn_tensor_attr * output_attrs, int n_output, HeadConfig * head)
+{
+  if (n_output <= 0 || n_output > OBJ_HEAD_MAX_NUM) {
+    LOG_ERROR("head config: unsupported number of outputs %d\n", n_output);
+    return -1;
+  }
 
-  // Detect end
-  if (ch == EOF && (i == 0 || ferror(fp))) {
-    free(buffer);
-    return NULL;
+  // "model/best.rknn" -> "model/best.head"
+  std::string sidecar_path(model_path);
+  size_t dot = sidecar_path.find_last_of('.');
+  if (dot != std::string::npos && sidecar_path.find('/', dot) == std::string::npos) {
+    sidecar_path.erase(dot);
   }
-  return buffer;
+  sidecar_path += ".head";
+
+  HeadConfig parsed;
+  memset(&parsed, 0, sizeof(HeadConfig));
+  std::string text;
+  const char * source = "output attrs";
+  if (ReadTextFile(sidecar_path.c_str(), &text) == 0) {
+    source = sidecar_path.c_str();
+  } else if (custom_string != nullptr && strchr(custom_string, '=') != nullptr) {
+    text = custom_string;
+    source = "custom string";
+  }
+  if (!text.empty() && ParseHeadConfig(text.c_str(), &parsed) < 0) {
+    LOG_ERROR("head config: failed to parse %s\n", source);
+    return -1;
+  }
+  if (parsed.head_num != 0 && parsed.head_num != n_output) {
+    LOG_ERROR(
+      "head config: %s describes %d heads, model has %d\n", source, parsed.head_num, n_output);
+    return -1;
+  }
+
+  memset(head, 0, sizeof(HeadConfig));
+  head->head_num = n_output;
+  for (int i = 0; i < n_output; ++i) {
+    int channel, grid_h, grid_w;
+    GetOutputShape(output_attrs[i], &channel, &grid_h, &grid_w);
+    int class_num = channel / OBJ_ANCHOR_NUM - 5;
+    if (channel % OBJ_ANCHOR_NUM != 0 || class_num <= 0 || class_num > OBJ_CLASS_MAX_NUM ||
+        (i > 0 && class_num != head->class_num)) {
+      LOG_ERROR("head config: output %d has an unexpected channel count %d\n", i, channel);
+      return -1;
+    }
+    head->class_num = class_num;
+    head->strides[i] = grid_h > 0 ? model_in_h / grid_h : 0;
+    if (grid_w <= 0 || head->strides[i] != model_in_w / grid_w ||
+        (parsed.strides[0] != 0 && parsed.strides[i] != head->strides[i])) {
+      LOG_ERROR("head config: output %d grid %dx%d does not match its stride\n", i, grid_h, grid_w);
+      return -1;
+    }
+  }
+  if (parsed.class_num != 0 && parsed.class_num != head->class_num) {
+    LOG_ERROR(
+      "head config: %s has %d classes, outputs have %d\n", source, parsed.class_num,
+      head->class_num);
+    return -1;
+  }
+
+  if (parsed.anchors[0][0] != 0) {
+    memcpy(head->anchors, parsed.anchors, sizeof(head->anchors));
+  } else if (n_output == 3) {
+    memcpy(head->anchors, anchors_p5, sizeof(anchors_p5));
+  } else if (n_output == 4) {
+    memcpy(head->anchors, anchors_p6, sizeof(anchors_p6));
+  } else {
+    LOG_ERROR("head config: no default anchors for %d heads\n", n_output);
+    return -1;
+  }
+
+  LOG_INFO("head config from %s: classes=%d, heads=%d\n", source, head->class_num, head->head_num);
+  return 0;
 }
 
-int ReadLines(const char * filename, char * lines[], int max_line)
+// orders candidate indices by descending score, ties keep the decode order
+struct ScoreGreater
+{
+  const float * scores;
+  bool operator()(int a, int b) const
+  {
+    return scores[a] > scores[b] || (scores[a] == scores[b] && a < b);
+  }
+};
+
+// move the k best candidates to the front of indices, in no particular order
+static void SelectTopK(const float * scores, int * indices, int count, int k)
+{
+  if (k <= 0 || k >= count) {
+    return;
+  }
+  std::nth_element(indices, indices + k - 1, indices + count, ScoreGreater{scores});
+}
+
+inline static int32_t Clip(float val, float min, float max)
+{
+  float f = val <= min ? min : (val >= max ? max : val);
+  return f;
+}
+
+static int8_t QntF32ToAffine(float f32, int32_t zp, float scale)
+{
+  float dst_val = (f32 / scale) + zp;
+  int8_t res = (int8_t)Clip(dst_val, -128, 127);
+  return res;
+}
+
+static float DeqntAffineToF32(int8_t qnt, int32_t zp, float scale)
+{
+  return ((float)qnt - (float)zp) * scale;
+}
+
+static void BuildDequantTable(int32_t zp, float scale, DequantTable * table)
+{
+  for (int i = 0; i < 256; ++i) {
+    int8_t qnt = (int8_t)(uint8_t)i;
+    float value = DeqntAffineToF32(qnt, zp, scale);
+    // same expressions as the former per-element decode, so the tables are bit-exact
+    table->raw[i] = value;
+    table->xy[i] = value * 2.0 - 0.5;
+    float wh = value * 2.0;
+    table->wh[i] = wh * wh;
+  }
+}
+
+int ScanObjectnessScalar(const int8_t * conf, int count, int8_t threshold, int * indices)
 {
-  FILE * file = fopen(filename, "r");
-  char * s;
-  int i = 0;
   int n = 0;
+  for (int i = 0; i < count; ++i) {
+    if (conf[i] >= threshold) {
+      indices[n++] = i;
+    }
+  }
+  return n;
+}
 
-  if (file == NULL) {
-    printf("Open %s fail!\n", filename);
-    return -1;
+int ScanObjectness(const int8_t * conf, int count, int8_t threshold, int * indices)
+{
+  int n = 0;
+  int i = 0;
+#if defined(DET_RK3588_SCAN_NEON)
+  // 16 cells per step, the compare mask is narrowed to one nibble per lane
+  const int8x16_t thres = vdupq_n_s8(threshold);
+  for (; i + 16 <= count; i += 16) {
+    uint8x16_t ge = vcgeq_s8(vld1q_s8(conf + i), thres);
+    uint64_t bits =
+      vget_lane_u64(vreinterpret_u64_u8(vshrn_n_u16(vreinterpretq_u16_u8(ge), 4)), 0);
+    bits &= 0x8888888888888888ULL;
+    while (bits != 0) {
+      indices[n++] = i + (__builtin_ctzll(bits) >> 2);
+      bits &= bits - 1;
+    }
+  }
+#elif defined(DET_RK3588_SCAN_AVX2)
+  // 32 cells per step, conf >= thres is computed as !(thres > conf)
+  const __m256i thres = _mm256_set1_epi8(threshold);
+  for (; i + 32 <= count; i += 32) {
+    __m256i v = _mm256_loadu_si256((const __m256i *)(conf + i));
+    uint32_t bits = ~(uint32_t)_mm256_movemask_epi8(_mm256_cmpgt_epi8(thres, v));
+    while (bits != 0) {
+      indices[n++] = i + __builtin_ctz(bits);
+      bits &= bits - 1;
+    }
+  }
+#elif defined(DET_RK3588_SCAN_SSE2)
+  // 16 cells per step, conf >= thres is computed as !(thres > conf)
+  const __m128i thres = _mm_set1_epi8(threshold);
+  for (; i + 16 <= count; i += 16) {
+    __m128i v = _mm_loadu_si128((const __m128i *)(conf + i));
+    uint32_t bits = ~(uint32_t)_mm_movemask_epi8(_mm_cmpgt_epi8(thres, v)) & 0xFFFFu;
+    while (bits != 0) {
+      indices[n++] = i + __builtin_ctz(bits);
+      bits &= bits - 1;
+    }
   }
+#endif
+  // remaining cells
+  for (; i < count; ++i) {
+    if (conf[i] >= threshold) {
+      indices[n++] = i;
+    }
+  }
+  return n;
+}
+
+static_assert(OBJ_NUMB_MAX_SIZE <= NmsEngine::kMaxKeep, "NmsEngine keeps at most 64 boxes");
+
+constexpr int PostProcessor::kMaxHeadNum;
+constexpr int PostProcessor::kDefaultPreNmsTopK;
+
+PostProcessor::PostProcessor()
+: model_in_h_(0),
+  model_in_w_(0),
+  n_output_(0),
+  pre_nms_top_k_(kDefaultPreNmsTopK),
+  max_per_head_(0),
+  conf_threshold_(BOX_THRESH),
+  nms_threshold_(NMS_THRESH),
+  any_class_enabled_(true),
+  decode_threads_(1),
+  decode_generation_(0),
+  decode_pending_(0),
+  decode_quit_(false),
+  stage_times_enabled_(false),
+  stage_times_(),
+  valid_count_(0)
+{
+}
+
+PostProcessor::~PostProcessor() { StopDecodeWorkers(); }
 
-  while ((s = ReadLine(file, s, &n)) != NULL) {
-    lines[i++] = s;
-    if (i >= max_line) break;
+void PostProcessor::SetThresholds(float conf_threshold, float nms_threshold)
+{
+  conf_threshold_ = conf_threshold;
+  nms_threshold_ = nms_threshold;
+  UpdateQuantizedThresholds();
+}
+
+int PostProcessor::SetClassThreshold(int class_id, float threshold)
+{
+  if (class_id < 0 || class_id >= (int)class_thresholds_.size()) {
+    return -1;
   }
-  fclose(file);
-  return i;
+  class_thresholds_[class_id] = threshold;
+  UpdateQuantizedThresholds();
+  return 0;
 }
 
-int LoadLabelName(const char * location_filename, char * label[])
+int PostProcessor::SetClassEnabled(int class_id, bool enabled)
 {
-  printf("loadLabelName %s\n", location_filename);
-  ReadLines(location_filename, label, OBJ_CLASS_NUM);
+  if (class_id < 0 || class_id >= (int)class_enabled_.size()) {
+    return -1;
+  }
+  class_enabled_[class_id] = enabled;
+  UpdateQuantizedThresholds();
   return 0;
 }
 
-static float CalculateOverlap(
-  float xmin0, float ymin0, float xmax0, float ymax0, float xmin1, float ymin1, float xmax1,
-  float ymax1)
+int PostProcessor::SetClassAllowList(const std::vector<int> & class_ids)
 {
-  float w = fmax(0.f, fmin(xmax0, xmax1) - fmax(xmin0, xmin1) + 1.0);
-  float h = fmax(0.f, fmin(ymax0, ymax1) - fmax(ymin0, ymin1) + 1.0);
-  float i = w * h;
-  float u = (xmax0 - xmin0 + 1.0) * (ymax0 - ymin0 + 1.0) +
-            (xmax1 - xmin1 + 1.0) * (ymax1 - ymin1 + 1.0) - i;
-  return u <= 0.f ? 0.f : (i / u);
+  for (int id : class_ids) {
+    if (id < 0 || id >= (int)class_enabled_.size()) {
+      return -1;
+    }
+  }
+  std::fill(class_enabled_.begin(), class_enabled_.end(), class_ids.empty());
+  for (int id : class_ids) {
+    class_enabled_[id] = true;
+  }
+  UpdateQuantizedThresholds();
+  return 0;
 }
 
-static int Nms(
-  int valid_count, std::vector<float> & output_locations, std::vector<int> class_ids,
-  std::vector<int> & order, int filter_id, float threshold)
+void PostProcessor::UpdateQuantizedThresholds()
 {
-  for (int i = 0; i < valid_count; ++i) {
-    if (order[i] == -1 || class_ids[i] != filter_id) {
+  int class_num = (int)class_enabled_.size();
+  // the objectness gate is the lowest threshold of the enabled classes
+  float min_threshold = 0.f;
+  any_class_enabled_ = false;
+  for (int k = 0; k < class_num; ++k) {
+    if (!class_enabled_[k]) {
       continue;
     }
-    int n = order[i];
-    for (int j = i + 1; j < valid_count; ++j) {
-      int m = order[j];
-      if (m == -1 || class_ids[i] != filter_id) {
-        continue;
-      }
-      float xmin0 = output_locations[n * 4 + 0];
-      float ymin0 = output_locations[n * 4 + 1];
-      float xmax0 = output_locations[n * 4 + 0] + output_locations[n * 4 + 2];
-      float ymax0 = output_locations[n * 4 + 1] + output_locations[n * 4 + 3];
-
-      float xmin1 = output_locations[m * 4 + 0];
-      float ymin1 = output_locations[m * 4 + 1];
-      float xmax1 = output_locations[m * 4 + 0] + output_locations[m * 4 + 2];
-      float ymax1 = output_locations[m * 4 + 1] + output_locations[m * 4 + 3];
+    float threshold = class_thresholds_[k] >= 0.f ? class_thresholds_[k] : conf_threshold_;
+    min_threshold = any_class_enabled_ ? std::min(min_threshold, threshold) : threshold;
+    any_class_enabled_ = true;
+  }
 
-      float iou = CalculateOverlap(xmin0, ymin0, xmax0, ymax0, xmin1, ymin1, xmax1, ymax1);
+  for (int i = 0; i < n_output_; ++i) {
+    obj_thresholds_i8_[i] = QntF32ToAffine(min_threshold, zps_[i], scales_[i]);
+    for (int k = 0; k < class_num; ++k) {
+      float threshold = class_thresholds_[k] >= 0.f ? class_thresholds_[k] : conf_threshold_;
+      // no int8 class probability is above 127
+      class_thresholds_i8_[i][k] =
+        class_enabled_[k] ? QntF32ToAffine(threshold, zps_[i], scales_[i]) : INT8_MAX;
+    }
+  }
+}
 
-      if (iou > threshold) {
-        order[j] = -1;
-      }
+int PostProcessor::LoadLabels(const char * path)
+{
+  std::string text;
+  if (ReadTextFile(path, &text) < 0) {
+    LOG_ERROR("open labels %s fail!\n", path);
+    return -1;
+  }
+  // one label per line, class ids without a line are reported as unknown
+  labels_.clear();
+  size_t begin = 0;
+  while (begin < text.size() && (int)labels_.size() < OBJ_CLASS_MAX_NUM) {
+    size_t end = text.find('\n', begin);
+    if (end == std::string::npos) {
+      end = text.size();
+    }
+    std::string line = text.substr(begin, end - begin);
+    if (!line.empty() && line.back() == '\r') {
+      line.pop_back();
     }
+    labels_.push_back(line);
+    begin = end + 1;
+  }
+  if (head_.class_num > 0 && (int)labels_.size() < head_.class_num) {
+    LOG_INFO("labels %s has %d of %d classes\n", path, (int)labels_.size(), head_.class_num);
   }
   return 0;
 }
 
-static int QuickSortIndiceInverse(
-  std::vector<float> & input, int left, int right, std::vector<int> & indices)
+void PostProcessor::SetCandidateLimits(int pre_nms_top_k, int max_per_head)
 {
-  float key;
-  int key_index;
-  int low = left;
-  int high = right;
-  if (left < right) {
-    key_index = indices[left];
-    key = input[left];
-    while (low < high) {
-      while (low < high && input[high] <= key) {
-        high--;
+  pre_nms_top_k_ = pre_nms_top_k;
+  max_per_head_ = max_per_head;
+}
+
+int PostProcessor::Init(
+  int model_in_h, int model_in_w, const HeadConfig & head, const rknn_tensor_attr * output_attrs,
+  int n_output)
+{
+  if (n_output != head.head_num || n_output > kMaxHeadNum) {
+    LOG_ERROR("postprocess expects %d outputs, got %d\n", head.head_num, n_output);
+    return -1;
+  }
+  model_in_h_ = model_in_h;
+  model_in_w_ = model_in_w;
+  n_output_ = n_output;
+  head_ = head;
+
+  // every cell of every anchor may become a candidate
+  int max_candidates = 0;
+  for (int i = 0; i < n_output; ++i) {
+    int channel;
+    GetOutputShape(output_attrs[i], &channel, &grid_h_[i], &grid_w_[i]);
+    int cells = grid_h_[i] * grid_w_[i];
+    int prop_channels = OBJ_ANCHOR_NUM * (5 + head.class_num);
+    // channel k of a cell is at cell * cell_stride + channel_offsets[k]
+    channel_offsets_[i].resize(prop_channels);
+    if (output_attrs[i].fmt == RKNN_TENSOR_NHWC) {
+      cell_strides_[i] = channel;
+      for (int k = 0; k < prop_channels; ++k) {
+        channel_offsets_[i][k] = k;
+      }
+    } else if (output_attrs[i].fmt == RKNN_TENSOR_NC1HWC2) {
+      int c2 = output_attrs[i].dims[4];
+      cell_strides_[i] = c2;
+      for (int k = 0; k < prop_channels; ++k) {
+        channel_offsets_[i][k] = (k / c2) * cells * c2 + k % c2;
       }
-      input[low] = input[high];
-      indices[low] = indices[high];
-      while (low < high && input[low] >= key) {
-        low++;
+    } else {
+      cell_strides_[i] = 1;
+      for (int k = 0; k < prop_channels; ++k) {
+        channel_offsets_[i][k] = k * cells;
       }
-      input[high] = input[low];
-      indices[high] = indices[low];
     }
-    input[low] = key;
-    indices[low] = key_index;
-    QuickSortIndiceInverse(input, left, low - 1, indices);
-    QuickSortIndiceInverse(input, low + 1, right, indices);
+    zps_[i] = output_attrs[i].zp;
+    scales_[i] = output_attrs[i].scale;
+    BuildDequantTable(zps_[i], scales_[i], &tables_[i]);
+    max_candidates += cells * OBJ_ANCHOR_NUM;
   }
-  return low;
+  nms_.Init(model_in_w, model_in_h, head.class_num);
+  class_thresholds_.assign(head.class_num, -1.f);
+  class_enabled_.assign(head.class_num, 1);
+  for (int i = 0; i < n_output; ++i) {
+    class_thresholds_i8_[i].resize(head.class_num);
+  }
+  UpdateQuantizedThresholds();
+  box_x1_.resize(max_candidates);
+  box_y1_.resize(max_candidates);
+  box_x2_.resize(max_candidates);
+  box_y2_.resize(max_candidates);
+  obj_probs_.resize(max_candidates);
+  class_ids_.resize(max_candidates);
+  order_.resize(max_candidates);
+  cell_indices_.resize(max_candidates / OBJ_ANCHOR_NUM);
+  BuildDecodeTasks();
+  return 0;
 }
 
-static float Sigmoid(float x) { return 1.0 / (1.0 + expf(-x)); }
+void PostProcessor::SetDecodeThreads(int num_threads)
+{
+  StopDecodeWorkers();
+  decode_threads_ = std::max(num_threads, 1);
+  BuildDecodeTasks();
+  StartDecodeWorkers();
+}
 
-static float Unsigmoid(float y) { return -1.0 * logf((1.0 / y) - 1.0); }
+void PostProcessor::StartDecodeWorkers()
+{
+  decode_quit_ = false;
+  // the calling thread is worker 0
+  for (int w = 1; w < decode_threads_; ++w) {
+    decode_workers_.emplace_back(&PostProcessor::DecodeWorker, this, w, decode_generation_);
+  }
+}
 
-inline static int32_t Clip(float val, float min, float max)
+void PostProcessor::StopDecodeWorkers()
 {
-  float f = val <= min ? min : (val >= max ? max : val);
-  return f;
+  {
+    std::lock_guard<std::mutex> guard(decode_mutex_);
+    decode_quit_ = true;
+  }
+  decode_start_cv_.notify_all();
+  for (auto & worker : decode_workers_) {
+    worker.join();
+  }
+  decode_workers_.clear();
 }
 
-static int8_t QntF32ToAffine(float f32, int32_t zp, float scale)
+void PostProcessor::DecodeWorker(int worker, unsigned generation)
 {
-  float dst_val = (f32 / scale) + zp;
-  int8_t res = (int8_t)Clip(dst_val, -128, 127);
-  return res;
+  while (true) {
+    {
+      std::unique_lock<std::mutex> lock(decode_mutex_);
+      decode_start_cv_.wait(
+        lock, [&] { return decode_quit_ || decode_generation_ != generation; });
+      if (decode_quit_) {
+        return;
+      }
+      generation = decode_generation_;
+    }
+    DecodeBands(worker);
+    bool last = false;
+    {
+      std::lock_guard<std::mutex> guard(decode_mutex_);
+      last = --decode_pending_ == 0;
+    }
+    if (last) {
+      decode_done_cv_.notify_one();
+    }
+  }
 }
 
-static float DeqntAffineToF32(int8_t qnt, int32_t zp, float scale)
+void PostProcessor::DecodeBands(int worker)
 {
-  return ((float)qnt - (float)zp) * scale;
+  int task_num = (int)tasks_.size();
+  for (int t = worker; t < task_num; t += decode_threads_) {
+    DecodeBand(&tasks_[t]);
+  }
 }
 
-static int Process(
-  int8_t * input, int * anchor, int grid_h, int grid_w, int height, int width, int stride,
-  std::vector<float> & boxes, std::vector<float> & obj_probs, std::vector<int> & class_id,
-  float threshold, int32_t zp, float scale)
-{
-  int valid_count = 0;
-  int grid_len = grid_h * grid_w;
-  int8_t thres_i8 = QntF32ToAffine(threshold, zp, scale);
-  for (int a = 0; a < 3; a++) {
-    for (int i = 0; i < grid_h; i++) {
-      for (int j = 0; j < grid_w; j++) {
-        int8_t box_confidence = input[(PROP_BOX_SIZE * a + 4) * grid_len + i * grid_w + j];
-        if (box_confidence >= thres_i8) {
-          int offset = (PROP_BOX_SIZE * a) * grid_len + i * grid_w + j;
-          int8_t * in_ptr = input + offset;
-          float box_x = (DeqntAffineToF32(*in_ptr, zp, scale)) * 2.0 - 0.5;
-          float box_y = (DeqntAffineToF32(in_ptr[grid_len], zp, scale)) * 2.0 - 0.5;
-          float box_w = (DeqntAffineToF32(in_ptr[2 * grid_len], zp, scale)) * 2.0;
-          float box_h = (DeqntAffineToF32(in_ptr[3 * grid_len], zp, scale)) * 2.0;
-          box_x = (box_x + j) * (float)stride;
-          box_y = (box_y + i) * (float)stride;
-          box_w = box_w * box_w * (float)anchor[a * 2];
-          box_h = box_h * box_h * (float)anchor[a * 2 + 1];
-          box_x -= (box_w / 2.0);
-          box_y -= (box_h / 2.0);
-
-          int8_t max_class_probs = in_ptr[5 * grid_len];
-          int maxClassId = 0;
-          for (int k = 1; k < OBJ_CLASS_NUM; ++k) {
-            int8_t prob = in_ptr[(5 + k) * grid_len];
-            if (prob > max_class_probs) {
-              maxClassId = k;
-              max_class_probs = prob;
-            }
-          }
-          if (max_class_probs > thres_i8) {
-            obj_probs.push_back(
-              (DeqntAffineToF32(max_class_probs, zp, scale)) *
-              (DeqntAffineToF32(box_confidence, zp, scale)));
-            class_id.push_back(maxClassId);
-            valid_count++;
-            boxes.push_back(box_x);
-            boxes.push_back(box_y);
-            boxes.push_back(box_w);
-            boxes.push_back(box_h);
-          }
+void PostProcessor::BuildDecodeTasks()
+{
+  tasks_.clear();
+  int total_cells = 0;
+  for (int i = 0; i < n_output_; ++i) {
+    total_cells += grid_h_[i] * grid_w_[i];
+  }
+  // heads larger than an even share of the cells, in practice stride 8, are cut into row bands
+  int band_cells = (total_cells + decode_threads_ - 1) / decode_threads_;
+  int cells_before = 0;
+  for (int i = 0; i < n_output_; ++i) {
+    int cells = grid_h_[i] * grid_w_[i];
+    int band_num = std::min(std::max((cells + band_cells - 1) / band_cells, 1), grid_h_[i]);
+    for (int b = 0; b < band_num; ++b) {
+      DecodeTask task;
+      task.head = i;
+      task.input = nullptr;
+      task.cell_begin = grid_h_[i] * b / band_num * grid_w_[i];
+      task.cell_end = grid_h_[i] * (b + 1) / band_num * grid_w_[i];
+      task.base = cells_before * OBJ_ANCHOR_NUM;
+      task.scan_base = cells_before + task.cell_begin;
+      tasks_.push_back(task);
+    }
+    cells_before += cells;
+  }
+}
+
+template <int kClassNum>
+void PostProcessor::DecodeHead(DecodeTask * task)
+{
+  const int head = task->head;
+  int8_t * input = task->input;
+  const int class_num = kClassNum > 0 ? kClassNum : head_.class_num;
+  const int prop_box_size = 5 + class_num;
+  const int * anchor = head_.anchors[head];
+  const int stride = head_.strides[head];
+  const int grid_w = grid_w_[head];
+  const DequantTable & table = tables_[head];
+  const int8_t * class_thres = class_thresholds_i8_[head].data();
+
+  int grid_len = grid_h_[head] * grid_w;
+  int band_len = task->cell_end - task->cell_begin;
+  int8_t thres_i8 = obj_thresholds_i8_[head];
+  int * candidates = cell_indices_.data() + task->scan_base;
+  for (int a = 0; a < OBJ_ANCHOR_NUM; a++) {
+    // only the cells passing the objectness threshold are decoded
+    int8_t * conf = input + (prop_box_size * a + 4) * grid_len;
+    int candidate_count = ScanObjectness(conf + task->cell_begin, band_len, thres_i8, candidates);
+    int valid_count = 0;
+    for (int c = 0; c < candidate_count; c++) {
+      int cell = task->cell_begin + candidates[c];
+      int offset = (prop_box_size * a) * grid_len + cell;
+      int8_t * in_ptr = input + offset;
+
+      // the best class over all classes, then its own threshold, disabled classes have a
+      // threshold of 127. The scan gates on the lowest threshold, so the objectness is checked
+      // against the one of the class too
+      int8_t max_class_probs = in_ptr[5 * grid_len];
+      int maxClassId = 0;
+      for (int k = 1; k < class_num; ++k) {
+        int8_t prob = in_ptr[(5 + k) * grid_len];
+        if (prob > max_class_probs) {
+          maxClassId = k;
+          max_class_probs = prob;
         }
       }
+      int8_t box_confidence = conf[cell];
+      int8_t class_threshold = class_thres[maxClassId];
+      if (max_class_probs <= class_threshold || box_confidence < class_threshold) {
+        continue;
+      }
+
+      int i = cell / grid_w;
+      int j = cell - i * grid_w;
+      float box_x = table.xy[(uint8_t)in_ptr[0]];
+      float box_y = table.xy[(uint8_t)in_ptr[grid_len]];
+      float box_w = table.wh[(uint8_t)in_ptr[2 * grid_len]];
+      float box_h = table.wh[(uint8_t)in_ptr[3 * grid_len]];
+      box_x = (box_x + j) * (float)stride;
+      box_y = (box_y + i) * (float)stride;
+      box_w = box_w * (float)anchor[a * 2];
+      box_h = box_h * (float)anchor[a * 2 + 1];
+      box_x -= (box_w / 2.0);
+      box_y -= (box_h / 2.0);
+
+      int n = task->base + a * grid_len + task->cell_begin + valid_count;
+      obj_probs_[n] = table.raw[(uint8_t)max_class_probs] * table.raw[(uint8_t)box_confidence];
+      class_ids_[n] = maxClassId;
+      box_x1_[n] = box_x;
+      box_y1_[n] = box_y;
+      box_x2_[n] = box_x + box_w;
+      box_y2_[n] = box_y + box_h;
+      valid_count++;
     }
+    task->counts[a] = valid_count;
   }
-  return valid_count;
 }
 
-int PostProcess(
-  int8_t * input0, int8_t * input1, int8_t * input2, int model_in_h, int model_in_w,
-  float conf_threshold, float nms_threshold, BoxRect pads, float scale_w, float scale_h,
-  std::vector<int32_t> & qnt_zps, std::vector<float> & qnt_scales, DetectResultGroup * group)
+template <int kClassNum>
+void PostProcessor::DecodeHeadInterleaved(DecodeTask * task)
 {
-  static int init = -1;
-  if (init == -1) {
-    int ret = 0;
-    ret = LoadLabelName(LABEL_NALE_TXT_PATH, labels);
-    if (ret < 0) {
-      return -1;
+  const int head = task->head;
+  int8_t * input = task->input;
+  const int class_num = kClassNum > 0 ? kClassNum : head_.class_num;
+  const int prop_box_size = 5 + class_num;
+  const int * anchor = head_.anchors[head];
+  const int stride = head_.strides[head];
+  const int grid_w = grid_w_[head];
+  const int cell_stride = cell_strides_[head];
+  const DequantTable & table = tables_[head];
+  const int8_t * class_thres = class_thresholds_i8_[head].data();
+
+  int grid_len = grid_h_[head] * grid_w;
+  int8_t thres_i8 = obj_thresholds_i8_[head];
+  int * candidates = cell_indices_.data() + task->scan_base;
+  // anchors are still visited one after the other, so the candidates come out in the same order
+  // as with the NCHW decoder
+  for (int a = 0; a < OBJ_ANCHOR_NUM; a++) {
+    const int * channel = channel_offsets_[head].data() + prop_box_size * a;
+    int8_t * conf = input + channel[4];
+    int candidate_count = 0;
+    int valid_count = 0;
+    for (int cell = task->cell_begin; cell < task->cell_end; cell++) {
+      if (conf[cell * cell_stride] >= thres_i8) {
+        candidates[candidate_count++] = cell;
+      }
+    }
+    for (int c = 0; c < candidate_count; c++) {
+      int cell = candidates[c];
+      // the channels of a cell are contiguous, in blocks of C2 for NC1HWC2
+      int8_t * in_ptr = input + cell * cell_stride;
+
+      // the best class over all classes, then its own threshold, disabled classes have a
+      // threshold of 127. The scan gates on the lowest threshold, so the objectness is checked
+      // against the one of the class too
+      int8_t max_class_probs = in_ptr[channel[5]];
+      int maxClassId = 0;
+      for (int k = 1; k < class_num; ++k) {
+        int8_t prob = in_ptr[channel[5 + k]];
+        if (prob > max_class_probs) {
+          maxClassId = k;
+          max_class_probs = prob;
+        }
+      }
+      int8_t box_confidence = in_ptr[channel[4]];
+      int8_t class_threshold = class_thres[maxClassId];
+      if (max_class_probs <= class_threshold || box_confidence < class_threshold) {
+        continue;
+      }
+
+      int i = cell / grid_w;
+      int j = cell - i * grid_w;
+      float box_x = table.xy[(uint8_t)in_ptr[channel[0]]];
+      float box_y = table.xy[(uint8_t)in_ptr[channel[1]]];
+      float box_w = table.wh[(uint8_t)in_ptr[channel[2]]];
+      float box_h = table.wh[(uint8_t)in_ptr[channel[3]]];
+      box_x = (box_x + j) * (float)stride;
+      box_y = (box_y + i) * (float)stride;
+      box_w = box_w * (float)anchor[a * 2];
+      box_h = box_h * (float)anchor[a * 2 + 1];
+      box_x -= (box_w / 2.0);
+      box_y -= (box_h / 2.0);
+
+      int n = task->base + a * grid_len + task->cell_begin + valid_count;
+      obj_probs_[n] = table.raw[(uint8_t)max_class_probs] * table.raw[(uint8_t)box_confidence];
+      class_ids_[n] = maxClassId;
+      box_x1_[n] = box_x;
+      box_y1_[n] = box_y;
+      box_x2_[n] = box_x + box_w;
+      box_y2_[n] = box_y + box_h;
+      valid_count++;
     }
+    task->counts[a] = valid_count;
+  }
+}
+
+void PostProcessor::DecodeBand(DecodeTask * task)
+{
+  bool planar = cell_strides_[task->head] == 1;
+  // common class counts get a class loop with a constant trip count
+  switch (head_.class_num) {
+    case 1:
+      planar ? DecodeHead<1>(task) : DecodeHeadInterleaved<1>(task);
+      break;
+    case 3:
+      planar ? DecodeHead<3>(task) : DecodeHeadInterleaved<3>(task);
+      break;
+    case 80:
+      planar ? DecodeHead<80>(task) : DecodeHeadInterleaved<80>(task);
+      break;
+    default:
+      planar ? DecodeHead<0>(task) : DecodeHeadInterleaved<0>(task);
+      break;
+  }
+}
+
+void PostProcessor::MoveCandidates(int src, int dst, int count)
+{
+  if (src == dst) {
+    return;
+  }
+  for (int i = 0; i < count; ++i) {
+    obj_probs_[dst + i] = obj_probs_[src + i];
+    class_ids_[dst + i] = class_ids_[src + i];
+    box_x1_[dst + i] = box_x1_[src + i];
+    box_y1_[dst + i] = box_y1_[src + i];
+    box_x2_[dst + i] = box_x2_[src + i];
+    box_y2_[dst + i] = box_y2_[src + i];
+  }
+}
+
+void PostProcessor::Decode(int8_t * const * outputs)
+{
+  int task_num = (int)tasks_.size();
+  for (int t = 0; t < task_num; ++t) {
+    tasks_[t].input = outputs[tasks_[t].head];
+  }
+  if (!decode_workers_.empty()) {
+    // the bands write to disjoint slices, the calling thread decodes its own share meanwhile
+    {
+      std::lock_guard<std::mutex> guard(decode_mutex_);
+      decode_pending_ = (int)decode_workers_.size();
+      ++decode_generation_;
+    }
+    decode_start_cv_.notify_all();
+    DecodeBands(0);
+    std::unique_lock<std::mutex> lock(decode_mutex_);
+    decode_done_cv_.wait(lock, [this] { return decode_pending_ == 0; });
+  } else {
+    DecodeBands(0);
+  }
+
+  // compact the slices in head, anchor, band order, which is both their memory order and the
+  // order of a serial decode, so the results do not depend on the number of threads
+  valid_count_ = 0;
+  int t = 0;
+  for (int head = 0; head < n_output_; ++head) {
+    int head_start = valid_count_;
+    int first = t;
+    while (t < task_num && tasks_[t].head == head) {
+      ++t;
+    }
+    for (int a = 0; a < OBJ_ANCHOR_NUM; ++a) {
+      for (int i = first; i < t; ++i) {
+        const DecodeTask & task = tasks_[i];
+        int grid_len = grid_h_[head] * grid_w_[head];
+        MoveCandidates(task.base + a * grid_len + task.cell_begin, valid_count_, task.counts[a]);
+        valid_count_ += task.counts[a];
+      }
+    }
+    int head_count = valid_count_ - head_start;
+    if (max_per_head_ > 0 && head_count > max_per_head_) {
+      valid_count_ = head_start + KeepTopK(head_start, head_count, max_per_head_);
+    }
+  }
+}
+
+int PostProcessor::KeepTopK(int start, int count, int k)
+{
+  int * indices = order_.data();
+  for (int i = 0; i < count; ++i) {
+    indices[i] = start + i;
+  }
+  SelectTopK(obj_probs_.data(), indices, count, k);
+  // compact in decode order, every kept index is >= its destination so nothing is overwritten
+  std::sort(indices, indices + k);
+  for (int i = 0; i < k; ++i) {
+    int n = indices[i];
+    int dst = start + i;
+    obj_probs_[dst] = obj_probs_[n];
+    class_ids_[dst] = class_ids_[n];
+    box_x1_[dst] = box_x1_[n];
+    box_y1_[dst] = box_y1_[n];
+    box_x2_[dst] = box_x2_[n];
+    box_y2_[dst] = box_y2_[n];
+  }
+  return k;
+}
+
+static double StageClockUs()
+{
+  return std::chrono::duration<double, std::micro>(
+           std::chrono::steady_clock::now().time_since_epoch())
+    .count();
+}
+
+void PostProcessor::EnableStageTimes(bool enable)
+{
+  stage_times_enabled_ = enable;
+  stage_times_ = StageTimes();
+}
 
-    init = 0;
-  }
-  memset(group, 0, sizeof(DetectResultGroup));
-
-  std::vector<float> filter_boxes;
-  std::vector<float> obj_probs;
-  std::vector<int> class_id;
-
-  // stride 8
-  int stride0 = 8;
-  int grid_h0 = model_in_h / stride0;
-  int grid_w0 = model_in_w / stride0;
-  int valid_count0 = 0;
-  valid_count0 = Process(
-    input0, (int *)anchor0, grid_h0, grid_w0, model_in_h, model_in_w, stride0, filter_boxes,
-    obj_probs, class_id, conf_threshold, qnt_zps[0], qnt_scales[0]);
-
-  // stride 16
-  int stride1 = 16;
-  int grid_h1 = model_in_h / stride1;
-  int grid_w1 = model_in_w / stride1;
-  int valid_count1 = 0;
-  valid_count1 = Process(
-    input1, (int *)anchor1, grid_h1, grid_w1, model_in_h, model_in_w, stride1, filter_boxes,
-    obj_probs, class_id, conf_threshold, qnt_zps[1], qnt_scales[1]);
-
-  // stride 32
-  int stride2 = 32;
-  int grid_h2 = model_in_h / stride2;
-  int grid_w2 = model_in_w / stride2;
-  int valid_count2 = 0;
-  valid_count2 = Process(
-    input2, (int *)anchor2, grid_h2, grid_w2, model_in_h, model_in_w, stride2, filter_boxes,
-    obj_probs, class_id, conf_threshold, qnt_zps[2], qnt_scales[2]);
-
-  int valid_count = valid_count0 + valid_count1 + valid_count2;
+int PostProcessor::Run(
+  int8_t * const * outputs, BoxRect pads, float scale_w, float scale_h, DetectResultGroup * group)
+{
+  group->count = 0;
+  valid_count_ = 0;
+
+  // every class is filtered out
+  if (!any_class_enabled_) {
+    return 0;
+  }
+  double stage_start = stage_times_enabled_ ? StageClockUs() : 0.0;
+  if (stage_times_enabled_) {
+    stage_times_ = StageTimes();
+  }
+  Decode(outputs);
+  if (stage_times_enabled_) {
+    stage_times_.decode_us = StageClockUs() - stage_start;
+  }
+
+  int valid_count = valid_count_;
   // no object detect
   if (valid_count <= 0) {
     return 0;
   }
 
-  std::vector<int> index_array;
+  int * index_array = order_.data();
   for (int i = 0; i < valid_count; ++i) {
-    index_array.push_back(i);
+    index_array[i] = i;
   }
 
-  QuickSortIndiceInverse(obj_probs, 0, valid_count - 1, index_array);
-
-  std::set<int> class_set(std::begin(class_id), std::end(class_id));
+  // only the best pre_nms_top_k candidates are sorted and reach NMS
+  if (pre_nms_top_k_ > 0 && valid_count > pre_nms_top_k_) {
+    SelectTopK(obj_probs_.data(), index_array, valid_count, pre_nms_top_k_);
+    valid_count = pre_nms_top_k_;
+  }
+  std::sort(index_array, index_array + valid_count, ScoreGreater{obj_probs_.data()});
+  if (stage_times_enabled_) {
+    stage_start += stage_times_.decode_us;
+    stage_times_.sort_us = StageClockUs() - stage_start;
+  }
 
-  for (auto c : class_set) {
-    Nms(valid_count, filter_boxes, class_id, index_array, c, nms_threshold);
+  // all classes in one pass, stops once OBJ_NUMB_MAX_SIZE boxes are kept
+  int keep_count = nms_.Run(
+    box_x1_.data(), box_y1_.data(), box_x2_.data(), box_y2_.data(), class_ids_.data(), index_array,
+    valid_count, nms_threshold_, OBJ_NUMB_MAX_SIZE, keep_);
+  if (stage_times_enabled_) {
+    stage_start += stage_times_.sort_us;
+    stage_times_.nms_us = StageClockUs() - stage_start;
   }
 
   int last_count = 0;
-  group->count = 0;
   /* box valid detect target */
-  for (int i = 0; i < valid_count; ++i) {
-    if (index_array[i] == -1 || last_count >= OBJ_NUMB_MAX_SIZE) {
-      continue;
-    }
-    int n = index_array[i];
-
-    float x1 = filter_boxes[n * 4 + 0] - pads.left;
-    float y1 = filter_boxes[n * 4 + 1] - pads.top;
-    float x2 = x1 + filter_boxes[n * 4 + 2];
-    float y2 = y1 + filter_boxes[n * 4 + 3];
-    int id = class_id[n];
-    float obj_conf = obj_probs[i];
-
-    group->results[last_count].box.left = (int)(Clamp(x1, 0, model_in_w) / scale_w);
-    group->results[last_count].box.top = (int)(Clamp(y1, 0, model_in_h) / scale_h);
-    group->results[last_count].box.right = (int)(Clamp(x2, 0, model_in_w) / scale_w);
-    group->results[last_count].box.bottom = (int)(Clamp(y2, 0, model_in_h) / scale_h);
+  for (int i = 0; i < keep_count; ++i) {
+    int n = keep_[i];
+
+    float x1 = box_x1_[n] - pads.left;
+    float y1 = box_y1_[n] - pads.top;
+    float x2 = box_x2_[n] - pads.left;
+    float y2 = box_y2_[n] - pads.top;
+    int id = class_ids_[n];
+    float obj_conf = obj_probs_[n];
+
+    group->results[last_count].box.left = (int)(Clamp(x1, 0, model_in_w_) / scale_w);
+    group->results[last_count].box.top = (int)(Clamp(y1, 0, model_in_h_) / scale_h);
+    group->results[last_count].box.right = (int)(Clamp(x2, 0, model_in_w_) / scale_w);
+    group->results[last_count].box.bottom = (int)(Clamp(y2, 0, model_in_h_) / scale_h);
     group->results[last_count].prop = obj_conf;
-    char * label = labels[id];
+    group->results[last_count].class_id = id;
+    const char * label = id < (int)labels_.size() ? labels_[id].c_str() : "unknown";
     strncpy(group->results[last_count].name, label, OBJ_NAME_MAX_SIZE);
 
-    // printf("result %2d: (%4d, %4d, %4d, %4d), %s\n", i, group->results[last_count].box.left,
-    // group->results[last_count].box.top,
-    //        group->results[last_count].box.right, group->results[last_count].box.bottom, label);
     last_count++;
   }
   group->count = last_count;
+  if (stage_times_enabled_) {
+    stage_start += stage_times_.nms_us;
+    stage_times_.map_us = StageClockUs() - stage_start;
+  }
 
   return 0;
 }
 
-void DeinitPostProcess()
-{
-  for (int i = 0; i < OBJ_CLASS_NUM; i++) {
-    if (labels[i] != nullptr) {
-      free(labels[i]);
-      labels[i] = nullptr;
-    }
-  }
-}
-
 }  // namespace det_rk3588
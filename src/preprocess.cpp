@@ -1,8 +1,31 @@
 #include "preprocess.hpp"
 
+#include <math.h>
+#include <string.h>
+
+#include <algorithm>
+#include <vector>
+
+#include "logger.hpp"
+
+#if !defined(DET_RK3588_DISABLE_SIMD)
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define DET_RK3588_RESIZE_NEON 1
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#define DET_RK3588_RESIZE_SSE2 1
+#endif
+#endif
+
 namespace det_rk3588
 {
 
+// horizontal weights are Q8, so a resized row holds value * 256 in 16 bits, vertical weights are
+// Q15 and sum to kVerticalOne
+static const int kHorizontalOne = 1 << 8;
+static const int kVerticalOne = 1 << 15;
+
 void LetterBox(
   const cv::Mat & image, cv::Mat & padded_image, BoxRect & pads, const float scale,
   const cv::Size & target_size, const cv::Scalar & pad_color)
@@ -26,6 +49,368 @@ void LetterBox(
     pad_color);
 }
 
+// two source taps and their fixed-point weights for each destination index, the bilinear
+// mapping of cv::resize() with INTER_LINEAR: src = (dst + 0.5) / scale - 0.5, clamped to the image
+static void BilinearTaps(
+  int dst_len, int src_len, float scale, int one, int tap_step, int * taps, uint16_t * weights)
+{
+  double inv_scale = 1.0 / scale;
+  for (int d = 0; d < dst_len; ++d) {
+    double pos = (d + 0.5) * inv_scale - 0.5;
+    int index = (int)floor(pos);
+    double frac = pos - index;
+    if (index < 0) {
+      index = 0;
+      frac = 0.0;
+    }
+    if (index >= src_len - 1) {
+      index = src_len - 1;
+      frac = 0.0;
+    }
+    int w1 = (int)lround(frac * one);
+    taps[d * 2] = index * tap_step;
+    taps[d * 2 + 1] = (w1 > 0 ? index + 1 : index) * tap_step;
+    weights[d * 2] = (uint16_t)(one - w1);
+    weights[d * 2 + 1] = (uint16_t)w1;
+  }
+}
+
+// resize one source row horizontally, value * 256 per channel
+template <int kChannels, bool kSwapRb>
+static void ResizeRow(
+  const uint8_t * src, int dst_w, const int * taps, const uint16_t * weights, uint16_t * row)
+{
+  for (int dx = 0; dx < dst_w; ++dx) {
+    const uint8_t * p0 = src + taps[0];
+    const uint8_t * p1 = src + taps[1];
+    int w0 = weights[0];
+    int w1 = weights[1];
+    for (int c = 0; c < kChannels; ++c) {
+      int sc = kSwapRb && c != 1 ? 2 - c : c;
+      row[c] = (uint16_t)(p0[sc] * w0 + p1[sc] * w1);
+    }
+    taps += 2;
+    weights += 2;
+    row += kChannels;
+  }
+}
+
+// out = (r0 * w0 >> 16) + (r1 * w1 >> 16), rounded from value * 128 back to 8 bits, every path
+// truncates the two products the same way so the output does not depend on the instruction set
+static void BlendRows(
+  const uint16_t * r0, const uint16_t * r1, uint16_t w0, uint16_t w1, uint8_t * out, int count)
+{
+  int i = 0;
+#if defined(DET_RK3588_RESIZE_NEON)
+  const uint16x4_t vw0 = vdup_n_u16(w0);
+  const uint16x4_t vw1 = vdup_n_u16(w1);
+  for (; i + 8 <= count; i += 8) {
+    uint16x8_t a = vld1q_u16(r0 + i);
+    uint16x8_t b = vld1q_u16(r1 + i);
+    uint16x8_t pa = vcombine_u16(
+      vshrn_n_u32(vmull_u16(vget_low_u16(a), vw0), 16),
+      vshrn_n_u32(vmull_u16(vget_high_u16(a), vw0), 16));
+    uint16x8_t pb = vcombine_u16(
+      vshrn_n_u32(vmull_u16(vget_low_u16(b), vw1), 16),
+      vshrn_n_u32(vmull_u16(vget_high_u16(b), vw1), 16));
+    vst1_u8(out + i, vrshrn_n_u16(vaddq_u16(pa, pb), 7));
+  }
+#elif defined(DET_RK3588_RESIZE_SSE2)
+  const __m128i vw0 = _mm_set1_epi16((short)w0);
+  const __m128i vw1 = _mm_set1_epi16((short)w1);
+  const __m128i half = _mm_set1_epi16(64);
+  for (; i + 16 <= count; i += 16) {
+    __m128i lo = _mm_add_epi16(
+      _mm_mulhi_epu16(_mm_loadu_si128((const __m128i *)(r0 + i)), vw0),
+      _mm_mulhi_epu16(_mm_loadu_si128((const __m128i *)(r1 + i)), vw1));
+    __m128i hi = _mm_add_epi16(
+      _mm_mulhi_epu16(_mm_loadu_si128((const __m128i *)(r0 + i + 8)), vw0),
+      _mm_mulhi_epu16(_mm_loadu_si128((const __m128i *)(r1 + i + 8)), vw1));
+    lo = _mm_srli_epi16(_mm_add_epi16(lo, half), 7);
+    hi = _mm_srli_epi16(_mm_add_epi16(hi, half), 7);
+    _mm_storeu_si128((__m128i *)(out + i), _mm_packus_epi16(lo, hi));
+  }
+#endif
+  for (; i < count; ++i) {
+    int v = ((r0[i] * w0) >> 16) + ((r1[i] * w1) >> 16);
+    out[i] = (uint8_t)((v + 64) >> 7);
+  }
+}
+
+int GetLetterBoxGeometry(
+  const cv::Size & src_size, const cv::Size & target_size, const float scale,
+  LetterBoxGeometry * geometry)
+{
+  // same rounding of the resized size as cv::resize() with a scale factor
+  int dst_w = std::min((int)lround(src_size.width * (double)scale), target_size.width);
+  int dst_h = std::min((int)lround(src_size.height * (double)scale), target_size.height);
+  if (dst_w <= 0 || dst_h <= 0) {
+    LOG_ERROR("letterbox scale %f is too small\n", scale);
+    return -1;
+  }
+  geometry->src_size = src_size;
+  geometry->target_size = target_size;
+  geometry->resized_size = cv::Size(dst_w, dst_h);
+  geometry->scale = scale;
+
+  int pad_width = target_size.width - dst_w;
+  int pad_height = target_size.height - dst_h;
+  geometry->pads.left = pad_width / 2;
+  geometry->pads.right = pad_width - geometry->pads.left;
+  geometry->pads.top = pad_height / 2;
+  geometry->pads.bottom = pad_height - geometry->pads.top;
+  return 0;
+}
+
+BilinearResizer::BilinearResizer() : scale_(0.f), channels_(0) {}
+
+int BilinearResizer::Prepare(
+  const cv::Size & src_size, const cv::Size & dst_size, float scale, int channels)
+{
+  if (src_size == src_size_ && dst_size == dst_size_ && scale == scale_ && channels == channels_) {
+    return 0;
+  }
+  if (channels < 1 || channels > 3) {
+    LOG_ERROR("unsupported resize channels %d\n", channels);
+    return -1;
+  }
+  if (src_size.width <= 0 || src_size.height <= 0 || dst_size.width <= 0 ||
+      dst_size.height <= 0) {
+    LOG_ERROR(
+      "invalid resize %dx%d -> %dx%d\n", src_size.width, src_size.height, dst_size.width,
+      dst_size.height);
+    return -1;
+  }
+  src_size_ = src_size;
+  dst_size_ = dst_size;
+  scale_ = scale;
+  channels_ = channels;
+  x_taps_.resize(dst_size.width * 2);
+  x_weights_.resize(dst_size.width * 2);
+  y_taps_.resize(dst_size.height * 2);
+  y_weights_.resize(dst_size.height * 2);
+  // horizontal taps are byte offsets into a source row
+  BilinearTaps(
+    dst_size.width, src_size.width, scale, kHorizontalOne, channels, x_taps_.data(),
+    x_weights_.data());
+  BilinearTaps(
+    dst_size.height, src_size.height, scale, kVerticalOne, 1, y_taps_.data(), y_weights_.data());
+  rows_.resize(dst_size.width * channels * 2);
+  return 0;
+}
+
+void BilinearResizer::Run(const cv::Mat & image, uint8_t * dst, size_t dst_stride, bool swap_rb)
+{
+  int dst_w = dst_size_.width;
+  int dst_h = dst_size_.height;
+  int row_len = dst_w * channels_;
+  // two resized source rows, consecutive destination rows mostly share them
+  uint16_t * row_bufs[2] = {rows_.data(), rows_.data() + row_len};
+  int row_ys[2] = {-1, -1};
+
+  for (int dy = 0; dy < dst_h; ++dy) {
+    const int * ys = y_taps_.data() + dy * 2;
+    const uint16_t * r[2];
+    for (int k = 0; k < 2; ++k) {
+      int slot = row_ys[0] == ys[k] ? 0 : (row_ys[1] == ys[k] ? 1 : -1);
+      if (slot < 0) {
+        // keep the row the other tap needs
+        slot = row_ys[0] == ys[1 - k] ? 1 : 0;
+        const uint8_t * src = image.ptr<uint8_t>(ys[k]);
+        const int * taps = x_taps_.data();
+        const uint16_t * weights = x_weights_.data();
+        if (channels_ == 1) {
+          ResizeRow<1, false>(src, dst_w, taps, weights, row_bufs[slot]);
+        } else if (channels_ == 2) {
+          ResizeRow<2, false>(src, dst_w, taps, weights, row_bufs[slot]);
+        } else if (swap_rb) {
+          ResizeRow<3, true>(src, dst_w, taps, weights, row_bufs[slot]);
+        } else {
+          ResizeRow<3, false>(src, dst_w, taps, weights, row_bufs[slot]);
+        }
+        row_ys[slot] = ys[k];
+      }
+      r[k] = row_bufs[slot];
+    }
+    const uint16_t * w = y_weights_.data() + dy * 2;
+    BlendRows(r[0], r[1], w[0], w[1], dst + dy * dst_stride, row_len);
+  }
+}
+
+int LetterBoxBgrToRgb(
+  const cv::Mat & image, uint8_t * dst, BoxRect & pads, const float scale,
+  const cv::Size & target_size, uint8_t pad_value)
+{
+  if (image.type() != CV_8UC3 || image.empty()) {
+    LOG_ERROR("source image type is %d!\n", image.type());
+    return -1;
+  }
+  LetterBoxGeometry geometry;
+  if (GetLetterBoxGeometry(image.size(), target_size, scale, &geometry) < 0) {
+    return -1;
+  }
+  pads = geometry.pads;
+
+  // border rows and the left / right spans of the active rows
+  size_t dst_stride = (size_t)target_size.width * 3;
+  int dst_w = geometry.resized_size.width;
+  int dst_h = geometry.resized_size.height;
+  memset(dst, pad_value, dst_stride * pads.top);
+  for (int dy = 0; dy < dst_h; ++dy) {
+    uint8_t * out = dst + (pads.top + dy) * dst_stride;
+    memset(out, pad_value, pads.left * 3);
+    memset(out + (pads.left + dst_w) * 3, pad_value, pads.right * 3);
+  }
+  memset(dst + (pads.top + dst_h) * dst_stride, pad_value, dst_stride * pads.bottom);
+
+  BilinearResizer resizer;
+  resizer.Prepare(image.size(), geometry.resized_size, scale);
+  resizer.Run(image, dst + pads.top * dst_stride + pads.left * 3, dst_stride, true);
+  return 0;
+}
+
+LetterBoxBuffer::LetterBoxBuffer()
+: ready_(false), pad_value_(128), geometry_(), data_(nullptr), stride_(0)
+{
+}
+
+int LetterBoxBuffer::Init(const cv::Size & target_size, uint8_t pad_value)
+{
+  buffer_.assign((size_t)target_size.area() * 3, pad_value);
+  return Init(target_size, buffer_.data(), (size_t)target_size.width * 3, pad_value);
+}
+
+int LetterBoxBuffer::Init(
+  const cv::Size & target_size, uint8_t * data, size_t stride, uint8_t pad_value)
+{
+  if (data == nullptr || stride < (size_t)target_size.width * 3) {
+    LOG_ERROR("letterbox buffer stride %zu is below %d pixels\n", stride, target_size.width);
+    return -1;
+  }
+  geometry_ = LetterBoxGeometry();
+  geometry_.target_size = target_size;
+  pad_value_ = pad_value;
+  data_ = data;
+  stride_ = stride;
+  ready_ = false;
+  return 0;
+}
+
+int LetterBoxBuffer::UpdateGeometry(const cv::Size & src_size)
+{
+  if (ready_ && src_size == geometry_.src_size) {
+    return 0;
+  }
+  const cv::Size & target_size = geometry_.target_size;
+  float scale = std::min(
+    (float)target_size.width / src_size.width, (float)target_size.height / src_size.height);
+  if (GetLetterBoxGeometry(src_size, target_size, scale, &geometry_) < 0) {
+    ready_ = false;
+    return -1;
+  }
+  // the old active region may be border now, refill everything once
+  memset(data_, pad_value_, stride_ * target_size.height);
+  ready_ = true;
+  return 0;
+}
+
+int LetterBoxBuffer::Write(const cv::Mat & image)
+{
+  if (image.type() != CV_8UC3 || image.empty()) {
+    LOG_ERROR("source image type is %d!\n", image.type());
+    return -1;
+  }
+  if (UpdateGeometry(image.size()) < 0) {
+    return -1;
+  }
+  // the tables are only rebuilt when the geometry changed
+  if (resizer_.Prepare(image.size(), geometry_.resized_size, geometry_.scale) < 0) {
+    return -1;
+  }
+  const BoxRect & pads = geometry_.pads;
+  resizer_.Run(image, data_ + pads.top * stride_ + pads.left * 3, stride_, true);
+  return 0;
+}
+
+// BT.601 limited range to RGB in Q20, the coefficients of cv::cvtColor(COLOR_YUV2RGB_NV12)
+static const int kYuvShift = 20;
+static const int kYuvHalf = 1 << (kYuvShift - 1);
+static const int kCoefY = 1220542;
+static const int kCoefUB = 2116026;
+static const int kCoefUG = -409993;
+static const int kCoefVG = -852492;
+static const int kCoefVR = 1673527;
+
+static inline uint8_t ClampYuv(int value)
+{
+  value >>= kYuvShift;
+  return (uint8_t)(value < 0 ? 0 : (value > 255 ? 255 : value));
+}
+
+// one row of resized luma and interleaved UV, both at the same width, to packed RGB
+static void Nv12RowToRgb(const uint8_t * y, const uint8_t * uv, int width, uint8_t * rgb)
+{
+  for (int x = 0; x < width; ++x) {
+    int luma = std::max(0, y[x] - 16) * kCoefY + kYuvHalf;
+    int u = uv[x * 2] - 128;
+    int v = uv[x * 2 + 1] - 128;
+    rgb[x * 3] = ClampYuv(luma + kCoefVR * v);
+    rgb[x * 3 + 1] = ClampYuv(luma + kCoefUG * u + kCoefVG * v);
+    rgb[x * 3 + 2] = ClampYuv(luma + kCoefUB * u);
+  }
+}
+
+int LetterBoxBuffer::Write(const Nv12Frame & frame)
+{
+  if (frame.y.type() != CV_8UC1 || frame.uv.type() != CV_8UC2 || frame.y.empty() ||
+      frame.y.cols % 2 != 0 || frame.y.rows % 2 != 0 ||
+      frame.uv.size() != cv::Size(frame.y.cols / 2, frame.y.rows / 2)) {
+    LOG_ERROR(
+      "invalid nv12 frame, y %dx%d type %d, uv %dx%d type %d\n", frame.y.cols, frame.y.rows,
+      frame.y.type(), frame.uv.cols, frame.uv.rows, frame.uv.type());
+    return -1;
+  }
+  if (UpdateGeometry(frame.y.size()) < 0) {
+    return -1;
+  }
+  // both planes are resized to the active region first, so the colour conversion runs on
+  // model resolution pixels instead of the full frame
+  const cv::Size & resized_size = geometry_.resized_size;
+  float scale = geometry_.scale;
+  if (luma_resizer_.Prepare(frame.y.size(), resized_size, scale, 1) < 0 ||
+      chroma_resizer_.Prepare(frame.uv.size(), resized_size, scale * 2.f, 2) < 0) {
+    return -1;
+  }
+  size_t width = resized_size.width;
+  luma_.resize(width * resized_size.height);
+  chroma_.resize(width * 2 * resized_size.height);
+  luma_resizer_.Run(frame.y, luma_.data(), width, false);
+  chroma_resizer_.Run(frame.uv, chroma_.data(), width * 2, false);
+
+  const BoxRect & pads = geometry_.pads;
+  uint8_t * out = data_ + pads.top * stride_ + pads.left * 3;
+  for (int dy = 0; dy < resized_size.height; ++dy) {
+    Nv12RowToRgb(
+      luma_.data() + dy * width, chroma_.data() + dy * width * 2, resized_size.width,
+      out + dy * stride_);
+  }
+  return 0;
+}
+
+Nv12Frame WrapNv12(const cv::Mat & nv12)
+{
+  Nv12Frame frame;
+  if (nv12.type() != CV_8UC1 || nv12.rows % 3 != 0 || nv12.cols % 2 != 0) {
+    LOG_ERROR("nv12 image is %dx%d type %d!\n", nv12.cols, nv12.rows, nv12.type());
+    return frame;
+  }
+  int height = nv12.rows * 2 / 3;
+  frame.y = nv12.rowRange(0, height);
+  // headers only, both planes share the reference count of nv12
+  frame.uv = nv12.rowRange(height, nv12.rows).reshape(2);
+  return frame;
+}
+
 int ResizeRga(
   rga_buffer_t & src, rga_buffer_t & dst, const cv::Mat & image, cv::Mat & resized_image,
   const cv::Size & target_size)
@@ -34,12 +419,19 @@ int ResizeRga(
   im_rect dst_rect;
   memset(&src_rect, 0, sizeof(src_rect));
   memset(&dst_rect, 0, sizeof(dst_rect));
-  size_t img_width = image.cols;
-  size_t img_height = image.rows;
   if (image.type() != CV_8UC3) {
-    printf("source image type is %d!\n", image.type());
+    LOG_ERROR("source image type is %d!\n", image.type());
     return -1;
   }
+#if defined(DET_RK3588_NO_RGA)
+  // host builds have no RGA, cv::resize() stands in for it
+  (void)src;
+  (void)dst;
+  cv::resize(image, resized_image, target_size);
+  return 0;
+#else
+  size_t img_width = image.cols;
+  size_t img_height = image.rows;
   size_t target_width = target_size.width;
   size_t target_height = target_size.height;
   src = wrapbuffer_virtualaddr((void *)image.data, img_width, img_height, RK_FORMAT_RGB_888);
@@ -47,11 +439,12 @@ int ResizeRga(
     (void *)resized_image.data, target_width, target_height, RK_FORMAT_RGB_888);
   int ret = imcheck(src, dst, src_rect, dst_rect);
   if (IM_STATUS_NOERROR != ret) {
-    fprintf(stderr, "rga check error! %s", imStrError((IM_STATUS)ret));
+    LOG_ERROR("rga check error! %s\n", imStrError((IM_STATUS)ret));
     return -1;
   }
   IM_STATUS STATUS = imresize(src, dst);
   return 0;
+#endif
 }
 
 }  // namespace det_rk3588
@@ -0,0 +1,584 @@
+// Host-side stand-in for the subset of librknnrt the project uses, so the cpu side of the pipeline
+// builds and runs on any Linux box (cmake -DRKNN_STUB=ON). rknn_run() returns int8 YOLOv5 head
+// outputs, either replayed from recorded dumps or synthesised, after a configurable per-core
+// latency. Runs of contexts bound to the same core queue up behind each other like on the NPU,
+// and rknn_run_extend::non_block runs complete in rknn_wait() or rknn_outputs_get().
+//
+// environment:
+//   RKNN_STUB_INPUT_SIZE  model input width and height, default 640
+//   RKNN_STUB_CLASSES     class count of the synthetic heads, default 80
+//   RKNN_STUB_DENSITY     fraction of synthetic cell anchors above BOX_THRESH, default 0.002
+//   RKNN_STUB_OUTPUTS     directory of recorded outputs, <frame>_<output index>.bin files holding
+//                         the int8 NCHW buffers of rknn_outputs_get(want_float = 0), frames are
+//                         replayed in a loop from 0 on
+//   RKNN_STUB_LATENCY_US  inference time, one value or one per core, e.g. 18000,18000,25000
+//   RKNN_STUB_JITTER_US   uniformly distributed extra time of every run
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "logger.hpp"
+#include "rknn_api.h"
+
+#define STUB_CORE_NUM 3
+#define STUB_HEAD_NUM 3
+#define STUB_ANCHOR_NUM 3
+#define STUB_OUTPUT_ZP -128
+#define STUB_OUTPUT_SCALE (1.f / 255.f)
+// channel block of the int8 NC1HWC2 layout on RK3588
+#define STUB_C2 16
+
+namespace
+{
+
+struct StubModel
+{
+  int input_size;
+  int class_num;
+  rknn_tensor_attr input_attr;
+  rknn_tensor_attr output_attrs[STUB_HEAD_NUM];
+  // frames of NCHW outputs, frame_outputs[frame][output]
+  std::vector<std::vector<std::vector<int8_t>>> frame_outputs;
+  int latency_us[STUB_CORE_NUM];
+  int jitter_us;
+};
+
+struct StubContext
+{
+  std::shared_ptr<StubModel> model;
+  int core;
+  uint64_t runs;
+  std::mt19937 rng;
+  // the run issued last and not waited for yet
+  bool running;
+  std::chrono::steady_clock::time_point finish_at;
+  rknn_tensor_mem * input_mem;
+  rknn_tensor_mem * output_mems[STUB_HEAD_NUM];
+  rknn_tensor_attr output_mem_attrs[STUB_HEAD_NUM];
+  std::vector<int8_t> outputs[STUB_HEAD_NUM];
+};
+
+// time at which each core has worked through the runs queued on it
+std::mutex g_core_mutex;
+std::chrono::steady_clock::time_point g_core_free_at[STUB_CORE_NUM];
+std::mutex g_context_mutex;
+int g_context_num = 0;
+
+int EnvInt(const char * name, int default_value)
+{
+  const char * value = getenv(name);
+  return value != nullptr && value[0] != '\0' ? atoi(value) : default_value;
+}
+
+StubContext * ToContext(rknn_context context) { return reinterpret_cast<StubContext *>(context); }
+
+void InitOutputAttr(int index, int grid, int class_num, rknn_tensor_attr * attr)
+{
+  memset(attr, 0, sizeof(*attr));
+  attr->index = index;
+  attr->n_dims = 4;
+  attr->dims[0] = 1;
+  attr->dims[1] = STUB_ANCHOR_NUM * (5 + class_num);
+  attr->dims[2] = grid;
+  attr->dims[3] = grid;
+  attr->n_elems = attr->dims[1] * grid * grid;
+  attr->size = attr->n_elems;
+  attr->size_with_stride = attr->n_elems;
+  attr->w_stride = grid;
+  attr->fmt = RKNN_TENSOR_NCHW;
+  attr->type = RKNN_TENSOR_INT8;
+  attr->qnt_type = RKNN_TENSOR_QNT_AFFINE_ASYMMETRIC;
+  attr->zp = STUB_OUTPUT_ZP;
+  attr->scale = STUB_OUTPUT_SCALE;
+  snprintf(attr->name, sizeof(attr->name), "output%d", index);
+}
+
+int8_t Quantize(float value)
+{
+  int q = (int)(value / STUB_OUTPUT_SCALE + 0.5f) + STUB_OUTPUT_ZP;
+  return (int8_t)std::max(-128, std::min(127, q));
+}
+
+// positive anchors get a high objectness and one high class score, everything else stays below
+// the default box threshold the way background does
+void SynthesizeOutputs(StubModel * model, float density)
+{
+  std::mt19937 rng(model->input_size * 7919 + model->class_num);
+  std::uniform_real_distribution<float> unit(0.f, 1.f);
+  std::uniform_real_distribution<float> low(0.f, 0.2f);
+  std::uniform_real_distribution<float> high(0.3f, 1.f);
+  std::uniform_int_distribution<int> cls(0, model->class_num - 1);
+  int prop_box_size = 5 + model->class_num;
+
+  model->frame_outputs.resize(1);
+  std::vector<std::vector<int8_t>> & outputs = model->frame_outputs[0];
+  outputs.resize(STUB_HEAD_NUM);
+  for (int i = 0; i < STUB_HEAD_NUM; ++i) {
+    const rknn_tensor_attr & attr = model->output_attrs[i];
+    int grid_len = attr.dims[2] * attr.dims[3];
+    outputs[i].resize(attr.n_elems);
+    for (int a = 0; a < STUB_ANCHOR_NUM; ++a) {
+      int8_t * anchor = outputs[i].data() + a * prop_box_size * grid_len;
+      for (int cell = 0; cell < grid_len; ++cell) {
+        bool positive = unit(rng) < density;
+        int best = cls(rng);
+        for (int k = 0; k < 4; ++k) {
+          anchor[k * grid_len + cell] = Quantize(unit(rng));
+        }
+        anchor[4 * grid_len + cell] = Quantize(positive ? high(rng) : low(rng));
+        for (int k = 0; k < model->class_num; ++k) {
+          float prob = positive && k == best ? high(rng) : low(rng);
+          anchor[(5 + k) * grid_len + cell] = Quantize(prob);
+        }
+      }
+    }
+  }
+}
+
+int LoadRecordedOutputs(StubModel * model, const char * dir)
+{
+  for (int frame = 0;; ++frame) {
+    std::vector<std::vector<int8_t>> outputs(STUB_HEAD_NUM);
+    for (int i = 0; i < STUB_HEAD_NUM; ++i) {
+      std::string path = std::string(dir) + "/" + std::to_string(frame) + "_" +
+                         std::to_string(i) + ".bin";
+      FILE * fp = fopen(path.c_str(), "rb");
+      if (fp == nullptr) {
+        if (i == 0 && frame > 0) {
+          return 0;
+        }
+        LOG_ERROR("rknn stub: cannot open %s\n", path.c_str());
+        return -1;
+      }
+      outputs[i].resize(model->output_attrs[i].n_elems);
+      size_t read = fread(outputs[i].data(), 1, outputs[i].size(), fp);
+      fclose(fp);
+      if (read != outputs[i].size()) {
+        LOG_ERROR("rknn stub: %s holds %zu of %zu bytes\n", path.c_str(), read, outputs[i].size());
+        return -1;
+      }
+    }
+    model->frame_outputs.push_back(outputs);
+  }
+}
+
+void ParseLatency(StubModel * model)
+{
+  int latency = 0;
+  const char * value = getenv("RKNN_STUB_LATENCY_US");
+  for (int core = 0; core < STUB_CORE_NUM; ++core) {
+    if (value != nullptr && value[0] != '\0') {
+      latency = atoi(value);
+      value = strchr(value, ',');
+      value = value != nullptr ? value + 1 : nullptr;
+    }
+    // missing cores repeat the last value
+    model->latency_us[core] = latency;
+  }
+  model->jitter_us = EnvInt("RKNN_STUB_JITTER_US", 0);
+}
+
+std::shared_ptr<StubModel> CreateModel()
+{
+  std::shared_ptr<StubModel> model = std::make_shared<StubModel>();
+  model->input_size = EnvInt("RKNN_STUB_INPUT_SIZE", 640);
+  model->class_num = EnvInt("RKNN_STUB_CLASSES", 80);
+  if (model->input_size <= 0 || model->input_size % 32 != 0 || model->class_num <= 0) {
+    LOG_ERROR(
+      "rknn stub: input size %d must be a multiple of 32, class num %d positive\n",
+      model->input_size, model->class_num);
+    return nullptr;
+  }
+
+  rknn_tensor_attr & input = model->input_attr;
+  memset(&input, 0, sizeof(input));
+  input.n_dims = 4;
+  input.dims[0] = 1;
+  input.dims[1] = model->input_size;
+  input.dims[2] = model->input_size;
+  input.dims[3] = 3;
+  input.n_elems = model->input_size * model->input_size * 3;
+  input.size = input.n_elems;
+  input.size_with_stride = input.n_elems;
+  input.w_stride = model->input_size;
+  input.fmt = RKNN_TENSOR_NHWC;
+  input.type = RKNN_TENSOR_UINT8;
+  input.qnt_type = RKNN_TENSOR_QNT_AFFINE_ASYMMETRIC;
+  input.scale = 1.f;
+  snprintf(input.name, sizeof(input.name), "images");
+  for (int i = 0; i < STUB_HEAD_NUM; ++i) {
+    InitOutputAttr(i, model->input_size / (8 << i), model->class_num, &model->output_attrs[i]);
+  }
+
+  const char * dir = getenv("RKNN_STUB_OUTPUTS");
+  if (dir != nullptr && dir[0] != '\0') {
+    if (LoadRecordedOutputs(model.get(), dir) < 0) {
+      return nullptr;
+    }
+    LOG_INFO("rknn stub: replaying %zu recorded frames\n", model->frame_outputs.size());
+  } else {
+    const char * density = getenv("RKNN_STUB_DENSITY");
+    SynthesizeOutputs(model.get(), density != nullptr ? atof(density) : 0.002f);
+  }
+  ParseLatency(model.get());
+  return model;
+}
+
+// native layouts of an output, dims as the runtime reports them
+void NativeOutputAttr(const rknn_tensor_attr & nchw, rknn_query_cmd cmd, rknn_tensor_attr * attr)
+{
+  *attr = nchw;
+  int channel = nchw.dims[1];
+  int grid_h = nchw.dims[2];
+  int grid_w = nchw.dims[3];
+  if (cmd == RKNN_QUERY_NATIVE_NHWC_OUTPUT_ATTR) {
+    attr->fmt = RKNN_TENSOR_NHWC;
+    attr->dims[1] = grid_h;
+    attr->dims[2] = grid_w;
+    attr->dims[3] = channel;
+    return;
+  }
+  int c1 = (channel + STUB_C2 - 1) / STUB_C2;
+  attr->fmt = RKNN_TENSOR_NC1HWC2;
+  attr->n_dims = 5;
+  attr->dims[1] = c1;
+  attr->dims[2] = grid_h;
+  attr->dims[3] = grid_w;
+  attr->dims[4] = STUB_C2;
+  attr->n_elems = c1 * grid_h * grid_w * STUB_C2;
+  attr->size = attr->n_elems;
+  attr->size_with_stride = attr->n_elems;
+}
+
+// NCHW source to the layout of a bound output memory
+void WriteOutput(const std::vector<int8_t> & nchw, const rknn_tensor_attr & attr, int8_t * dst)
+{
+  if (attr.fmt == RKNN_TENSOR_NHWC) {
+    int cells = attr.dims[1] * attr.dims[2];
+    int channel = attr.dims[3];
+    for (int c = 0; c < channel; ++c) {
+      for (int cell = 0; cell < cells; ++cell) {
+        dst[cell * channel + c] = nchw[c * cells + cell];
+      }
+    }
+  } else if (attr.fmt == RKNN_TENSOR_NC1HWC2) {
+    int cells = attr.dims[2] * attr.dims[3];
+    int c2 = attr.dims[4];
+    int channel = nchw.size() / cells;
+    memset(dst, 0, attr.size_with_stride);
+    for (int c = 0; c < channel; ++c) {
+      for (int cell = 0; cell < cells; ++cell) {
+        dst[(c / c2) * cells * c2 + cell * c2 + c % c2] = nchw[c * cells + cell];
+      }
+    }
+  } else {
+    memcpy(dst, nchw.data(), nchw.size());
+  }
+}
+
+rknn_context NewContext(const std::shared_ptr<StubModel> & model)
+{
+  StubContext * ctx = new StubContext();
+  ctx->model = model;
+  {
+    // the runtime default spreads contexts over the cores
+    std::lock_guard<std::mutex> lock(g_context_mutex);
+    ctx->core = g_context_num % STUB_CORE_NUM;
+    ctx->rng.seed(g_context_num);
+    g_context_num++;
+  }
+  ctx->runs = 0;
+  ctx->running = false;
+  ctx->input_mem = nullptr;
+  memset(ctx->output_mems, 0, sizeof(ctx->output_mems));
+  return reinterpret_cast<rknn_context>(ctx);
+}
+
+// whether every page of [data, data + size) is mapped, mincore() fails with ENOMEM otherwise
+bool IsMapped(const void * data, size_t size)
+{
+  uintptr_t page = sysconf(_SC_PAGESIZE);
+  uintptr_t begin = reinterpret_cast<uintptr_t>(data) & ~(page - 1);
+  uintptr_t end = reinterpret_cast<uintptr_t>(data) + size;
+  std::vector<unsigned char> residency((end - begin + page - 1) / page);
+  return mincore(reinterpret_cast<void *>(begin), end - begin, residency.data()) == 0;
+}
+
+}  // namespace
+
+int rknn_init(
+  rknn_context * context, void * model, uint32_t size, uint32_t flag, rknn_init_extend * extend)
+{
+  // flags and the extend only tune the real runtime
+  (void)flag;
+  (void)extend;
+  if (context == nullptr || model == nullptr || size == 0) {
+    return RKNN_ERR_PARAM_INVALID;
+  }
+  if (!IsMapped(model, size)) {
+    LOG_ERROR("rknn stub: model buffer %p of %u bytes is not mapped\n", model, size);
+    return RKNN_ERR_MODEL_INVALID;
+  }
+  // the model file is not parsed, the heads come from the environment
+  std::shared_ptr<StubModel> stub_model = CreateModel();
+  if (stub_model == nullptr) {
+    return RKNN_ERR_FAIL;
+  }
+  // the runtime copies the model in, touch every page like that copy so the load cost of the
+  // mapping is paid here
+  volatile uint8_t sum = 0;
+  for (uint32_t i = 0; i < size; i += 4096) {
+    sum += static_cast<const uint8_t *>(model)[i];
+  }
+  *context = NewContext(stub_model);
+  return RKNN_SUCC;
+}
+
+int rknn_dup_context(rknn_context * context_in, rknn_context * context_out)
+{
+  if (context_in == nullptr || context_out == nullptr || *context_in == 0) {
+    return RKNN_ERR_PARAM_INVALID;
+  }
+  *context_out = NewContext(ToContext(*context_in)->model);
+  return RKNN_SUCC;
+}
+
+int rknn_destroy(rknn_context context)
+{
+  delete ToContext(context);
+  return RKNN_SUCC;
+}
+
+int rknn_query(rknn_context context, rknn_query_cmd cmd, void * info, uint32_t size)
+{
+  StubContext * ctx = ToContext(context);
+  // every query fills a fixed struct, a smaller size is a caller bug
+  if (ctx == nullptr || info == nullptr || size == 0) {
+    return RKNN_ERR_PARAM_INVALID;
+  }
+  const StubModel & model = *ctx->model;
+  switch (cmd) {
+    case RKNN_QUERY_SDK_VERSION: {
+      rknn_sdk_version * version = (rknn_sdk_version *)info;
+      snprintf(version->api_version, sizeof(version->api_version), "host stub");
+      snprintf(version->drv_version, sizeof(version->drv_version), "host stub");
+      return RKNN_SUCC;
+    }
+    case RKNN_QUERY_IN_OUT_NUM: {
+      rknn_input_output_num * io_num = (rknn_input_output_num *)info;
+      io_num->n_input = 1;
+      io_num->n_output = STUB_HEAD_NUM;
+      return RKNN_SUCC;
+    }
+    case RKNN_QUERY_INPUT_ATTR:
+    case RKNN_QUERY_NATIVE_INPUT_ATTR: {
+      rknn_tensor_attr * attr = (rknn_tensor_attr *)info;
+      if (attr->index != 0) {
+        return RKNN_ERR_PARAM_INVALID;
+      }
+      *attr = model.input_attr;
+      return RKNN_SUCC;
+    }
+    case RKNN_QUERY_OUTPUT_ATTR:
+    case RKNN_QUERY_NATIVE_OUTPUT_ATTR:
+    case RKNN_QUERY_NATIVE_NHWC_OUTPUT_ATTR: {
+      rknn_tensor_attr * attr = (rknn_tensor_attr *)info;
+      if (attr->index >= STUB_HEAD_NUM) {
+        return RKNN_ERR_PARAM_INVALID;
+      }
+      if (cmd == RKNN_QUERY_OUTPUT_ATTR) {
+        *attr = model.output_attrs[attr->index];
+      } else {
+        NativeOutputAttr(model.output_attrs[attr->index], cmd, attr);
+      }
+      return RKNN_SUCC;
+    }
+    default:
+      // custom string and the rest are not available
+      return RKNN_ERR_FAIL;
+  }
+}
+
+int rknn_set_core_mask(rknn_context context, rknn_core_mask core_mask)
+{
+  StubContext * ctx = ToContext(context);
+  if (ctx == nullptr) {
+    return RKNN_ERR_PARAM_INVALID;
+  }
+  // multi-core masks run on their lowest core
+  for (int core = 0; core < STUB_CORE_NUM; ++core) {
+    if (core_mask & (1 << core)) {
+      ctx->core = core;
+      break;
+    }
+  }
+  return RKNN_SUCC;
+}
+
+int rknn_inputs_set(rknn_context context, uint32_t n_inputs, rknn_input inputs[])
+{
+  // the outputs do not depend on the pixels, only the copy the runtime makes is simulated
+  StubContext * ctx = ToContext(context);
+  if (ctx == nullptr || n_inputs != 1 || inputs[0].buf == nullptr) {
+    return RKNN_ERR_PARAM_INVALID;
+  }
+  static thread_local std::vector<uint8_t> staging;
+  staging.resize(inputs[0].size);
+  memcpy(staging.data(), inputs[0].buf, inputs[0].size);
+  return RKNN_SUCC;
+}
+
+int rknn_run(rknn_context context, rknn_run_extend * extend)
+{
+  StubContext * ctx = ToContext(context);
+  if (ctx == nullptr) {
+    return RKNN_ERR_PARAM_INVALID;
+  }
+  const StubModel & model = *ctx->model;
+  int delay_us = model.latency_us[ctx->core];
+  if (model.jitter_us > 0) {
+    delay_us += std::uniform_int_distribution<int>(0, model.jitter_us)(ctx->rng);
+  }
+  {
+    // one inference per core at a time, the run starts when the core is done with the others
+    std::lock_guard<std::mutex> lock(g_core_mutex);
+    std::chrono::steady_clock::time_point start =
+      std::max(std::chrono::steady_clock::now(), g_core_free_at[ctx->core]);
+    ctx->finish_at = start + std::chrono::microseconds(delay_us);
+    g_core_free_at[ctx->core] = ctx->finish_at;
+  }
+  ctx->running = true;
+  if (extend != nullptr) {
+    extend->frame_id = ctx->runs;
+    if (extend->non_block) {
+      return RKNN_SUCC;
+    }
+  }
+  return rknn_wait(context, extend);
+}
+
+// a context tracks its last run only, so the frame_id of the extend is not needed
+int rknn_wait(rknn_context context, rknn_run_extend *)
+{
+  StubContext * ctx = ToContext(context);
+  if (ctx == nullptr) {
+    return RKNN_ERR_PARAM_INVALID;
+  }
+  if (!ctx->running) {
+    return RKNN_SUCC;
+  }
+  std::this_thread::sleep_until(ctx->finish_at);
+
+  const StubModel & model = *ctx->model;
+  const std::vector<std::vector<int8_t>> & frame =
+    model.frame_outputs[ctx->runs % model.frame_outputs.size()];
+  ctx->runs++;
+  ctx->running = false;
+  for (int i = 0; i < STUB_HEAD_NUM; ++i) {
+    if (ctx->output_mems[i] != nullptr) {
+      WriteOutput(frame[i], ctx->output_mem_attrs[i], (int8_t *)ctx->output_mems[i]->virt_addr);
+    } else {
+      ctx->outputs[i] = frame[i];
+    }
+  }
+  return RKNN_SUCC;
+}
+
+int rknn_outputs_get(
+  rknn_context context, uint32_t n_outputs, rknn_output outputs[], rknn_output_extend *)
+{
+  StubContext * ctx = ToContext(context);
+  if (ctx == nullptr || n_outputs > STUB_HEAD_NUM) {
+    return RKNN_ERR_PARAM_INVALID;
+  }
+  // blocks until the last run finished
+  rknn_wait(context, nullptr);
+  for (uint32_t i = 0; i < n_outputs; ++i) {
+    if (outputs[i].want_float) {
+      LOG_ERROR("rknn stub: float outputs are not supported\n");
+      return RKNN_ERR_PARAM_INVALID;
+    }
+    outputs[i].index = i;
+    if (outputs[i].is_prealloc) {
+      size_t size = std::min<size_t>(outputs[i].size, ctx->outputs[i].size());
+      memcpy(outputs[i].buf, ctx->outputs[i].data(), size);
+    } else {
+      outputs[i].buf = ctx->outputs[i].data();
+      outputs[i].size = ctx->outputs[i].size();
+    }
+  }
+  return RKNN_SUCC;
+}
+
+int rknn_outputs_release(rknn_context, uint32_t, rknn_output[])
+{
+  // the buffers belong to the context
+  return RKNN_SUCC;
+}
+
+rknn_tensor_mem * rknn_create_mem(rknn_context, uint32_t size)
+{
+  rknn_tensor_mem * mem = new rknn_tensor_mem();
+  memset(mem, 0, sizeof(*mem));
+  mem->virt_addr = calloc(size, 1);
+  mem->fd = -1;
+  mem->size = size;
+  return mem;
+}
+
+int rknn_destroy_mem(rknn_context ctx, rknn_tensor_mem * mem)
+{
+  if (mem == nullptr) {
+    return RKNN_ERR_PARAM_INVALID;
+  }
+  StubContext * context = ToContext(ctx);
+  if (context != nullptr) {
+    for (int i = 0; i < STUB_HEAD_NUM; ++i) {
+      if (context->output_mems[i] == mem) {
+        context->output_mems[i] = nullptr;
+      }
+    }
+    if (context->input_mem == mem) {
+      context->input_mem = nullptr;
+    }
+  }
+  free(mem->virt_addr);
+  delete mem;
+  return RKNN_SUCC;
+}
+
+int rknn_set_io_mem(rknn_context ctx, rknn_tensor_mem * mem, rknn_tensor_attr * attr)
+{
+  StubContext * context = ToContext(ctx);
+  if (context == nullptr || mem == nullptr || attr == nullptr) {
+    return RKNN_ERR_PARAM_INVALID;
+  }
+  // input and output indices overlap, the tensor is told apart by its type
+  if (attr->type == RKNN_TENSOR_UINT8) {
+    context->input_mem = mem;
+    return RKNN_SUCC;
+  }
+  if (attr->index >= STUB_HEAD_NUM || mem->size < attr->size_with_stride) {
+    return RKNN_ERR_PARAM_INVALID;
+  }
+  context->output_mems[attr->index] = mem;
+  context->output_mem_attrs[attr->index] = *attr;
+  return RKNN_SUCC;
+}
+
+int rknn_mem_sync(rknn_context, rknn_tensor_mem * mem, rknn_mem_sync_mode)
+{
+  // host memory is coherent
+  return mem != nullptr ? RKNN_SUCC : RKNN_ERR_PARAM_INVALID;
+}
@@ -1,22 +1,18 @@
 #include "rknn_model.hpp"
 
+#include <sys/time.h>
+
+#include <algorithm>
+
+#include "logger.hpp"
+#include "model_loader.hpp"
 #include "postprocess.hpp"
 #include "preprocess.hpp"
 
 namespace det_rk3588
 {
 
-int GetCoreNum()
-{
-  static int core_num = 0;
-  static std::mutex mtx;
-
-  std::lock_guard<std::mutex> lock(mtx);
-
-  int tmp = core_num & RK3588_CORE_NUM;
-  core_num++;
-  return tmp;
-}
+constexpr int RknnModel::kSlotNum;
 
 static void DumpTensorAttr(rknn_tensor_attr * attr)
 {
@@ -37,52 +33,21 @@ static void DumpTensorAttr(rknn_tensor_attr * attr)
 
 double GetUs(struct timeval t) { return (t.tv_sec * 1000000 + t.tv_usec); }
 
-static unsigned char * LoadData(FILE * fp, size_t ofst, size_t sz)
-{
-  unsigned char * data;
-  int ret;
-
-  data = NULL;
-
-  if (NULL == fp) {
-    return NULL;
-  }
-
-  ret = fseek(fp, ofst, SEEK_SET);
-  if (ret != 0) {
-    printf("blob seek failure.\n");
-    return NULL;
-  }
-
-  data = (unsigned char *)malloc(sz);
-  if (data == NULL) {
-    printf("buffer malloc failure.\n");
-    return NULL;
-  }
-  ret = fread(data, 1, sz, fp);
-  return data;
-}
-
-static unsigned char * LoadModel(const char * filename, int * model_size)
+void DrawDetectResults(cv::Mat & image, const DetectResultGroup & detect_result_group)
 {
-  FILE * fp;
-  unsigned char * data;
-
-  fp = fopen(filename, "rb");
-  if (NULL == fp) {
-    printf("Open file %s failed.\n", filename);
-    return NULL;
+  char text[256];
+  for (int i = 0; i < detect_result_group.count; i++) {
+    const DetectResult * det_result = &(detect_result_group.results[i]);
+    sprintf(text, "%s %.1f%%", det_result->name, det_result->prop * 100);
+    int x1 = det_result->box.left;
+    int y1 = det_result->box.top;
+    int x2 = det_result->box.right;
+    int y2 = det_result->box.bottom;
+    rectangle(image, cv::Point(x1, y1), cv::Point(x2, y2), cv::Scalar(256, 0, 0, 256), 3);
+    putText(
+      image, text, cv::Point(x1, y1 + 12), cv::FONT_HERSHEY_SIMPLEX, 0.4,
+      cv::Scalar(255, 255, 255));
   }
-
-  fseek(fp, 0, SEEK_END);
-  int size = ftell(fp);
-
-  data = LoadData(fp, 0, size);
-
-  fclose(fp);
-
-  *model_size = size;
-  return data;
 }
 
 static int SaveFloat(const char * filename, float * output, int element_size)
@@ -96,69 +61,88 @@ static int SaveFloat(const char * filename, float * output, int element_size)
   return 0;
 }
 
-RknnModel::RknnModel(const std::string & model_path)
+RknnModel::RknnModel(const std::string & model_path, const Options & options)
 {
   model_path_ = model_path;
-  nms_threshold_ = NMS_THRESH;
-  box_conf_threshold_ = BOX_THRESH;
+  options_ = options;
+  first_run_start_us_ = 0;
+  input_attrs_ = nullptr;
+  output_attrs_ = nullptr;
+  native_output_attrs_ = nullptr;
+  output_mem_attrs_ = nullptr;
+  core_mask_ = RKNN_NPU_CORE_UNDEFINED;
+  running_slot_ = -1;
+  npu_busy_ = false;
+  for (Slot & slot : slots_) {
+    slot.state = SlotState::kFree;
+    slot.status = 0;
+    slot.ctx = 0;
+    slot.input_mem = nullptr;
+    memset(slot.output_mems, 0, sizeof(slot.output_mems));
+    memset(slot.output_bufs, 0, sizeof(slot.output_bufs));
+    memset(&slot.run, 0, sizeof(slot.run));
+  }
 }
 
 int RknnModel::Init(rknn_context * ctx_in, bool share_weight)
 {
-  printf("Loading model...\n");
+  LOG_INFO("Loading model...\n");
+  timeval time;
+  gettimeofday(&time, nullptr);
+  double start_time = GetUs(time);
   // model weights reusable
   if (share_weight == true) {
     ret_ = rknn_dup_context(ctx_in, &ctx_);
   } else {
-    int model_data_size = 0;
-    model_data_ = LoadModel(model_path_.c_str(), &model_data_size);
-    ret_ = rknn_init(&ctx_, model_data_, model_data_size, 0, NULL);
+    ModelFile model_file;
+    if (model_file.Open(model_path_.c_str()) != 0) {
+      return -1;
+    }
+    gettimeofday(&time, nullptr);
+    timings_.load_us = GetUs(time) - start_time;
+    start_time = GetUs(time);
+    ret_ = rknn_init(&ctx_, model_file.GetData(), model_file.GetSize(), 0, NULL);
+    // the runtime has its own copy now, the mapping is closed here
   }
   if (ret_ < 0) {
-    printf("rknn init error. ret=%d\n", ret_);
+    LOG_ERROR("rknn init error. ret=%d\n", ret_);
     return -1;
   }
+  gettimeofday(&time, nullptr);
+  timings_.init_us = GetUs(time) - start_time;
+  LOG_INFO(
+    "model load %.2f ms, context %s %.2f ms\n", timings_.load_us / 1000.0,
+    share_weight ? "dup" : "init", timings_.init_us / 1000.0);
 
   // set npu core for this model
-  rknn_core_mask core_mask;
-  switch (GetCoreNum()) {
-    case 0:
-      core_mask = RKNN_NPU_CORE_0;
-      break;
-    case 1:
-      core_mask = RKNN_NPU_CORE_1;
-      break;
-    case 2:
-      core_mask = RKNN_NPU_CORE_2;
-      break;
-  }
-  ret_ = rknn_set_core_mask(ctx_, core_mask);
+  core_mask_ = NpuCoreScheduler::Instance().Acquire(options_.core_strategy);
+  ret_ = rknn_set_core_mask(ctx_, core_mask_);
   if (ret_ < 0) {
-    printf("rknn set core mask error. ret=%d\n", ret_);
+    LOG_ERROR("rknn set core mask error. ret=%d\n", ret_);
     return -1;
   }
 
   rknn_sdk_version version;
   ret_ = rknn_query(ctx_, RKNN_QUERY_SDK_VERSION, &version, sizeof(rknn_sdk_version));
   if (ret_ < 0) {
-    printf("rknn query sdk version error. ret=%d\n", ret_);
+    LOG_ERROR("rknn query sdk version error. ret=%d\n", ret_);
     return -1;
   }
-  printf("sdk version: %s driver version: %s\n", version.api_version, version.drv_version);
+  LOG_INFO("sdk version: %s driver version: %s\n", version.api_version, version.drv_version);
 
   ret_ = rknn_query(ctx_, RKNN_QUERY_IN_OUT_NUM, &io_num_, sizeof(io_num_));
   if (ret_ < 0) {
-    printf("rknn query in out num error. ret=%d\n", ret_);
+    LOG_ERROR("rknn query in out num error. ret=%d\n", ret_);
     return -1;
   }
-  printf("model input num: %d, output num: %d\n", io_num_.n_input, io_num_.n_output);
+  LOG_INFO("model input num: %d, output num: %d\n", io_num_.n_input, io_num_.n_output);
 
   input_attrs_ = (rknn_tensor_attr *)calloc(io_num_.n_input, sizeof(rknn_tensor_attr));
   for (int i = 0; i < io_num_.n_input; i++) {
     input_attrs_[i].index = i;
     ret_ = rknn_query(ctx_, RKNN_QUERY_INPUT_ATTR, &(input_attrs_[i]), sizeof(rknn_tensor_attr));
     if (ret_ < 0) {
-      printf("rknn query input attr error. ret=%d\n", ret_);
+      LOG_ERROR("rknn query input attr error. ret=%d\n", ret_);
       return -1;
     }
     DumpTensorAttr(&(input_attrs_[i]));
@@ -169,128 +153,608 @@ int RknnModel::Init(rknn_context * ctx_in, bool share_weight)
     output_attrs_[i].index = i;
     ret_ = rknn_query(ctx_, RKNN_QUERY_OUTPUT_ATTR, &(output_attrs_[i]), sizeof(rknn_tensor_attr));
     if (ret_ < 0) {
-      printf("rknn query output attr error. ret=%d\n", ret_);
+      LOG_ERROR("rknn query output attr error. ret=%d\n", ret_);
       return -1;
     }
     DumpTensorAttr(&(output_attrs_[i]));
   }
 
   if (input_attrs_[0].fmt == RKNN_TENSOR_NCHW) {
-    printf("model is NCHW input fmt\n");
+    LOG_INFO("model is NCHW input fmt\n");
     channel_ = input_attrs_[0].dims[1];
     height_ = input_attrs_[0].dims[2];
     width_ = input_attrs_[0].dims[3];
   } else {
-    printf("model is NHWC input fmt\n");
+    LOG_INFO("model is NHWC input fmt\n");
     height_ = input_attrs_[0].dims[1];
     width_ = input_attrs_[0].dims[2];
     channel_ = input_attrs_[0].dims[3];
   }
-  printf("model input height=%d, width=%d, channel=%d\n", height_, width_, channel_);
+  LOG_INFO("model input height=%d, width=%d, channel=%d\n", height_, width_, channel_);
+
+  // models without a custom string return an error here, the head layout then comes from the
+  // sidecar file or the output attrs
+  rknn_custom_string custom_string;
+  memset(&custom_string, 0, sizeof(custom_string));
+  if (rknn_query(ctx_, RKNN_QUERY_CUSTOM_STRING, &custom_string, sizeof(custom_string)) < 0) {
+    custom_string.string[0] = '\0';
+  }
+  HeadConfig head;
+  ret_ = LoadHeadConfig(
+    model_path_.c_str(), custom_string.string, height_, width_, output_attrs_, io_num_.n_output,
+    &head);
+  if (ret_ < 0) {
+    LOG_ERROR("load head config error. ret=%d\n", ret_);
+    return -1;
+  }
+
+  // the native outputs are decoded in place, the NCHW attrs above still describe the head layout
+  rknn_tensor_attr * decode_attrs = output_attrs_;
+  if (options_.output_layout != OutputLayout::kNchw) {
+    ret_ = InitNativeOutputs();
+    if (ret_ < 0) {
+      return -1;
+    }
+    decode_attrs = native_output_attrs_;
+  }
+  ret_ = InitSlots(decode_attrs);
+  if (ret_ < 0) {
+    return -1;
+  }
 
-  memset(inputs_, 0, sizeof(inputs_));
-  inputs_[0].index = 0;
-  inputs_[0].type = RKNN_TENSOR_UINT8;
-  inputs_[0].size = width_ * height_ * channel_;
-  inputs_[0].fmt = RKNN_TENSOR_NHWC;
-  inputs_[0].pass_through = 0;
+  post_processor_.SetDecodeThreads(options_.decode_threads);
+  ret_ = post_processor_.Init(height_, width_, head, decode_attrs, io_num_.n_output);
+  if (ret_ < 0) {
+    LOG_ERROR("postprocess init error. ret=%d\n", ret_);
+    return -1;
+  }
+  // without labels the detections are still reported, named "unknown"
+  post_processor_.LoadLabels(options_.labels_path.c_str());
 
   return 0;
 }
 
+int RknnModel::InitNativeOutputs()
+{
+  rknn_query_cmd cmd = options_.output_layout == OutputLayout::kNhwc
+                         ? RKNN_QUERY_NATIVE_NHWC_OUTPUT_ATTR
+                         : RKNN_QUERY_NATIVE_OUTPUT_ATTR;
+  native_output_attrs_ = (rknn_tensor_attr *)calloc(io_num_.n_output, sizeof(rknn_tensor_attr));
+  for (int i = 0; i < io_num_.n_output; i++) {
+    native_output_attrs_[i].index = i;
+    ret_ = rknn_query(ctx_, cmd, &(native_output_attrs_[i]), sizeof(rknn_tensor_attr));
+    if (ret_ < 0) {
+      LOG_ERROR("rknn query native output attr error. ret=%d\n", ret_);
+      return -1;
+    }
+    DumpTensorAttr(&(native_output_attrs_[i]));
+    if (native_output_attrs_[i].type != RKNN_TENSOR_INT8) {
+      LOG_ERROR("native output %d is not int8\n", i);
+      return -1;
+    }
+  }
+  return 0;
+}
+
+int RknnModel::InitSlots(rknn_tensor_attr * output_attrs)
+{
+  output_mem_attrs_ = output_attrs;
+  if (options_.io_mode == IoMode::kZeroCopy) {
+    memset(&input_mem_attr_, 0, sizeof(input_mem_attr_));
+    input_mem_attr_.index = 0;
+    ret_ = rknn_query(
+      ctx_, RKNN_QUERY_NATIVE_INPUT_ATTR, &input_mem_attr_, sizeof(input_mem_attr_));
+    if (ret_ < 0) {
+      LOG_ERROR("rknn query native input attr error. ret=%d\n", ret_);
+      return -1;
+    }
+    // packed uint8 RGB rows, the width may be padded to w_stride pixels
+    input_mem_attr_.type = RKNN_TENSOR_UINT8;
+    input_mem_attr_.fmt = RKNN_TENSOR_NHWC;
+  }
+
+  // every slot owns its buffers, so a frame can be written while the other one runs
+  for (Slot & slot : slots_) {
+    slot.ctx = ctx_;
+    if (OutputsBound() && &slot != &slots_[0]) {
+      // shares the weights of ctx_, only the runtime buffers of a context are added
+      ret_ = rknn_dup_context(&ctx_, &slot.ctx);
+      if (ret_ < 0) {
+        LOG_ERROR("rknn dup slot context error. ret=%d\n", ret_);
+        slot.ctx = 0;
+        return -1;
+      }
+      ret_ = rknn_set_core_mask(slot.ctx, core_mask_);
+      if (ret_ < 0) {
+        LOG_ERROR("rknn set slot core mask error. ret=%d\n", ret_);
+        return -1;
+      }
+    }
+    if (options_.io_mode == IoMode::kZeroCopy) {
+      // preprocessing writes every frame straight into the input tensor
+      ret_ = InitInputMem(slot);
+    } else {
+      // preprocessing writes every frame into this buffer, rknn_inputs_set() copies it
+      ret_ = slot.input.Init(cv::Size(width_, height_));
+    }
+    if (ret_ < 0) {
+      return -1;
+    }
+    if (OutputsBound()) {
+      ret_ = InitOutputMems(slot);
+      if (ret_ < 0 || BindSlot(slot) < 0) {
+        return -1;
+      }
+    } else {
+      for (int i = 0; i < io_num_.n_output; i++) {
+        slot.outputs[i].resize(output_attrs_[i].n_elems);
+        slot.output_bufs[i] = slot.outputs[i].data();
+      }
+    }
+  }
+  return 0;
+}
+
+int RknnModel::InitInputMem(Slot & slot)
+{
+  const rknn_tensor_attr & attr = input_mem_attr_;
+  size_t stride = (size_t)(attr.w_stride > 0 ? attr.w_stride : width_) * channel_;
+  uint32_t size = std::max((uint32_t)(stride * height_), attr.size_with_stride);
+  slot.input_mem = rknn_create_mem(slot.ctx, size);
+  if (slot.input_mem == nullptr) {
+    LOG_ERROR("rknn create input mem error.\n");
+    return -1;
+  }
+  return slot.input.Init(cv::Size(width_, height_), (uint8_t *)slot.input_mem->virt_addr, stride);
+}
+
+int RknnModel::InitOutputMems(Slot & slot)
+{
+  // the runtime writes the outputs straight into these buffers, postprocessing reads them in
+  // place
+  for (int i = 0; i < io_num_.n_output; i++) {
+    const rknn_tensor_attr & attr = output_mem_attrs_[i];
+    slot.output_mems[i] = rknn_create_mem(slot.ctx, std::max(attr.size, attr.size_with_stride));
+    if (slot.output_mems[i] == nullptr) {
+      LOG_ERROR("rknn create output mem error.\n");
+      return -1;
+    }
+    slot.output_bufs[i] = (int8_t *)slot.output_mems[i]->virt_addr;
+  }
+  return 0;
+}
+
+int RknnModel::BindSlot(Slot & slot)
+{
+  if (slot.input_mem) {
+    ret_ = rknn_set_io_mem(slot.ctx, slot.input_mem, &input_mem_attr_);
+    if (ret_ < 0) {
+      LOG_ERROR("rknn set input io mem error. ret=%d\n", ret_);
+      return -1;
+    }
+  }
+  for (int i = 0; i < io_num_.n_output; i++) {
+    ret_ = rknn_set_io_mem(slot.ctx, slot.output_mems[i], &(output_mem_attrs_[i]));
+    if (ret_ < 0) {
+      LOG_ERROR("rknn set output io mem error. ret=%d\n", ret_);
+      return -1;
+    }
+  }
+  return 0;
+}
+
+bool RknnModel::OutputsBound() const
+{
+  return options_.io_mode == IoMode::kZeroCopy || options_.output_layout != OutputLayout::kNchw;
+}
+
 rknn_context * RknnModel::GetPctx() { return &ctx_; }
 
-cv::Mat RknnModel::Infer(cv::Mat & original_img)
+template <typename ImageType>
+int RknnModel::SubmitImage(const ImageType & image)
 {
-  std::lock_guard<std::mutex> lock(mutex_);
-  cv::Mat img;
-  cv::cvtColor(original_img, img, cv::COLOR_BGR2RGB);
-  img_width_ = img.cols;
-  img_height_ = img.rows;
-
-  BoxRect pads;
-  memset(&pads, 0, sizeof(BoxRect));
-  cv::Size target_size(width_, height_);
-  cv::Mat resized_img(target_size.height, target_size.width, CV_8UC3);
-  // calculate scaling ratio
-  float scale_w = (float)target_size.width / img.cols;
-  float scale_h = (float)target_size.height / img.rows;
-
-  // image scaling
-  if (img_width_ != width_ || img_height_ != height_) {
-    float min_scale = std::min(scale_w, scale_h);
-    scale_w = min_scale;
-    scale_h = min_scale;
-    LetterBox(img, resized_img, pads, min_scale, target_size);
-    inputs_[0].buf = resized_img.data;
+  int slot_id = -1;
+  {
+    std::unique_lock<std::mutex> lock(slot_mutex_);
+    while (slot_id < 0) {
+      for (int i = 0; i < kSlotNum; ++i) {
+        if (slots_[i].state == SlotState::kFree) {
+          slot_id = i;
+          break;
+        }
+      }
+      if (slot_id < 0) {
+        slot_cv_.wait(lock);
+      }
+    }
+    slots_[slot_id].state = SlotState::kWriting;
+  }
+
+  // preprocessing runs outside the locks, next to the inference of the other slot
+  Slot & slot = slots_[slot_id];
+  if (slot.input.Write(image) < 0) {
+    std::lock_guard<std::mutex> lock(slot_mutex_);
+    slot.state = SlotState::kFree;
+    slot_cv_.notify_all();
+    return -1;
+  }
+
+  std::unique_lock<std::mutex> lock(slot_mutex_);
+  slot.state = SlotState::kQueued;
+  queued_.push_back(slot_id);
+  StartQueued(lock);
+  return slot_id;
+}
+
+template <typename ImageType>
+int RknnModel::WarmupImage(const ImageType & image)
+{
+  if (options_.warmup_runs <= 0) {
+    return 0;
+  }
+  timeval time;
+  gettimeofday(&time, nullptr);
+  double start_time = GetUs(time);
+
+  DetectResultGroup detect_result_group;
+  for (int run = 0; run < options_.warmup_runs;) {
+    // kSlotNum frames in flight at a time, so each slot is bound and run at least once
+    int slot_ids[kSlotNum];
+    int batch = std::min(kSlotNum, options_.warmup_runs - run);
+    int slot_num = 0;
+    int ret = 0;
+    for (; slot_num < batch; slot_num++) {
+      slot_ids[slot_num] = Submit(image);
+      if (slot_ids[slot_num] < 0) {
+        ret = -1;
+        break;
+      }
+    }
+    // the submitted slots are collected in any case so none of them stays in use
+    for (int i = 0; i < slot_num; i++) {
+      if (Collect(slot_ids[i], &detect_result_group) != 0) {
+        ret = -1;
+      }
+    }
+    if (ret != 0) {
+      LOG_ERROR("warm-up run error.\n");
+      return -1;
+    }
+    run += batch;
+  }
+
+  gettimeofday(&time, nullptr);
+  timings_.warmup_us = GetUs(time) - start_time;
+  return 0;
+}
+
+template <>
+int RknnModel::Warmup<cv::Mat>(const cv::Size & frame_size)
+{
+  cv::Size size = frame_size.area() > 0 ? frame_size : cv::Size(width_, height_);
+  return WarmupImage(cv::Mat(size.height, size.width, CV_8UC3, cv::Scalar(128, 128, 128)));
+}
+
+template <>
+int RknnModel::Warmup<FrameJob>(const cv::Size & frame_size)
+{
+  return Warmup<cv::Mat>(frame_size);
+}
+
+template <>
+int RknnModel::Warmup<TileJob>(const cv::Size & frame_size)
+{
+  return Warmup<cv::Mat>(frame_size);
+}
+
+template <>
+int RknnModel::Warmup<Nv12Frame>(const cv::Size & frame_size)
+{
+  cv::Size size = frame_size.area() > 0 ? frame_size : cv::Size(width_, height_);
+  if (size.width % 2 != 0 || size.height % 2 != 0) {
+    LOG_ERROR("nv12 warm-up frame size %dx%d is odd\n", size.width, size.height);
+    return -1;
+  }
+  cv::Mat nv12(size.height * 3 / 2, size.width, CV_8UC1, cv::Scalar(128));
+  return WarmupImage(WrapNv12(nv12));
+}
+
+int RknnModel::Submit(const cv::Mat & image)
+{
+  // color conversion and scaling in one pass into the slot input, the pads and the scale only
+  // change with the frame size
+  return SubmitImage(image);
+}
+
+int RknnModel::Submit(const Nv12Frame & frame)
+{
+  // downscale first, the colour conversion only runs on the model input pixels
+  return SubmitImage(frame);
+}
+
+void RknnModel::StartQueued(std::unique_lock<std::mutex> & lock)
+{
+  while (!npu_busy_ && running_slot_ < 0 && !queued_.empty()) {
+    int slot_id = queued_.front();
+    queued_.pop_front();
+    npu_busy_ = true;
+    lock.unlock();
+    int ret = StartRun(slots_[slot_id]);
+    lock.lock();
+    npu_busy_ = false;
+    if (ret < 0) {
+      slots_[slot_id].state = SlotState::kDone;
+      slots_[slot_id].status = -1;
+    } else {
+      slots_[slot_id].state = SlotState::kRunning;
+      running_slot_ = slot_id;
+    }
+    slot_cv_.notify_all();
+  }
+}
+
+int RknnModel::StartRun(Slot & slot)
+{
+  int ret = 0;
+  if (first_run_start_us_ == 0) {
+    timeval time;
+    gettimeofday(&time, nullptr);
+    first_run_start_us_ = GetUs(time);
+  }
+
+  if (slot.input_mem) {
+    // flush the preprocessed pixels from the cpu cache
+    rknn_mem_sync(slot.ctx, slot.input_mem, RKNN_MEMORY_SYNC_TO_DEVICE);
   } else {
-    inputs_[0].buf = img.data;
+    rknn_input inputs[1];
+    memset(inputs, 0, sizeof(inputs));
+    inputs[0].index = 0;
+    inputs[0].type = RKNN_TENSOR_UINT8;
+    inputs[0].size = width_ * height_ * channel_;
+    inputs[0].fmt = RKNN_TENSOR_NHWC;
+    inputs[0].pass_through = 0;
+    inputs[0].buf = slot.input.GetData();
+    ret = rknn_inputs_set(slot.ctx, io_num_.n_input, inputs);
+    if (ret < 0) {
+      LOG_ERROR("rknn inputs set error. ret=%d\n", ret);
+      return -1;
+    }
   }
 
-  rknn_inputs_set(ctx_, io_num_.n_input, inputs_);
+  // model inference, returns once the run is queued on the core
+  memset(&slot.run, 0, sizeof(slot.run));
+  slot.run.non_block = 1;
+  ret = rknn_run(slot.ctx, &slot.run);
+  if (ret < 0) {
+    LOG_ERROR("rknn run error. ret=%d\n", ret);
+    return -1;
+  }
+  return 0;
+}
 
+int RknnModel::FinishRun(Slot & slot)
+{
+  int ret = rknn_wait(slot.ctx, &slot.run);
+  if (ret < 0) {
+    LOG_ERROR("rknn wait error. ret=%d\n", ret);
+    return -1;
+  }
+  if (timings_.first_run_us == 0) {
+    // lazy allocations of the runtime make the first run the slowest
+    timeval time;
+    gettimeofday(&time, nullptr);
+    timings_.first_run_us = GetUs(time) - first_run_start_us_;
+    LOG_INFO("first inference %.2f ms\n", timings_.first_run_us / 1000.0);
+  }
+  if (OutputsBound()) {
+    for (int i = 0; i < io_num_.n_output; ++i) {
+      rknn_mem_sync(slot.ctx, slot.output_mems[i], RKNN_MEMORY_SYNC_FROM_DEVICE);
+    }
+    return 0;
+  }
+
+  // preallocated, the runtime copies into the slot and keeps no buffer of its own
   rknn_output outputs[io_num_.n_output];
   memset(outputs, 0, sizeof(outputs));
   for (int i = 0; i < io_num_.n_output; i++) {
     outputs[i].want_float = 0;
+    outputs[i].is_prealloc = 1;
+    outputs[i].index = i;
+    outputs[i].buf = slot.outputs[i].data();
+    outputs[i].size = slot.outputs[i].size();
+  }
+  ret = rknn_outputs_get(slot.ctx, io_num_.n_output, outputs, NULL);
+  if (ret < 0) {
+    LOG_ERROR("rknn outputs get error. ret=%d\n", ret);
+    return -1;
+  }
+  rknn_outputs_release(slot.ctx, io_num_.n_output, outputs);
+  return 0;
+}
+
+int RknnModel::Wait(int slot_id)
+{
+  if (slot_id < 0 || slot_id >= kSlotNum) {
+    return -1;
   }
+  std::unique_lock<std::mutex> lock(slot_mutex_);
+  while (slots_[slot_id].state != SlotState::kDone) {
+    if (npu_busy_ || running_slot_ < 0) {
+      slot_cv_.wait(lock);
+      continue;
+    }
+    // finish whatever is on the NPU, it may be the frame of another caller queued before ours
+    int running = running_slot_;
+    npu_busy_ = true;
+    lock.unlock();
+    int ret = FinishRun(slots_[running]);
+    lock.lock();
+    npu_busy_ = false;
+    running_slot_ = -1;
+    slots_[running].state = SlotState::kDone;
+    slots_[running].status = ret;
+    slot_cv_.notify_all();
+    StartQueued(lock);
+  }
+  return slots_[slot_id].status;
+}
 
-  // model inference
-  ret_ = rknn_run(ctx_, NULL);
-  ret_ = rknn_outputs_get(ctx_, io_num_.n_output, outputs, NULL);
+int RknnModel::Collect(int slot_id, DetectResultGroup * detect_result_group)
+{
+  if (slot_id < 0 || slot_id >= kSlotNum) {
+    return -1;
+  }
+  Slot & slot = slots_[slot_id];
+  detect_result_group->count = 0;
+  int ret = Wait(slot_id);
+  if (ret == 0) {
+    // postprocessing
+    const LetterBoxGeometry & geometry = slot.input.GetGeometry();
+    std::lock_guard<std::mutex> lock(mutex_);
+    ret = post_processor_.Run(
+      slot.output_bufs, geometry.pads, geometry.scale, geometry.scale, detect_result_group);
+  }
 
-  // postprocessing
-  DetectResultGroup detect_result_group;
-  std::vector<float> out_scales;
-  std::vector<int32_t> out_zps;
-  for (int i = 0; i < io_num_.n_output; ++i) {
-    out_scales.push_back(output_attrs_[i].scale);
-    out_zps.push_back(output_attrs_[i].zp);
+  std::lock_guard<std::mutex> lock(slot_mutex_);
+  slot.state = SlotState::kFree;
+  slot_cv_.notify_all();
+  return ret;
+}
+
+cv::Mat RknnModel::Infer(cv::Mat & original_img)
+{
+  int slot = Submit(original_img);
+  if (slot < 0) {
+    return original_img;
   }
-  PostProcess(
-    (int8_t *)outputs[0].buf, (int8_t *)outputs[1].buf, (int8_t *)outputs[2].buf, height_, width_,
-    box_conf_threshold_, nms_threshold_, pads, scale_w, scale_h, out_zps, out_scales,
-    &detect_result_group);
+  DetectResultGroup detect_result_group;
+  Collect(slot, &detect_result_group);
 
-  // draw box
-  char text[256];
   for (int i = 0; i < detect_result_group.count; i++) {
     DetectResult * det_result = &(detect_result_group.results[i]);
-    sprintf(text, "%s %.1f%%", det_result->name, det_result->prop * 100);
     // print information about the predicted object
-    printf(
+    LOG_DEBUG(
       "%s @ (%d %d %d %d) %f\n", det_result->name, det_result->box.left, det_result->box.top,
       det_result->box.right, det_result->box.bottom, det_result->prop);
-    int x1 = det_result->box.left;
-    int y1 = det_result->box.top;
-    int x2 = det_result->box.right;
-    int y2 = det_result->box.bottom;
-    rectangle(original_img, cv::Point(x1, y1), cv::Point(x2, y2), cv::Scalar(256, 0, 0, 256), 3);
-    putText(
-      original_img, text, cv::Point(x1, y1 + 12), cv::FONT_HERSHEY_SIMPLEX, 0.4,
-      cv::Scalar(255, 255, 255));
   }
-
-  ret_ = rknn_outputs_release(ctx_, io_num_.n_output, outputs);
+  // draw box
+  DrawDetectResults(original_img, detect_result_group);
 
   return original_img;
 }
 
+InferResult RknnModel::Infer(FrameJob & job)
+{
+  InferResult result;
+  result.frame_id = job.frame_id;
+  result.image = job.image;
+  result.group.count = 0;
+  timeval time;
+  gettimeofday(&time, nullptr);
+  result.start_us = GetUs(time);
+
+  int slot = Submit(job.image);
+  gettimeofday(&time, nullptr);
+  result.submitted_us = GetUs(time);
+  result.status = slot < 0 ? -1 : Collect(slot, &result.group);
+  gettimeofday(&time, nullptr);
+  result.done_us = GetUs(time);
+  return result;
+}
+
+DetectResultGroup RknnModel::Infer(Nv12Frame & frame)
+{
+  DetectResultGroup detect_result_group;
+  detect_result_group.count = 0;
+  int slot = Submit(frame);
+  if (slot >= 0) {
+    Collect(slot, &detect_result_group);
+  }
+  return detect_result_group;
+}
+
+TileResult RknnModel::Infer(TileJob & job)
+{
+  TileResult result;
+  result.frame_id = job.frame_id;
+  result.tile_id = job.tile_id;
+  result.rect = job.rect;
+  result.group.count = 0;
+  result.preprocess_us = 0.0;
+  result.detect_us = 0.0;
+
+  timeval time;
+  gettimeofday(&time, nullptr);
+  double start_time = GetUs(time);
+  // the tile is a view into the frame, the resizer reads its rows in place
+  int slot = Submit(job.image);
+  if (slot < 0) {
+    return result;
+  }
+  gettimeofday(&time, nullptr);
+  double submit_time = GetUs(time);
+  Collect(slot, &result.group);
+  gettimeofday(&time, nullptr);
+  result.preprocess_us = submit_time - start_time;
+  result.detect_us = GetUs(time) - submit_time;
+  return result;
+}
+
+void RknnModel::SetThresholds(float conf_threshold, float nms_threshold)
+{
+  // Collect() holds mutex_ while postprocessing, so a frame never sees half updated filters
+  std::lock_guard<std::mutex> lock(mutex_);
+  post_processor_.SetThresholds(conf_threshold, nms_threshold);
+}
+
+int RknnModel::SetClassThreshold(int class_id, float threshold)
+{
+  std::lock_guard<std::mutex> lock(mutex_);
+  return post_processor_.SetClassThreshold(class_id, threshold);
+}
+
+int RknnModel::SetClassEnabled(int class_id, bool enabled)
+{
+  std::lock_guard<std::mutex> lock(mutex_);
+  return post_processor_.SetClassEnabled(class_id, enabled);
+}
+
+int RknnModel::SetClassAllowList(const std::vector<int> & class_ids)
+{
+  std::lock_guard<std::mutex> lock(mutex_);
+  return post_processor_.SetClassAllowList(class_ids);
+}
+
 RknnModel::~RknnModel()
 {
-  DeinitPostProcess();
+  for (Slot & slot : slots_) {
+    for (int i = 0; i < PostProcessor::kMaxHeadNum; i++) {
+      if (slot.output_mems[i]) {
+        rknn_destroy_mem(slot.ctx, slot.output_mems[i]);
+      }
+    }
+    if (slot.input_mem) {
+      rknn_destroy_mem(slot.ctx, slot.input_mem);
+    }
+    if (slot.ctx != 0 && slot.ctx != ctx_) {
+      rknn_destroy(slot.ctx);
+    }
+  }
 
   ret_ = rknn_destroy(ctx_);
-
-  if (model_data_) {
-    free(model_data_);
+  if (core_mask_ != RKNN_NPU_CORE_UNDEFINED) {
+    NpuCoreScheduler::Instance().Release(core_mask_);
   }
+
   if (input_attrs_) {
     free(input_attrs_);
   }
   if (output_attrs_) {
     free(output_attrs_);
   }
+  if (native_output_attrs_) {
+    free(native_output_attrs_);
+  }
 }
 
 }  // namespace det_rk3588
@@ -0,0 +1,219 @@
+#include "tiling.hpp"
+
+#include <algorithm>
+
+#include "logger.hpp"
+
+namespace det_rk3588
+{
+
+// window starts along one axis, the last window ends on the border
+static void TileStarts(int length, int tile, int overlap, std::vector<int> * starts)
+{
+  starts->clear();
+  if (length <= tile) {
+    starts->push_back(0);
+    return;
+  }
+  int step = tile - overlap;
+  int num = (length - overlap + step - 1) / step;
+  for (int i = 0; i < num; ++i) {
+    starts->push_back(std::min(i * step, length - tile));
+  }
+}
+
+int MakeTiles(
+  const cv::Size & frame_size, const cv::Size & tile_size, int overlap,
+  std::vector<cv::Rect> * tiles)
+{
+  if (frame_size.width <= 0 || frame_size.height <= 0 || tile_size.width <= 0 ||
+      tile_size.height <= 0 || overlap < 0 || overlap >= tile_size.width ||
+      overlap >= tile_size.height) {
+    LOG_ERROR(
+      "invalid tiling of %dx%d into %dx%d tiles with overlap %d\n", frame_size.width,
+      frame_size.height, tile_size.width, tile_size.height, overlap);
+    return -1;
+  }
+  std::vector<int> xs;
+  std::vector<int> ys;
+  TileStarts(frame_size.width, tile_size.width, overlap, &xs);
+  TileStarts(frame_size.height, tile_size.height, overlap, &ys);
+  int tile_w = std::min(tile_size.width, frame_size.width);
+  int tile_h = std::min(tile_size.height, frame_size.height);
+
+  tiles->clear();
+  for (int y : ys) {
+    for (int x : xs) {
+      tiles->push_back(cv::Rect(x, y, tile_w, tile_h));
+    }
+  }
+  return 0;
+}
+
+// highest score first, ties keep the tile order
+struct MergeScoreGreater
+{
+  const std::vector<DetectResult> & detections;
+  bool operator()(int a, int b) const { return detections[a].prop > detections[b].prop; }
+};
+
+constexpr float TileMerger::kSeamContainment;
+constexpr float TileMerger::kSeamAgreement;
+constexpr int TileMerger::kSeamMargin;
+
+static int Overlap(int a0, int a1, int b0, int b1)
+{
+  return std::max(0, std::min(a1, b1) - std::max(a0, b0));
+}
+
+bool TileMerger::CutBySameObject(int a, int b) const
+{
+  const BoxRect & ba = detections_[a].box;
+  const BoxRect & bb = detections_[b].box;
+  if (
+    detections_[a].class_id != detections_[b].class_id || tile_ids_[a] == tile_ids_[b] ||
+    (seam_flags_[a] | seam_flags_[b]) == 0) {
+    return false;
+  }
+  int overlap_w = Overlap(ba.left, ba.right, bb.left, bb.right);
+  int overlap_h = Overlap(ba.top, ba.bottom, bb.top, bb.bottom);
+  int width_a = ba.right - ba.left;
+  int width_b = bb.right - bb.left;
+  int height_a = ba.bottom - ba.top;
+  int height_b = bb.bottom - bb.top;
+  float smaller_area = (float)std::min(width_a * height_a, width_b * height_b);
+  if (smaller_area > 0.f && overlap_w * overlap_h >= kSeamContainment * smaller_area) {
+    return true;
+  }
+  // a is the left / upper piece, b the right / lower one
+  for (int swap = 0; swap < 2; ++swap) {
+    int fa = swap ? seam_flags_[b] : seam_flags_[a];
+    int fb = swap ? seam_flags_[a] : seam_flags_[b];
+    const BoxRect & pa = swap ? bb : ba;
+    const BoxRect & pb = swap ? ba : bb;
+    if (
+      (fa & kSeamRight) && (fb & kSeamLeft) && pa.right >= pb.left && pa.left < pb.left &&
+      overlap_h >= kSeamAgreement * std::min(height_a, height_b)) {
+      return true;
+    }
+    if (
+      (fa & kSeamBottom) && (fb & kSeamTop) && pa.bottom >= pb.top && pa.top < pb.top &&
+      overlap_w >= kSeamAgreement * std::min(width_a, width_b)) {
+      return true;
+    }
+  }
+  return false;
+}
+
+// merges kept boxes in place, an object spanning several tiles is merged one seam at a time
+int TileMerger::MergeSeams(int keep_count)
+{
+  bool merged = true;
+  while (merged) {
+    merged = false;
+    for (int i = 0; i < keep_count && !merged; ++i) {
+      for (int j = i + 1; j < keep_count; ++j) {
+        int a = keep_[i];
+        int b = keep_[j];
+        if (!CutBySameObject(a, b)) {
+          continue;
+        }
+        // a scores higher, it keeps its name and takes the union box
+        BoxRect & box = detections_[a].box;
+        const BoxRect & other = detections_[b].box;
+        box.left = std::min(box.left, other.left);
+        box.top = std::min(box.top, other.top);
+        box.right = std::max(box.right, other.right);
+        box.bottom = std::max(box.bottom, other.bottom);
+        seam_flags_[a] |= seam_flags_[b];
+        keep_.erase(keep_.begin() + j);
+        --keep_count;
+        merged = true;
+        break;
+      }
+    }
+  }
+  return keep_count;
+}
+
+int TileMerger::Merge(
+  const TileResult * results, int result_num, const cv::Size & frame_size, float nms_threshold,
+  DetectResultGroup * merged)
+{
+  detections_.clear();
+  tile_ids_.clear();
+  seam_flags_.clear();
+  for (int i = 0; i < result_num; ++i) {
+    const TileResult & result = results[i];
+    const cv::Rect & rect = result.rect;
+    for (int k = 0; k < result.group.count; ++k) {
+      DetectResult detection = result.group.results[k];
+      BoxRect & box = detection.box;
+      // seams are the tile borders that are not frame borders
+      int flags = 0;
+      if (rect.x > 0 && box.left <= kSeamMargin) {
+        flags |= kSeamLeft;
+      }
+      if (rect.x + rect.width < frame_size.width && box.right >= rect.width - 1 - kSeamMargin) {
+        flags |= kSeamRight;
+      }
+      if (rect.y > 0 && box.top <= kSeamMargin) {
+        flags |= kSeamTop;
+      }
+      if (
+        rect.y + rect.height < frame_size.height && box.bottom >= rect.height - 1 - kSeamMargin) {
+        flags |= kSeamBottom;
+      }
+      box.left += rect.x;
+      box.right += rect.x;
+      box.top += rect.y;
+      box.bottom += rect.y;
+      detections_.push_back(detection);
+      tile_ids_.push_back(i);
+      seam_flags_.push_back(flags);
+    }
+  }
+
+  int count = detections_.size();
+  box_x1_.resize(count);
+  box_y1_.resize(count);
+  box_x2_.resize(count);
+  box_y2_.resize(count);
+  class_ids_.resize(count);
+  order_.resize(count);
+  for (int i = 0; i < count; ++i) {
+    const BoxRect & box = detections_[i].box;
+    box_x1_[i] = box.left;
+    box_y1_[i] = box.top;
+    box_x2_[i] = box.right;
+    box_y2_[i] = box.bottom;
+    class_ids_[i] = detections_[i].class_id;
+    order_[i] = i;
+  }
+  std::stable_sort(order_.begin(), order_.end(), MergeScoreGreater{detections_});
+
+  // no cap here, seams are merged over every box NMS keeps and the result is cut afterwards
+  classes_ = class_ids_;
+  std::sort(classes_.begin(), classes_.end());
+  classes_.erase(std::unique(classes_.begin(), classes_.end()), classes_.end());
+  for (int class_id : classes_) {
+    NmsPerClass(
+      count, box_x1_.data(), box_y1_.data(), box_x2_.data(), box_y2_.data(), class_ids_.data(),
+      order_.data(), class_id, nms_threshold);
+  }
+  keep_.clear();
+  for (int i = 0; i < count; ++i) {
+    if (order_[i] != -1) {
+      keep_.push_back(order_[i]);
+    }
+  }
+  int keep_count = std::min(MergeSeams((int)keep_.size()), OBJ_NUMB_MAX_SIZE);
+
+  merged->count = keep_count;
+  for (int i = 0; i < keep_count; ++i) {
+    merged->results[i] = detections_[keep_[i]];
+  }
+  return 0;
+}
+
+}  // namespace det_rk3588
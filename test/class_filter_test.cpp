@@ -0,0 +1,219 @@
+// The class filters of PostProcessor, changed between Run() calls on one instance: a disabled
+// class or one left out of an allow list drops exactly its own detections, and a class with a
+// threshold of its own is decoded as if that threshold were the global one, objectness included,
+// while the other classes keep theirs. Checked with the NCHW and the NC1HWC2 decoders. In the
+// random heads only the best class of a positive cell is above BOX_THRESH and NMS is per class,
+// so filtering one class leaves the detections of the others unchanged. A cell whose runner-up
+// class is above the threshold too checks that a filtered best class drops the cell instead of
+// handing it to the runner-up.
+#include <string.h>
+
+#include <algorithm>
+#include <vector>
+
+#include "postprocess.hpp"
+#include "synthetic_outputs.hpp"
+#include "test_utils.hpp"
+
+using namespace det_rk3588;
+
+static const int kInputSize = 320;
+static const int kClassNum = 80;
+
+static std::vector<DetectResult> Detect(
+  PostProcessor & post_processor, const SyntheticOutputs & outputs)
+{
+  DetectResultGroup group;
+  BoxRect pads = {0, 0, 0, 0};
+  CHECK_EQ(post_processor.Run(outputs.bufs, pads, 1.f, 1.f, &group), 0);
+  // the group is full only if detections were cut, which would hide filtered ones
+  CHECK(group.count < OBJ_NUMB_MAX_SIZE);
+  return std::vector<DetectResult>(group.results, group.results + group.count);
+}
+
+template <typename Predicate>
+static std::vector<DetectResult> Only(const std::vector<DetectResult> & results, Predicate keep)
+{
+  std::vector<DetectResult> kept;
+  for (const DetectResult & result : results) {
+    if (keep(result.class_id)) {
+      kept.push_back(result);
+    }
+  }
+  return kept;
+}
+
+static bool Same(const std::vector<DetectResult> & a, const std::vector<DetectResult> & b)
+{
+  if (a.size() != b.size()) {
+    return false;
+  }
+  for (size_t i = 0; i < a.size(); ++i) {
+    if (
+      a[i].class_id != b[i].class_id || memcmp(&a[i].box, &b[i].box, sizeof(BoxRect)) != 0 ||
+      a[i].prop != b[i].prop) {
+      return false;
+    }
+  }
+  return true;
+}
+
+// the detections of class_id from one run and of every other class from another, in score order
+static std::vector<DetectResult> Merge(
+  const std::vector<DetectResult> & with, const std::vector<DetectResult> & without, int class_id)
+{
+  std::vector<DetectResult> merged = Only(with, [class_id](int id) { return id == class_id; });
+  std::vector<DetectResult> others = Only(without, [class_id](int id) { return id != class_id; });
+  merged.insert(merged.end(), others.begin(), others.end());
+  std::stable_sort(
+    merged.begin(), merged.end(),
+    [](const DetectResult & a, const DetectResult & b) { return a.prop > b.prop; });
+  return merged;
+}
+
+// the class with the most detections
+static int MostFrequentClass(const std::vector<DetectResult> & results)
+{
+  std::vector<int> counts(kClassNum, 0);
+  for (const DetectResult & result : results) {
+    counts[result.class_id]++;
+  }
+  return (int)(std::max_element(counts.begin(), counts.end()) - counts.begin());
+}
+
+static void RunCase(
+  const SyntheticOutputs & nchw, const SyntheticOutputs & outputs, const char * name)
+{
+  HeadConfig head;
+  CHECK_EQ(
+    LoadHeadConfig(
+      "", "", kInputSize, kInputSize, nchw.attrs, SyntheticOutputs::kHeadNum, &head),
+    0);
+  PostProcessor post_processor;
+  CHECK_EQ(
+    post_processor.Init(kInputSize, kInputSize, head, outputs.attrs, SyntheticOutputs::kHeadNum),
+    0);
+
+  std::vector<DetectResult> baseline = Detect(post_processor, outputs);
+  int c = MostFrequentClass(baseline);
+  int c_count = (int)Only(baseline, [c](int id) { return id == c; }).size();
+  CHECK(c_count > 0 && c_count < (int)baseline.size());
+
+  // a disabled class is gone, the others are untouched
+  CHECK_EQ(post_processor.SetClassEnabled(c, false), 0);
+  CHECK(Same(Detect(post_processor, outputs), Only(baseline, [c](int id) { return id != c; })));
+  CHECK_EQ(post_processor.SetClassEnabled(c, true), 0);
+  CHECK(Same(Detect(post_processor, outputs), baseline));
+
+  // only the listed classes, an empty list brings back all of them
+  int other = baseline[0].class_id == c ? baseline.back().class_id : baseline[0].class_id;
+  CHECK_EQ(post_processor.SetClassAllowList({c, other}), 0);
+  std::vector<DetectResult> allowed = Detect(post_processor, outputs);
+  CHECK(Same(allowed, Only(baseline, [c, other](int id) { return id == c || id == other; })));
+  CHECK(allowed.size() < baseline.size());
+  CHECK_EQ(post_processor.SetClassAllowList({}), 0);
+  CHECK(Same(Detect(post_processor, outputs), baseline));
+
+  // every class disabled, nothing is decoded
+  for (int k = 0; k < kClassNum; ++k) {
+    CHECK_EQ(post_processor.SetClassEnabled(k, false), 0);
+  }
+  CHECK(Detect(post_processor, outputs).empty());
+  CHECK_EQ(post_processor.SetClassAllowList({}), 0);
+
+  // a global threshold of 0.7
+  const float high = 0.7f;
+  post_processor.SetThresholds(high, NMS_THRESH);
+  std::vector<DetectResult> strict = Detect(post_processor, outputs);
+  CHECK(!strict.empty() && strict.size() < baseline.size());
+
+  // a class threshold above the global one, only that class loses detections
+  post_processor.SetThresholds(BOX_THRESH, NMS_THRESH);
+  CHECK_EQ(post_processor.SetClassThreshold(c, high), 0);
+  CHECK(Same(Detect(post_processor, outputs), Merge(strict, baseline, c)));
+
+  // below it, the class keeps what the global one would drop and the objectness of the others is
+  // still held to the global threshold
+  post_processor.SetThresholds(high, NMS_THRESH);
+  CHECK_EQ(post_processor.SetClassThreshold(c, BOX_THRESH), 0);
+  std::vector<DetectResult> lowered = Detect(post_processor, outputs);
+  CHECK(Same(lowered, Merge(baseline, strict, c)));
+
+  // a negative threshold falls back to the global one
+  post_processor.SetThresholds(BOX_THRESH, NMS_THRESH);
+  CHECK_EQ(post_processor.SetClassThreshold(c, -1.f), 0);
+  CHECK(Same(Detect(post_processor, outputs), baseline));
+
+  // unknown classes are rejected and a rejected list changes nothing
+  CHECK_EQ(post_processor.SetClassThreshold(-1, high), -1);
+  CHECK_EQ(post_processor.SetClassThreshold(kClassNum, high), -1);
+  CHECK_EQ(post_processor.SetClassEnabled(kClassNum, false), -1);
+  CHECK_EQ(post_processor.SetClassAllowList({c, kClassNum}), -1);
+  CHECK(Same(Detect(post_processor, outputs), baseline));
+
+  printf(
+    "%s: %d detections, %d of class %d, %d above %.1f, %d with class %d at %.2f\n", name,
+    (int)baseline.size(), c_count, c, (int)strict.size(), high, (int)lowered.size(), c,
+    BOX_THRESH);
+}
+
+// one cell with a best and a runner-up class both above BOX_THRESH, the rest is background
+static void CheckRunnerUp()
+{
+  const int best = 7;
+  const int runner_up = 3;
+  SyntheticOutputs nchw;
+  MakeSyntheticOutputs(kInputSize, 0.f, kClassNum, 9, &nchw);
+  int grid = kInputSize / 8;
+  int grid_len = grid * grid;
+  int cell = 10 * grid + 12;
+  int8_t * anchor = nchw.bufs[0];
+  anchor[4 * grid_len + cell] = QuantizeSynthetic(0.9f);
+  anchor[(5 + best) * grid_len + cell] = QuantizeSynthetic(0.8f);
+  anchor[(5 + runner_up) * grid_len + cell] = QuantizeSynthetic(0.6f);
+  SyntheticOutputs nc1hwc2;
+  ToNc1hwc2(nchw, 16, &nc1hwc2);
+
+  const SyntheticOutputs * layouts[] = {&nchw, &nc1hwc2};
+  for (const SyntheticOutputs * outputs : layouts) {
+    HeadConfig head;
+    CHECK_EQ(
+      LoadHeadConfig(
+        "", "", kInputSize, kInputSize, nchw.attrs, SyntheticOutputs::kHeadNum, &head),
+      0);
+    PostProcessor post_processor;
+    CHECK_EQ(
+      post_processor.Init(
+        kInputSize, kInputSize, head, outputs->attrs, SyntheticOutputs::kHeadNum),
+      0);
+    std::vector<DetectResult> results = Detect(post_processor, *outputs);
+    CHECK_EQ(results.size(), 1);
+    CHECK(!results.empty() && results[0].class_id == best);
+
+    // the cell goes away with its best class, it is not relabelled to the runner-up
+    CHECK_EQ(post_processor.SetClassEnabled(best, false), 0);
+    CHECK(Detect(post_processor, *outputs).empty());
+    CHECK_EQ(post_processor.SetClassEnabled(best, true), 0);
+    CHECK_EQ(post_processor.SetClassAllowList({runner_up}), 0);
+    CHECK(Detect(post_processor, *outputs).empty());
+    CHECK_EQ(post_processor.SetClassAllowList({}), 0);
+    CHECK_EQ(post_processor.SetClassThreshold(best, 0.85f), 0);
+    CHECK(Detect(post_processor, *outputs).empty());
+    // the runner-up threshold does not matter either way
+    CHECK_EQ(post_processor.SetClassThreshold(best, -1.f), 0);
+    CHECK_EQ(post_processor.SetClassThreshold(runner_up, 0.95f), 0);
+    CHECK_EQ(Detect(post_processor, *outputs).size(), 1);
+  }
+}
+
+int main()
+{
+  SyntheticOutputs nchw;
+  MakeSyntheticOutputs(kInputSize, 0.006f, kClassNum, 8, &nchw);
+  RunCase(nchw, nchw, "nchw");
+  SyntheticOutputs nc1hwc2;
+  ToNc1hwc2(nchw, 16, &nc1hwc2);
+  RunCase(nchw, nc1hwc2, "nc1hwc2");
+  CheckRunnerUp();
+  return TestResult();
+}
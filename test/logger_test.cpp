@@ -0,0 +1,218 @@
+// The Logger formats on its drain thread what the LOG_* call sites captured: the output must match
+// snprintf for every conversion the library uses, strings must survive their buffers, warnings
+// and errors go to the error stream, filtered levels never reach a stream, under load every
+// message is either written, in order per thread, or counted as dropped, and a message after an
+// idle period wakes the drain thread instead of waiting for its timed fallback.
+#include <stdio.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "logger.hpp"
+#include "test_utils.hpp"
+
+using namespace det_rk3588;
+
+enum TestColor
+{
+  kRed,
+  kGreen = 3,
+};
+
+static FILE * g_out = nullptr;
+static FILE * g_err = nullptr;
+
+// everything written to stream since the last call, the stream is emptied
+static std::string Take(FILE * stream)
+{
+  Logger::Instance().Flush();
+  fflush(stream);
+  std::string text;
+  rewind(stream);
+  char buffer[4096];
+  size_t size;
+  while ((size = fread(buffer, 1, sizeof(buffer), stream)) > 0) {
+    text.append(buffer, size);
+  }
+  rewind(stream);
+  CHECK_EQ(ftruncate(fileno(stream), 0), 0);
+  return text;
+}
+
+// the logged line against snprintf with the same arguments
+#define CHECK_FORMAT(...)                                                        \
+  do {                                                                           \
+    char expected[Logger::kMessageSize];                                         \
+    snprintf(expected, sizeof(expected), __VA_ARGS__);                           \
+    LOG_INFO(__VA_ARGS__);                                                       \
+    std::string actual = Take(g_out);                                            \
+    if (actual != expected) {                                                    \
+      printf("expected \"%s\", logged \"%s\"\n", expected, actual.c_str()); \
+    }                                                                            \
+    CHECK(actual == expected);                                                   \
+  } while (0)
+
+static void CheckFormatting()
+{
+  int value = -42;
+  size_t size = 123456;
+  unsigned char byte = 200;
+  const char * name = "dog";
+  CHECK_FORMAT("plain text\n");
+  CHECK_FORMAT("%d %5d %-5d| %+d %05d %i\n", value, 7, 7, 7, 7, -1);
+  CHECK_FORMAT("%u %x %X %08x %#x %o\n", 4000000000u, 255u, 255u, 0xbeefu, 16u, 8u);
+  CHECK_FORMAT("%ld %lld %llu %zu %lu\n", -5L, -6LL, 18446744073709551615ULL, size, 9UL);
+  CHECK_FORMAT("%hhd %hhu %hd %hu\n", 300, 300, 70000, 70000);
+  CHECK_FORMAT("%d %c %u\n", byte, 'A', (unsigned)byte);
+  CHECK_FORMAT("%f %.2f %8.3f %-8.1f| %e %g %.0f\n", 3.14159, 2.5f, -1.0, 0.25, 1e-7, 1e20, 0.5);
+  CHECK_FORMAT("%s %10s %-10s| %.2s\n", name, name, name, name);
+  CHECK_FORMAT("%p %p\n", (void *)name, (void *)nullptr);
+  CHECK_FORMAT("100%% of %d%%\n", 5);
+  CHECK_FORMAT("bool %d, enum %d\n", true, kGreen);
+
+  // a null string prints like glibc does
+  LOG_INFO("%s\n", (const char *)nullptr);
+  CHECK(Take(g_out) == "(null)\n");
+
+  // long lines are cut and still end
+  std::string long_text(600, 'x');
+  LOG_INFO("%s and more\n", long_text.c_str());
+  std::string line = Take(g_out);
+  CHECK_EQ(line.size(), Logger::kMessageSize - 1);
+  CHECK(line.back() == '\n');
+  LOG_INFO("%s%s%d\n", long_text.c_str(), long_text.c_str(), 5);
+  line = Take(g_out);
+  CHECK_EQ(line.size(), Logger::kMessageSize - 1);
+  CHECK(line.back() == '\n');
+}
+
+static void CheckDanglingStrings()
+{
+  // the drain thread formats later, the buffers are rewritten and freed before that
+  char buffer[32];
+  snprintf(buffer, sizeof(buffer), "first");
+  {
+    std::string temporary = "temporary " + std::to_string(7);
+    LOG_INFO("%s %s\n", buffer, temporary.c_str());
+  }
+  snprintf(buffer, sizeof(buffer), "overwritten");
+  CHECK(Take(g_out) == "first temporary 7\n");
+}
+
+static void CheckLevels()
+{
+  LOG_DEBUG("debug\n");
+  LOG_INFO("info\n");
+  LOG_WARN("warn %d\n", 1);
+  LOG_ERROR("error %d\n", 2);
+  CHECK(Take(g_out) == "info\n");
+  CHECK(Take(g_err) == "warn 1\nerror 2\n");
+
+  Logger::Instance().SetLevel(LogLevel::kDebug);
+  LOG_DEBUG("debug\n");
+  CHECK(Take(g_out) == "debug\n");
+  Logger::Instance().SetLevel(LogLevel::kError);
+  LOG_INFO("info\n");
+  LOG_WARN("warn\n");
+  LOG_ERROR("error\n");
+  CHECK(Take(g_out) == "");
+  CHECK(Take(g_err) == "error\n");
+  Logger::Instance().SetLevel(LogLevel::kInfo);
+}
+
+// thread_num threads log per_thread numbered lines each without waiting
+static void CheckLoad(int thread_num, int per_thread)
+{
+  uint64_t dropped_before = Logger::Instance().GetDroppedCount();
+  std::vector<std::thread> threads;
+  for (int t = 0; t < thread_num; ++t) {
+    threads.emplace_back([t, per_thread]() {
+      for (int i = 0; i < per_thread; ++i) {
+        LOG_INFO("thread %d line %d\n", t, i);
+      }
+    });
+  }
+  for (std::thread & thread : threads) {
+    thread.join();
+  }
+  std::string text = Take(g_out);
+  std::string reports = Take(g_err);
+  uint64_t dropped = Logger::Instance().GetDroppedCount() - dropped_before;
+
+  std::vector<int> last(thread_num, -1);
+  int logged = 0;
+  bool ordered = true;
+  size_t start = 0;
+  while (start < text.size()) {
+    size_t end = text.find('\n', start);
+    int t = -1;
+    int i = -1;
+    if (sscanf(text.c_str() + start, "thread %d line %d", &t, &i) != 2 || t < 0 ||
+        t >= thread_num) {
+      ordered = false;
+      break;
+    }
+    ordered = ordered && i > last[t];
+    last[t] = i;
+    logged++;
+    start = end + 1;
+  }
+  printf(
+    "%d threads x %d lines: %d logged, %llu dropped\n", thread_num, per_thread, logged,
+    (unsigned long long)dropped);
+  CHECK(ordered);
+  CHECK_EQ(logged + dropped, thread_num * per_thread);
+  CHECK(dropped == 0 || reports.find("messages dropped") != std::string::npos);
+}
+
+// the drain thread writes on its own, the stream is only watched until the line shows up
+static void CheckWakeup()
+{
+  Take(g_out);
+  std::vector<double> latencies;
+  for (int i = 0; i < 5; ++i) {
+    // long enough for the drain thread to wait, far from its 100 ms fallback
+    std::this_thread::sleep_for(std::chrono::milliseconds(30));
+    auto start = std::chrono::steady_clock::now();
+    LOG_INFO("wake %d\n", i);
+    double latency_ms = 0.0;
+    struct stat st;
+    do {
+      std::this_thread::sleep_for(std::chrono::microseconds(100));
+      latency_ms =
+        std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    } while (fstat(fileno(g_out), &st) == 0 && st.st_size == 0 && latency_ms < 1000.0);
+    latencies.push_back(latency_ms);
+    CHECK(Take(g_out) == "wake " + std::to_string(i) + "\n");
+  }
+  std::sort(latencies.begin(), latencies.end());
+  printf("wakeup after idle: median %.2f ms, max %.2f ms\n", latencies[2], latencies.back());
+  CHECK(latencies[2] < 30.0);
+}
+
+int main()
+{
+  g_out = tmpfile();
+  g_err = tmpfile();
+  CHECK(g_out != nullptr && g_err != nullptr);
+  Logger::Instance().SetStreams(g_out, g_err);
+
+  CheckFormatting();
+  CheckDanglingStrings();
+  CheckLevels();
+  CheckWakeup();
+  // one thread with room to spare, then more than the ring holds
+  CheckLoad(1, Logger::kSlotNum / 2);
+  CheckLoad(6, 20000);
+
+  Logger::Instance().SetStreams(stdout, stderr);
+  fclose(g_out);
+  fclose(g_err);
+  return TestResult();
+}
@@ -0,0 +1,104 @@
+// ModelFile maps the file contents, fails with -1 on files it cannot map and unmaps on Close(),
+// on a failed Open() and on destruction.
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include <string>
+#include <vector>
+
+#include "model_loader.hpp"
+#include "test_utils.hpp"
+
+using namespace det_rk3588;
+
+static std::string WriteTempFile(const std::vector<uint8_t> & contents)
+{
+  char path[] = "/tmp/model_loader_test_XXXXXX";
+  int fd = mkstemp(path);
+  CHECK(fd >= 0);
+  if (!contents.empty()) {
+    CHECK_EQ(write(fd, contents.data(), contents.size()), (long long)contents.size());
+  }
+  close(fd);
+  return path;
+}
+
+// whether the first page of addr is still mapped
+static bool IsMapped(void * addr)
+{
+  long page = sysconf(_SC_PAGESIZE);
+  unsigned char resident = 0;
+  void * start = (void *)((uintptr_t)addr & ~(uintptr_t)(page - 1));
+  return mincore(start, page, &resident) == 0;
+}
+
+static void CheckContents()
+{
+  // not a multiple of the page size, so the tail of the last page is checked too
+  std::vector<uint8_t> contents(3 * 4096 + 123);
+  for (size_t i = 0; i < contents.size(); ++i) {
+    contents[i] = (uint8_t)(i * 31 + 7);
+  }
+  std::string path = WriteTempFile(contents);
+
+  ModelFile model_file;
+  CHECK_EQ(model_file.Open(path.c_str()), 0);
+  CHECK(model_file.GetData() != nullptr);
+  CHECK_EQ(model_file.GetSize(), contents.size());
+  // the mapping keeps the file alive after it is unlinked
+  unlink(path.c_str());
+  CHECK_EQ(memcmp(model_file.GetData(), contents.data(), contents.size()), 0);
+
+  void * data = model_file.GetData();
+  CHECK(IsMapped(data));
+  model_file.Close();
+  CHECK(model_file.GetData() == nullptr);
+  CHECK_EQ(model_file.GetSize(), 0);
+  CHECK(!IsMapped(data));
+  // closing twice is harmless
+  model_file.Close();
+}
+
+static void CheckErrors()
+{
+  std::vector<uint8_t> contents(1000, 5);
+  std::string path = WriteTempFile(contents);
+  std::string empty_path = WriteTempFile(std::vector<uint8_t>());
+
+  ModelFile model_file;
+  CHECK_EQ(model_file.Open(path.c_str()), 0);
+  void * data = model_file.GetData();
+
+  // a failed Open() drops the previous mapping instead of leaving it behind
+  CHECK_EQ(model_file.Open("/nonexistent/model.rknn"), -1);
+  CHECK(model_file.GetData() == nullptr);
+  CHECK_EQ(model_file.GetSize(), 0);
+  CHECK(!IsMapped(data));
+
+  CHECK_EQ(model_file.Open(empty_path.c_str()), -1);
+  CHECK(model_file.GetData() == nullptr);
+  // a directory opens but cannot be mapped
+  CHECK_EQ(model_file.Open("/tmp"), -1);
+  CHECK(model_file.GetData() == nullptr);
+
+  // the destructor unmaps
+  {
+    ModelFile scoped;
+    CHECK_EQ(scoped.Open(path.c_str()), 0);
+    data = scoped.GetData();
+  }
+  CHECK(!IsMapped(data));
+
+  unlink(path.c_str());
+  unlink(empty_path.c_str());
+}
+
+int main()
+{
+  CheckContents();
+  CheckErrors();
+  return TestResult();
+}
@@ -0,0 +1,228 @@
+// NmsEngine against the per-class NmsPerClass() loop: the keep sets must be identical, in order,
+// on clustered scenes of 3 and 80 classes, with boxes outside the coordinate space, with more
+// kept boxes in one grid cell than one IoU block holds, with IoUs exactly at the threshold and
+// with max_keep cutting the set. Built once with the SIMD kernel of the target and once with
+// DET_RK3588_DISABLE_SIMD for the scalar one.
+#include <stdio.h>
+
+#include <algorithm>
+#include <random>
+#include <set>
+#include <vector>
+
+#include "nms.hpp"
+#include "test_utils.hpp"
+
+using namespace det_rk3588;
+
+static const int kSceneSize = 640;
+
+struct Scene
+{
+  std::vector<float> box_x1;
+  std::vector<float> box_y1;
+  std::vector<float> box_x2;
+  std::vector<float> box_y2;
+  std::vector<int> class_ids;
+  std::vector<int> order;
+
+  void Add(float x1, float y1, float x2, float y2, int class_id)
+  {
+    order.push_back((int)box_x1.size());
+    box_x1.push_back(x1);
+    box_y1.push_back(y1);
+    box_x2.push_back(x2);
+    box_y2.push_back(y2);
+    class_ids.push_back(class_id);
+  }
+};
+
+// candidates cluster around objects, some reach past the scene, the order stands in for scores
+static Scene MakeScene(int candidate_num, int class_num, unsigned seed)
+{
+  std::mt19937 rng(seed);
+  std::uniform_real_distribution<float> pos(-40.f, kSceneSize + 40.f);
+  std::uniform_real_distribution<float> size(4.f, 200.f);
+  std::normal_distribution<float> jitter(0.f, 0.15f);
+  std::uniform_int_distribution<int> cls(0, class_num - 1);
+  std::uniform_real_distribution<float> unit(0.f, 1.f);
+
+  int object_num = std::max(1, candidate_num / 8);
+  std::vector<float> objects(object_num * 4);
+  std::vector<int> object_classes(object_num);
+  for (int i = 0; i < object_num; ++i) {
+    objects[i * 4 + 2] = size(rng);
+    objects[i * 4 + 3] = size(rng);
+    objects[i * 4 + 0] = pos(rng) - objects[i * 4 + 2] / 2;
+    objects[i * 4 + 1] = pos(rng) - objects[i * 4 + 3] / 2;
+    object_classes[i] = cls(rng);
+  }
+  Scene scene;
+  std::uniform_int_distribution<int> pick(0, object_num - 1);
+  for (int i = 0; i < candidate_num; ++i) {
+    int o = pick(rng);
+    float w = objects[o * 4 + 2] * (1.f + jitter(rng));
+    float h = objects[o * 4 + 3] * (1.f + jitter(rng));
+    float x = objects[o * 4 + 0] + objects[o * 4 + 2] * jitter(rng);
+    float y = objects[o * 4 + 1] + objects[o * 4 + 3] * jitter(rng);
+    scene.Add(x, y, x + w, y + h, unit(rng) < 0.1f ? cls(rng) : object_classes[o]);
+  }
+  std::shuffle(scene.order.begin(), scene.order.end(), rng);
+  return scene;
+}
+
+static std::vector<int> RunPerClass(const Scene & scene, float threshold, int max_keep)
+{
+  std::vector<int> order = scene.order;
+  int count = (int)order.size();
+  std::set<int> class_set(scene.class_ids.begin(), scene.class_ids.end());
+  for (int c : class_set) {
+    NmsPerClass(
+      count, scene.box_x1.data(), scene.box_y1.data(), scene.box_x2.data(), scene.box_y2.data(),
+      scene.class_ids.data(), order.data(), c, threshold);
+  }
+  std::vector<int> keep;
+  for (int i = 0; i < count && (int)keep.size() < max_keep; ++i) {
+    if (order[i] != -1) {
+      keep.push_back(order[i]);
+    }
+  }
+  return keep;
+}
+
+static std::vector<int> RunEngine(
+  const Scene & scene, int class_num, int cell_size, float threshold, int max_keep)
+{
+  NmsEngine engine;
+  engine.Init(kSceneSize, kSceneSize, class_num, cell_size);
+  int keep[NmsEngine::kMaxKeep];
+  int keep_count = engine.Run(
+    scene.box_x1.data(), scene.box_y1.data(), scene.box_x2.data(), scene.box_y2.data(),
+    scene.class_ids.data(), scene.order.data(), (int)scene.order.size(), threshold, max_keep,
+    keep);
+  return std::vector<int>(keep, keep + keep_count);
+}
+
+// the engine against the reference, returns the keep count
+static int CheckScene(
+  const Scene & scene, int class_num, int cell_size, float threshold, int max_keep)
+{
+  std::vector<int> expected =
+    RunPerClass(scene, threshold, std::min(max_keep, (int)NmsEngine::kMaxKeep));
+  std::vector<int> actual = RunEngine(scene, class_num, cell_size, threshold, max_keep);
+  if (actual != expected) {
+    printf(
+      "%d candidates, %d classes, cell %d, threshold %.2f, max keep %d: kept %d, expected %d\n",
+      (int)scene.order.size(), class_num, cell_size, threshold, max_keep, (int)actual.size(),
+      (int)expected.size());
+  }
+  CHECK(actual == expected);
+  return (int)actual.size();
+}
+
+static void CheckRandomScenes()
+{
+  const int candidate_nums[] = {16, 256, 1024, 4096};
+  const int class_nums[] = {1, 3, 80};
+  const int cell_sizes[] = {16, NmsEngine::kDefaultCellSize, kSceneSize};
+  const float thresholds[] = {0.25f, 0.45f, 0.7f};
+  int scenes = 0;
+  int kept = 0;
+  for (int candidate_num : candidate_nums) {
+    for (int class_num : class_nums) {
+      for (int seed = 0; seed < 4; ++seed) {
+        Scene scene = MakeScene(candidate_num, class_num, candidate_num * 131 + class_num + seed);
+        for (int cell_size : cell_sizes) {
+          for (float threshold : thresholds) {
+            kept += CheckScene(scene, class_num, cell_size, threshold, NmsEngine::kMaxKeep);
+            scenes++;
+          }
+        }
+        // max_keep cuts the set, above kMaxKeep it is clamped
+        CheckScene(scene, class_num, NmsEngine::kDefaultCellSize, 0.45f, 5);
+        CheckScene(scene, class_num, NmsEngine::kDefaultCellSize, 0.45f, 1000);
+      }
+    }
+  }
+  printf("%d random scenes, %d boxes kept\n", scenes, kept);
+}
+
+static void CheckCrowdedCell()
+{
+  // 63 disjoint 6x6 boxes in one 64x64 cell fill every IoU block, then a box over each of them
+  // and one on the free place
+  Scene scene;
+  for (int i = 0; i < 63; ++i) {
+    float x = (i % 8) * 8.f;
+    float y = (i / 8) * 8.f;
+    scene.Add(x, y, x + 5.f, y + 5.f, 0);
+  }
+  for (int i = 0; i < 64; ++i) {
+    float x = (i % 8) * 8.f;
+    float y = (i / 8) * 8.f;
+    scene.Add(x + 0.5f, y + 0.5f, x + 5.5f, y + 5.5f, 0);
+  }
+  CHECK_EQ(CheckScene(scene, 1, NmsEngine::kDefaultCellSize, 0.45f, 64), 64);
+
+  // 60 kept boxes, then boxes that only overlap the last kept one of each block
+  Scene blocks;
+  for (int i = 0; i < 60; ++i) {
+    float x = (i % 8) * 8.f;
+    float y = (i / 8) * 8.f;
+    blocks.Add(x, y, x + 5.f, y + 5.f, 0);
+  }
+  for (int b = 0; b < 60; b += NmsEngine::kIouBlock) {
+    int last = std::min(b + NmsEngine::kIouBlock, 60) - 1;
+    blocks.Add(
+      blocks.box_x1[last], blocks.box_y1[last], blocks.box_x2[last] + 0.5f, blocks.box_y2[last], 0);
+  }
+  blocks.Add(100.f, 100.f, 105.f, 105.f, 0);
+  std::vector<int> keep = RunEngine(blocks, 1, NmsEngine::kDefaultCellSize, 0.45f, 64);
+  CHECK_EQ(keep.size(), 61);
+  CHECK_EQ(keep.back(), (int)blocks.order.size() - 1);
+  CheckScene(blocks, 1, NmsEngine::kDefaultCellSize, 0.45f, 64);
+}
+
+static void CheckExactThreshold()
+{
+  // inclusive pixel bounds: 10x10 inside 10x20 is IoU 0.5, 10x10 inside 20x20 is 0.25
+  Scene scene;
+  scene.Add(0.f, 0.f, 9.f, 19.f, 0);
+  scene.Add(0.f, 0.f, 9.f, 9.f, 0);
+  scene.Add(100.f, 100.f, 119.f, 119.f, 1);
+  scene.Add(100.f, 100.f, 109.f, 109.f, 1);
+  // IoU above the threshold suppresses, equal to it keeps
+  CHECK_EQ(CheckScene(scene, 2, NmsEngine::kDefaultCellSize, 0.5f, 64), 4);
+  CHECK_EQ(CheckScene(scene, 2, NmsEngine::kDefaultCellSize, 0.25f, 64), 3);
+  CHECK_EQ(CheckScene(scene, 2, NmsEngine::kDefaultCellSize, 0.49f, 64), 3);
+  CHECK_EQ(CheckScene(scene, 2, NmsEngine::kDefaultCellSize, 0.24f, 64), 2);
+
+  // a box one pixel apart still intersects with inclusive bounds, across a cell border
+  Scene apart;
+  apart.Add(54.f, 0.f, 63.f, 9.f, 0);
+  apart.Add(63.f, 0.f, 72.f, 9.f, 0);
+  CHECK_EQ(CheckScene(apart, 1, NmsEngine::kDefaultCellSize, 0.05f, 64), 1);
+  CHECK_EQ(CheckScene(apart, 1, NmsEngine::kDefaultCellSize, 0.06f, 64), 2);
+
+  // degenerate and outside boxes
+  Scene odd;
+  odd.Add(-50.f, -50.f, -10.f, -10.f, 0);
+  odd.Add(-49.f, -50.f, -10.f, -10.f, 0);
+  odd.Add(700.f, 700.f, 700.f, 700.f, 0);
+  odd.Add(700.f, 700.f, 700.f, 700.f, 0);
+  odd.Add(5.f, 5.f, 4.f, 4.f, 0);
+  CHECK_EQ(CheckScene(odd, 1, NmsEngine::kDefaultCellSize, 0.45f, 64), 3);
+}
+
+int main()
+{
+#if defined(DET_RK3588_DISABLE_SIMD)
+  printf("scalar IoU kernel\n");
+#else
+  printf("SIMD IoU kernel of the target\n");
+#endif
+  CheckRandomScenes();
+  CheckCrowdedCell();
+  CheckExactThreshold();
+  return TestResult();
+}
@@ -0,0 +1,109 @@
+// NpuCoreScheduler spreads per-core contexts evenly, counts all-cores contexts on every core and
+// auto ones on none, and gives the cores back on Release(), also under concurrent Acquire().
+#include <thread>
+#include <vector>
+
+#include "npu_scheduler.hpp"
+#include "test_utils.hpp"
+
+using namespace det_rk3588;
+
+static NpuCoreScheduler & Scheduler() { return NpuCoreScheduler::Instance(); }
+
+static void CheckCounts(int core0, int core1, int core2, int auto_num)
+{
+  CHECK_EQ(Scheduler().GetContextNum(0), core0);
+  CHECK_EQ(Scheduler().GetContextNum(1), core1);
+  CHECK_EQ(Scheduler().GetContextNum(2), core2);
+  CHECK_EQ(Scheduler().GetAutoContextNum(), auto_num);
+}
+
+static void CheckPerCore()
+{
+  const rknn_core_mask expected[] = {RKNN_NPU_CORE_0, RKNN_NPU_CORE_1, RKNN_NPU_CORE_2};
+  rknn_core_mask masks[6];
+  for (int i = 0; i < 6; ++i) {
+    masks[i] = Scheduler().Acquire(CoreStrategy::kPerCore);
+    CHECK_EQ(masks[i], expected[i % RK3588_CORE_NUM]);
+  }
+  CheckCounts(2, 2, 2, 0);
+
+  // a released core is the least loaded one and is picked next
+  Scheduler().Release(masks[1]);
+  CheckCounts(2, 1, 2, 0);
+  masks[1] = Scheduler().Acquire(CoreStrategy::kPerCore);
+  CHECK_EQ(masks[1], RKNN_NPU_CORE_1);
+
+  for (rknn_core_mask mask : masks) {
+    Scheduler().Release(mask);
+  }
+  CheckCounts(0, 0, 0, 0);
+}
+
+static void CheckAllCoresAndAuto()
+{
+  rknn_core_mask all = Scheduler().Acquire(CoreStrategy::kAllCores);
+  CHECK_EQ(all, RKNN_NPU_CORE_0_1_2);
+  CheckCounts(1, 1, 1, 0);
+  rknn_core_mask automatic = Scheduler().Acquire(CoreStrategy::kAuto);
+  CHECK_EQ(automatic, RKNN_NPU_CORE_AUTO);
+  CheckCounts(1, 1, 1, 1);
+
+  // per-core contexts are balanced on top of the all-cores one
+  rknn_core_mask core = Scheduler().Acquire(CoreStrategy::kPerCore);
+  CHECK_EQ(core, RKNN_NPU_CORE_0);
+  CheckCounts(2, 1, 1, 1);
+
+  Scheduler().Release(all);
+  Scheduler().Release(automatic);
+  Scheduler().Release(core);
+  CheckCounts(0, 0, 0, 0);
+}
+
+static void CheckConcurrent()
+{
+  const int thread_num = 6;
+  const int per_thread = 50;
+  std::vector<rknn_core_mask> masks(thread_num * per_thread);
+  std::vector<std::thread> threads;
+  for (int t = 0; t < thread_num; ++t) {
+    threads.emplace_back([t, &masks]() {
+      for (int i = 0; i < per_thread; ++i) {
+        masks[t * per_thread + i] = Scheduler().Acquire(CoreStrategy::kPerCore);
+      }
+    });
+  }
+  for (std::thread & thread : threads) {
+    thread.join();
+  }
+  int per_core = thread_num * per_thread / RK3588_CORE_NUM;
+  CheckCounts(per_core, per_core, per_core, 0);
+  for (rknn_core_mask mask : masks) {
+    Scheduler().Release(mask);
+  }
+  CheckCounts(0, 0, 0, 0);
+}
+
+static void CheckParse()
+{
+  const CoreStrategy strategies[] = {
+    CoreStrategy::kPerCore, CoreStrategy::kAllCores, CoreStrategy::kAuto};
+  for (CoreStrategy strategy : strategies) {
+    CoreStrategy parsed = CoreStrategy::kPerCore;
+    CHECK_EQ(ParseCoreStrategy(CoreStrategyName(strategy), &parsed), 0);
+    CHECK(parsed == strategy);
+  }
+  CoreStrategy parsed = CoreStrategy::kAuto;
+  CHECK_EQ(ParseCoreStrategy("core-2", &parsed), -1);
+  CHECK(parsed == CoreStrategy::kAuto);
+}
+
+int main()
+{
+  CheckCounts(0, 0, 0, 0);
+  CheckPerCore();
+  CheckAllCoresAndAuto();
+  CheckConcurrent();
+  CheckParse();
+  return TestResult();
+}
@@ -0,0 +1,81 @@
+// The native NHWC and NC1HWC2 decoders (DecodeHeadInterleaved) against the NCHW one (DecodeHead):
+// the same synthetic heads are converted to each layout and every detection must be identical,
+// with class counts that leave a partly padded last C2 block and with banded decoding.
+#include <string.h>
+
+#include "postprocess.hpp"
+#include "synthetic_outputs.hpp"
+#include "test_utils.hpp"
+
+using namespace det_rk3588;
+
+// like RknnModel, the head config comes from the NCHW attrs and the outputs are decoded in place
+static int Detect(
+  const SyntheticOutputs & nchw, const SyntheticOutputs & outputs, int input_size,
+  int decode_threads, DetectResultGroup * group)
+{
+  HeadConfig head;
+  if (
+    LoadHeadConfig("", "", input_size, input_size, nchw.attrs, SyntheticOutputs::kHeadNum, &head) !=
+    0) {
+    return -1;
+  }
+  PostProcessor post_processor;
+  post_processor.SetDecodeThreads(decode_threads);
+  if (
+    post_processor.Init(input_size, input_size, head, outputs.attrs, SyntheticOutputs::kHeadNum) !=
+    0) {
+    return -1;
+  }
+  BoxRect pads = {0, 0, 0, 0};
+  return post_processor.Run(outputs.bufs, pads, 1.f, 1.f, group);
+}
+
+static void CheckSame(const DetectResultGroup & expected, const DetectResultGroup & actual)
+{
+  CHECK_EQ(actual.count, expected.count);
+  for (int i = 0; i < expected.count && i < actual.count; ++i) {
+    const DetectResult & a = actual.results[i];
+    const DetectResult & e = expected.results[i];
+    CHECK_EQ(a.class_id, e.class_id);
+    CHECK(memcmp(&a.box, &e.box, sizeof(BoxRect)) == 0);
+    CHECK(a.prop == e.prop);
+  }
+}
+
+static void RunCase(int input_size, int class_num, float density, int c2, int decode_threads)
+{
+  SyntheticOutputs nchw;
+  MakeSyntheticOutputs(input_size, density, class_num, class_num * 31 + c2, &nchw);
+  SyntheticOutputs nhwc;
+  ToNhwc(nchw, &nhwc);
+  SyntheticOutputs nc1hwc2;
+  ToNc1hwc2(nchw, c2, &nc1hwc2);
+
+  DetectResultGroup expected;
+  DetectResultGroup actual;
+  CHECK_EQ(Detect(nchw, nchw, input_size, 1, &expected), 0);
+  CHECK(expected.count > 0);
+  printf(
+    "input %d, classes %d, channels %d, c2 %d, decode threads %d: %d detections\n", input_size,
+    class_num, OBJ_ANCHOR_NUM * (5 + class_num), c2, decode_threads, expected.count);
+
+  CHECK_EQ(Detect(nchw, nhwc, input_size, decode_threads, &actual), 0);
+  CheckSame(expected, actual);
+  CHECK_EQ(Detect(nchw, nc1hwc2, input_size, decode_threads, &actual), 0);
+  CheckSame(expected, actual);
+}
+
+int main()
+{
+  // 255 channels leave one padding channel in the last block of 16, 24 leave 8, 36 leave 12 and
+  // 18 leave 14, class count 7 also takes the generic class loop
+  RunCase(320, 80, 0.003f, 16, 1);
+  RunCase(320, 3, 0.005f, 16, 1);
+  RunCase(320, 7, 0.005f, 16, 1);
+  RunCase(320, 1, 0.005f, 16, 1);
+  RunCase(320, 80, 0.003f, 8, 1);
+  RunCase(640, 80, 0.001f, 16, 3);
+  RunCase(640, 7, 0.001f, 16, 4);
+  return TestResult();
+}
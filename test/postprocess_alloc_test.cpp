@@ -0,0 +1,74 @@
+// Steady state PostProcessor::Run() must not allocate: the global operator new is replaced by a
+// counting one and every Run() after the first is checked for zero allocations, on the threads of
+// the postprocessor included.
+#include <stdlib.h>
+
+#include <atomic>
+#include <new>
+
+#include "postprocess.hpp"
+#include "synthetic_outputs.hpp"
+#include "test_utils.hpp"
+
+using namespace det_rk3588;
+
+static std::atomic<long> g_allocations(0);
+
+void * operator new(size_t size)
+{
+  g_allocations.fetch_add(1, std::memory_order_relaxed);
+  void * p = malloc(size ? size : 1);
+  if (p == nullptr) {
+    throw std::bad_alloc();
+  }
+  return p;
+}
+
+void operator delete(void * p) noexcept { free(p); }
+
+void operator delete(void * p, size_t) noexcept { free(p); }
+
+static void RunCase(int input_size, float density, int class_num, int decode_threads)
+{
+  SyntheticOutputs outputs;
+  MakeSyntheticOutputs(input_size, density, class_num, input_size + class_num, &outputs);
+  HeadConfig head;
+  CHECK_EQ(
+    LoadHeadConfig(
+      "", "", input_size, input_size, outputs.attrs, SyntheticOutputs::kHeadNum, &head),
+    0);
+  PostProcessor post_processor;
+  post_processor.SetDecodeThreads(decode_threads);
+  CHECK_EQ(
+    post_processor.Init(input_size, input_size, head, outputs.attrs, SyntheticOutputs::kHeadNum),
+    0);
+
+  BoxRect pads = {0, 0, 80, 80};
+  float scale = 0.5f;
+  DetectResultGroup group;
+  // the first call may still size what Init() could not know
+  post_processor.Run(outputs.bufs, pads, scale, scale, &group);
+
+  long before = g_allocations.load();
+  int count = group.count;
+  for (int i = 0; i < 50; ++i) {
+    post_processor.Run(outputs.bufs, pads, scale, scale, &group);
+    CHECK_EQ(group.count, count);
+  }
+  long allocations = g_allocations.load() - before;
+  printf(
+    "input %d, density %.3f, classes %d, decode threads %d: %d detections, %ld allocations in "
+    "50 runs\n",
+    input_size, density, class_num, decode_threads, count, allocations);
+  CHECK_EQ(allocations, 0);
+}
+
+int main()
+{
+  RunCase(640, 0.01f, 80, 1);
+  RunCase(640, 0.05f, 3, 1);
+  RunCase(1280, 0.01f, 80, 1);
+  RunCase(640, 0.01f, 80, 4);
+  RunCase(1280, 0.01f, 80, 3);
+  return TestResult();
+}
@@ -0,0 +1,155 @@
+// Every PostProcessor owns its labels and head config: two models with different class counts and
+// label files, and one without labels, run on threads of their own while a fourth thread keeps
+// creating, loading and destroying instances. Each must return exactly what it returns alone,
+// names included, and an instance going away must not touch the labels of the others.
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "postprocess.hpp"
+#include "synthetic_outputs.hpp"
+#include "test_utils.hpp"
+
+using namespace det_rk3588;
+
+static const int kIterations = 100;
+
+static std::string WriteLabels(const std::string & text)
+{
+  char path[] = "/tmp/postprocess_context_test_XXXXXX";
+  int fd = mkstemp(path);
+  CHECK(fd >= 0);
+  CHECK_EQ(write(fd, text.data(), text.size()), (long long)text.size());
+  close(fd);
+  return path;
+}
+
+struct Model
+{
+  int input_size;
+  SyntheticOutputs outputs;
+  std::string labels_path;  // empty for none
+};
+
+static std::unique_ptr<PostProcessor> Create(const Model & model, int decode_threads)
+{
+  HeadConfig head;
+  CHECK_EQ(
+    LoadHeadConfig(
+      "", "", model.input_size, model.input_size, model.outputs.attrs,
+      SyntheticOutputs::kHeadNum, &head),
+    0);
+  std::unique_ptr<PostProcessor> post_processor(new PostProcessor());
+  post_processor->SetDecodeThreads(decode_threads);
+  CHECK_EQ(
+    post_processor->Init(
+      model.input_size, model.input_size, head, model.outputs.attrs, SyntheticOutputs::kHeadNum),
+    0);
+  if (!model.labels_path.empty()) {
+    CHECK_EQ(post_processor->LoadLabels(model.labels_path.c_str()), 0);
+  }
+  return post_processor;
+}
+
+static void Run(PostProcessor & post_processor, const Model & model, DetectResultGroup * group)
+{
+  BoxRect pads = {0, 0, 0, 0};
+  post_processor.Run(model.outputs.bufs, pads, 1.f, 1.f, group);
+}
+
+static bool Same(const DetectResultGroup & a, const DetectResultGroup & b)
+{
+  return a.count == b.count && memcmp(a.results, b.results, a.count * sizeof(DetectResult)) == 0;
+}
+
+int main()
+{
+  // 80 labels, and 2 of 3 with Windows line ends
+  std::string coco;
+  for (int k = 0; k < 80; ++k) {
+    coco += "coco_" + std::to_string(k) + "\n";
+  }
+  Model models[3];
+  models[0].input_size = 320;
+  MakeSyntheticOutputs(320, 0.01f, 80, 11, &models[0].outputs);
+  models[0].labels_path = WriteLabels(coco);
+  models[1].input_size = 640;
+  MakeSyntheticOutputs(640, 0.002f, 3, 12, &models[1].outputs);
+  models[1].labels_path = WriteLabels("car\r\nbus\r\n");
+  models[2].input_size = 320;
+  MakeSyntheticOutputs(320, 0.01f, 80, 11, &models[2].outputs);
+
+  // alone
+  DetectResultGroup expected[3];
+  for (int m = 0; m < 3; ++m) {
+    std::unique_ptr<PostProcessor> post_processor = Create(models[m], 1);
+    Run(*post_processor, models[m], &expected[m]);
+    CHECK(expected[m].count > 0);
+  }
+  // each model is named from its own table
+  for (int i = 0; i < expected[0].count; ++i) {
+    const DetectResult & result = expected[0].results[i];
+    CHECK(std::string(result.name) == "coco_" + std::to_string(result.class_id));
+  }
+  bool has_unlabeled = false;
+  for (int i = 0; i < expected[1].count; ++i) {
+    const DetectResult & result = expected[1].results[i];
+    const char * names[] = {"car", "bus", "unknown"};
+    CHECK(strcmp(result.name, names[result.class_id]) == 0);
+    has_unlabeled = has_unlabeled || result.class_id == 2;
+  }
+  CHECK(has_unlabeled);
+  for (int i = 0; i < expected[2].count; ++i) {
+    CHECK(strcmp(expected[2].results[i].name, "unknown") == 0);
+  }
+
+  // a missing file fails and keeps the labels loaded before
+  {
+    std::unique_ptr<PostProcessor> post_processor = Create(models[0], 1);
+    CHECK_EQ(post_processor->LoadLabels("/nonexistent/labels.txt"), -1);
+    DetectResultGroup group;
+    Run(*post_processor, models[0], &group);
+    CHECK(Same(group, expected[0]));
+  }
+
+  // together, the threads count their own mismatches
+  std::atomic<int> mismatches(0);
+  std::vector<std::thread> threads;
+  for (int m = 0; m < 3; ++m) {
+    threads.emplace_back([m, &models, &expected, &mismatches]() {
+      std::unique_ptr<PostProcessor> post_processor = Create(models[m], m == 0 ? 2 : 1);
+      DetectResultGroup group;
+      for (int it = 0; it < kIterations; ++it) {
+        Run(*post_processor, models[m], &group);
+        mismatches += Same(group, expected[m]) ? 0 : 1;
+      }
+    });
+  }
+  // instances of the first model come and go meanwhile
+  threads.emplace_back([&models, &expected, &mismatches]() {
+    for (int it = 0; it < kIterations / 4; ++it) {
+      std::unique_ptr<PostProcessor> post_processor = Create(models[it % 2], 1);
+      DetectResultGroup group;
+      Run(*post_processor, models[it % 2], &group);
+      mismatches += Same(group, expected[it % 2]) ? 0 : 1;
+    }
+  });
+  for (std::thread & thread : threads) {
+    thread.join();
+  }
+  printf(
+    "%d, %d and %d detections, %d concurrent runs, %d mismatches\n", expected[0].count,
+    expected[1].count, expected[2].count, 3 * kIterations + kIterations / 4, mismatches.load());
+  CHECK_EQ(mismatches.load(), 0);
+
+  unlink(models[0].labels_path.c_str());
+  unlink(models[1].labels_path.c_str());
+  return TestResult();
+}
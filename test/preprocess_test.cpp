@@ -0,0 +1,373 @@
+// The fused letterbox against what it replaces: LetterBoxBgrToRgb() and BilinearResizer are
+// compared with an exact floating point bilinear resize and with the cvtColor + cv::resize +
+// copyMakeBorder chain of LetterBox(), BilinearResizer reusing its tables with a fresh one,
+// LetterBoxBuffer with the one-shot form and on the border it leaves alone, and the NV12 path
+// with cvtColor(COLOR_YUV2BGR_NV12) followed by that chain.
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+#include <random>
+#include <vector>
+
+#include "preprocess.hpp"
+#include "test_utils.hpp"
+
+using namespace det_rk3588;
+
+static const cv::Size kTargetSize(640, 640);
+
+static cv::Mat MakeImage(int width, int height, int type, unsigned seed)
+{
+  std::mt19937 rng(seed);
+  cv::Mat image(height, width, type);
+  for (int y = 0; y < height; ++y) {
+    uint8_t * row = image.ptr<uint8_t>(y);
+    for (int x = 0; x < width * image.channels(); ++x) {
+      row[x] = (uint8_t)rng();
+    }
+  }
+  return image;
+}
+
+// channel c of src at (x, y) in source coordinates, the borders clamped like cv::resize()
+static double Bilinear(const cv::Mat & src, int c, double x, double y)
+{
+  int channels = src.channels();
+  int x0 = (int)floor(x);
+  int y0 = (int)floor(y);
+  double bx = x - x0;
+  double by = y - y0;
+  if (x0 < 0) {
+    x0 = 0, bx = 0;
+  }
+  if (x0 >= src.cols - 1) {
+    x0 = src.cols - 1, bx = 0;
+  }
+  if (y0 < 0) {
+    y0 = 0, by = 0;
+  }
+  if (y0 >= src.rows - 1) {
+    y0 = src.rows - 1, by = 0;
+  }
+  int x1 = std::min(x0 + 1, src.cols - 1);
+  int y1 = std::min(y0 + 1, src.rows - 1);
+  const uint8_t * r0 = src.ptr<uint8_t>(y0);
+  const uint8_t * r1 = src.ptr<uint8_t>(y1);
+  double top = r0[x0 * channels + c] * (1 - bx) + r0[x1 * channels + c] * bx;
+  double bottom = r1[x0 * channels + c] * (1 - bx) + r1[x1 * channels + c] * bx;
+  return top * (1 - by) + bottom * by;
+}
+
+static void CheckLetterBox(int width, int height)
+{
+  cv::Mat image = MakeImage(width, height, CV_8UC3, width * 7 + height);
+  float scale = std::min((float)kTargetSize.width / width, (float)kTargetSize.height / height);
+  std::vector<uint8_t> out(kTargetSize.area() * 3);
+  BoxRect pads;
+  CHECK_EQ(LetterBoxBgrToRgb(image, out.data(), pads, scale, kTargetSize), 0);
+
+  cv::Mat rgb;
+  cv::cvtColor(image, rgb, cv::COLOR_BGR2RGB);
+  cv::Mat padded;
+  BoxRect opencv_pads;
+  LetterBox(rgb, padded, opencv_pads, scale, kTargetSize, cv::Scalar(128, 128, 128));
+  CHECK(padded.size() == kTargetSize);
+  CHECK(memcmp(&pads, &opencv_pads, sizeof(BoxRect)) == 0);
+
+  int resized_w = kTargetSize.width - pads.left - pads.right;
+  int resized_h = kTargetSize.height - pads.top - pads.bottom;
+  int exact_diff = 0;
+  int opencv_diff = 0;
+  int pad_errors = 0;
+  for (int y = 0; y < kTargetSize.height; ++y) {
+    const uint8_t * opencv_row = padded.ptr<uint8_t>(y);
+    for (int x = 0; x < kTargetSize.width; ++x) {
+      int ry = y - pads.top;
+      int rx = x - pads.left;
+      bool active = ry >= 0 && rx >= 0 && ry < resized_h && rx < resized_w;
+      for (int c = 0; c < 3; ++c) {
+        int value = out[(y * kTargetSize.width + x) * 3 + c];
+        opencv_diff = std::max(opencv_diff, abs(value - opencv_row[x * 3 + c]));
+        if (!active) {
+          pad_errors += value != 128;
+          continue;
+        }
+        // RGB channel c is BGR channel 2 - c
+        double exact = Bilinear(image, 2 - c, (rx + 0.5) / scale - 0.5, (ry + 0.5) / scale - 0.5);
+        exact_diff = std::max(exact_diff, abs(value - (int)lround(exact)));
+      }
+    }
+  }
+  printf(
+    "letterbox %dx%d -> %dx%d: max abs diff %d to exact bilinear, %d to LetterBox()\n", width,
+    height, resized_w, resized_h, exact_diff, opencv_diff);
+  // Q8 / Q15 weights truncate, so a pixel may be off by one from the rounded exact value; OpenCV
+  // rounds its own Q11 weights and may be off by one in the other direction
+  CHECK(exact_diff <= 1);
+  CHECK(opencv_diff <= 2);
+  CHECK_EQ(pad_errors, 0);
+}
+
+static void CheckSingleChannel(int width, int height, float scale)
+{
+  cv::Mat image = MakeImage(width, height, CV_8UC1, width + height * 3);
+  cv::Size dst_size((int)lround(width * (double)scale), (int)lround(height * (double)scale));
+  std::vector<uint8_t> out(dst_size.area());
+  BilinearResizer resizer;
+  CHECK_EQ(resizer.Prepare(image.size(), dst_size, scale, 1), 0);
+  resizer.Run(image, out.data(), dst_size.width, false);
+
+  int exact_diff = 0;
+  for (int y = 0; y < dst_size.height; ++y) {
+    for (int x = 0; x < dst_size.width; ++x) {
+      double exact = Bilinear(image, 0, (x + 0.5) / scale - 0.5, (y + 0.5) / scale - 0.5);
+      exact_diff = std::max(exact_diff, abs(out[y * dst_size.width + x] - (int)lround(exact)));
+    }
+  }
+  printf(
+    "resize 1 channel %dx%d -> %dx%d: max abs diff %d to exact bilinear\n", width, height,
+    dst_size.width, dst_size.height, exact_diff);
+  CHECK(exact_diff <= 1);
+}
+
+// one resizer over a stream of geometries gives the bytes of a fresh one for each, so cached
+// tables are reused only for the geometry they were built for; the third frame keeps the source
+// and target sizes and changes the scale alone
+static void CheckResizerCache()
+{
+  const int sizes[][2] = {{1280, 720}, {1280, 720}, {1280, 720}, {1920, 1080}, {300, 900}};
+  const float scales[] = {0.5f, 0.5f, 0.5003f, 0.25f, 0.7f};
+  BilinearResizer cached;
+  for (int i = 0; i < 5; ++i) {
+    cv::Mat image = MakeImage(sizes[i][0], sizes[i][1], CV_8UC3, 200 + i);
+    float scale = scales[i];
+    cv::Size dst_size(
+      (int)lround(image.cols * (double)scale), (int)lround(image.rows * (double)scale));
+    size_t stride = dst_size.width * 3;
+    std::vector<uint8_t> expected(stride * dst_size.height);
+    std::vector<uint8_t> actual(stride * dst_size.height);
+    BilinearResizer fresh;
+    CHECK_EQ(fresh.Prepare(image.size(), dst_size, scale), 0);
+    fresh.Run(image, expected.data(), stride, true);
+    CHECK_EQ(cached.Prepare(image.size(), dst_size, scale), 0);
+    cached.Run(image, actual.data(), stride, true);
+    CHECK(memcmp(expected.data(), actual.data(), expected.size()) == 0);
+  }
+  CHECK_EQ(cached.Prepare(cv::Size(0, 720), cv::Size(320, 180), 0.25f), -1);
+}
+
+// a stream that changes resolution, every frame must match the one-shot conversion
+static void CheckLetterBoxBuffer()
+{
+  const int sizes[][2] = {{1280, 720}, {1280, 720}, {1920, 1080}, {300, 900}, {1280, 720}};
+  LetterBoxBuffer buffer;
+  CHECK_EQ(buffer.Init(kTargetSize), 0);
+  std::vector<uint8_t> expected(kTargetSize.area() * 3);
+  for (int i = 0; i < 5; ++i) {
+    cv::Mat image = MakeImage(sizes[i][0], sizes[i][1], CV_8UC3, i);
+    CHECK_EQ(buffer.Write(image), 0);
+    const LetterBoxGeometry & geometry = buffer.GetGeometry();
+    BoxRect pads;
+    CHECK_EQ(LetterBoxBgrToRgb(image, expected.data(), pads, geometry.scale, kTargetSize), 0);
+    CHECK(memcmp(&pads, &geometry.pads, sizeof(BoxRect)) == 0);
+    CHECK(memcmp(expected.data(), buffer.GetData(), expected.size()) == 0);
+  }
+}
+
+// whether pixel (x, y) of the target is border for geometry
+static bool IsBorder(const LetterBoxGeometry & geometry, int x, int y)
+{
+  const BoxRect & pads = geometry.pads;
+  return x < pads.left || y < pads.top || x >= pads.left + geometry.resized_size.width ||
+         y >= pads.top + geometry.resized_size.height;
+}
+
+// fills the border of a strided target with value
+static void FillBorder(
+  const LetterBoxGeometry & geometry, uint8_t * data, size_t stride, uint8_t value)
+{
+  for (int y = 0; y < kTargetSize.height; ++y) {
+    for (int x = 0; x < kTargetSize.width; ++x) {
+      if (IsBorder(geometry, x, y)) {
+        memset(data + y * stride + x * 3, value, 3);
+      }
+    }
+  }
+}
+
+// The border is written when the geometry changes and never by the frames after it: a marker
+// put into it survives the next frames of the same size and is replaced when the size changes.
+// Runs on external memory with a padded row stride, the way an NPU input tensor is bound.
+static void CheckLetterBoxBufferBorder()
+{
+  const int sizes[][2] = {{1920, 1080}, {1920, 1080}, {1280, 720}, {1280, 720}, {300, 900}};
+  const size_t stride = kTargetSize.width * 3 + 64;
+  std::vector<uint8_t> tensor(stride * kTargetSize.height, 0);
+  LetterBoxBuffer buffer;
+  CHECK_EQ(buffer.Init(kTargetSize, tensor.data(), stride), 0);
+  CHECK(buffer.GetData() == tensor.data());
+  std::vector<uint8_t> expected(kTargetSize.area() * 3);
+  cv::Size previous_size;
+  for (int i = 0; i < 5; ++i) {
+    cv::Mat image = MakeImage(sizes[i][0], sizes[i][1], CV_8UC3, 100 + i);
+    bool same_size = image.size() == previous_size;
+    previous_size = image.size();
+    if (same_size) {
+      FillBorder(buffer.GetGeometry(), tensor.data(), stride, 7);
+    }
+    CHECK_EQ(buffer.Write(image), 0);
+    const LetterBoxGeometry & geometry = buffer.GetGeometry();
+    BoxRect pads;
+    CHECK_EQ(LetterBoxBgrToRgb(image, expected.data(), pads, geometry.scale, kTargetSize), 0);
+    CHECK(memcmp(&pads, &geometry.pads, sizeof(BoxRect)) == 0);
+
+    // the image region is the one-shot conversion, the border is the marker or the pad value
+    int wrong = 0;
+    for (int y = 0; y < kTargetSize.height; ++y) {
+      for (int x = 0; x < kTargetSize.width * 3; ++x) {
+        uint8_t value = tensor[y * stride + x];
+        uint8_t want = expected[(y * kTargetSize.width) * 3 + x];
+        if (same_size && IsBorder(geometry, x / 3, y)) {
+          want = 7;
+        }
+        wrong += value != want ? 1 : 0;
+      }
+    }
+    CHECK_EQ(wrong, 0);
+  }
+}
+
+// source taps of destination index d, clamped like Bilinear()
+static void Taps(int d, float scale, int len, int * t0, int * t1)
+{
+  *t0 = std::min(std::max((int)floor((d + 0.5) / scale - 0.5), 0), len - 1);
+  *t1 = std::min(*t0 + 1, len - 1);
+}
+
+// NV12 with luma in [90, 160] and chroma within 40 of neutral, so no channel clips and the order
+// of resize and colour conversion only changes the rounding. U and V are constant over blocks of
+// kChromaBlock chroma pixels, so where every tap of both paths falls inside one block the chroma
+// is exact whether it is resized (LetterBoxBuffer) or replicated (cvtColor).
+static const int kChromaBlock = 16;
+
+static void CheckNv12(int width, int height)
+{
+  std::mt19937 rng(width + height);
+  std::uniform_int_distribution<int> luma(90, 160);
+  std::uniform_int_distribution<int> chroma(88, 168);
+  cv::Mat nv12(height * 3 / 2, width, CV_8UC1);
+  for (int y = 0; y < height; ++y) {
+    for (int x = 0; x < width; ++x) {
+      nv12.ptr<uint8_t>(y)[x] = (uint8_t)luma(rng);
+    }
+  }
+  int blocks_w = (width / 2 + kChromaBlock - 1) / kChromaBlock;
+  int blocks_h = (height / 2 + kChromaBlock - 1) / kChromaBlock;
+  std::vector<uint8_t> block_uv(blocks_w * blocks_h * 2);
+  for (size_t i = 0; i < block_uv.size(); ++i) {
+    block_uv[i] = (uint8_t)chroma(rng);
+  }
+  for (int y = 0; y < height / 2; ++y) {
+    uint8_t * row = nv12.ptr<uint8_t>(height + y);
+    for (int x = 0; x < width / 2; ++x) {
+      const uint8_t * uv = &block_uv[((y / kChromaBlock) * blocks_w + x / kChromaBlock) * 2];
+      row[x * 2] = uv[0];
+      row[x * 2 + 1] = uv[1];
+    }
+  }
+
+  LetterBoxBuffer buffer;
+  CHECK_EQ(buffer.Init(kTargetSize), 0);
+  Nv12Frame frame = WrapNv12(nv12);
+  CHECK_EQ(buffer.Write(frame), 0);
+  const LetterBoxGeometry & geometry = buffer.GetGeometry();
+  const BoxRect & pads = geometry.pads;
+  float scale = geometry.scale;
+
+  cv::Mat bgr;
+  cv::cvtColor(nv12, bgr, cv::COLOR_YUV2BGR_NV12);
+  cv::Mat rgb;
+  cv::cvtColor(bgr, rgb, cv::COLOR_BGR2RGB);
+  cv::Mat padded;
+  BoxRect opencv_pads;
+  LetterBox(rgb, padded, opencv_pads, scale, kTargetSize, cv::Scalar(128, 128, 128));
+  CHECK(memcmp(&pads, &opencv_pads, sizeof(BoxRect)) == 0);
+
+  int exact_diff = 0;
+  int opencv_diff = 0;
+  int compared = 0;
+  const uint8_t * out = buffer.GetData();
+  for (int ry = 0; ry < geometry.resized_size.height; ++ry) {
+    int ly0, ly1, cy0, cy1;
+    Taps(ry, scale, height, &ly0, &ly1);
+    Taps(ry, scale * 2.f, height / 2, &cy0, &cy1);
+    int block_y = ly0 / 2 / kChromaBlock;
+    bool uniform_y = ly1 / 2 / kChromaBlock == block_y && cy0 / kChromaBlock == block_y &&
+                     cy1 / kChromaBlock == block_y;
+    for (int rx = 0; rx < geometry.resized_size.width; ++rx) {
+      int lx0, lx1, cx0, cx1;
+      Taps(rx, scale, width, &lx0, &lx1);
+      Taps(rx, scale * 2.f, width / 2, &cx0, &cx1);
+      int block_x = lx0 / 2 / kChromaBlock;
+      if (
+        !uniform_y || lx1 / 2 / kChromaBlock != block_x || cx0 / kChromaBlock != block_x ||
+        cx1 / kChromaBlock != block_x) {
+        continue;
+      }
+      // BT.601 limited range in floating point, the Q20 coefficients divided out
+      const uint8_t * uv = &block_uv[(block_y * blocks_w + block_x) * 2];
+      double u = uv[0] - 128;
+      double v = uv[1] - 128;
+      double yy = (Bilinear(frame.y, 0, (rx + 0.5) / scale - 0.5, (ry + 0.5) / scale - 0.5) - 16) *
+                  (1220542 / 1048576.0);
+      double exact[3] = {
+        yy + 1673527 / 1048576.0 * v,
+        yy - 409993 / 1048576.0 * u - 852492 / 1048576.0 * v,
+        yy + 2116026 / 1048576.0 * u};
+      int x = rx + pads.left;
+      int y = ry + pads.top;
+      for (int c = 0; c < 3; ++c) {
+        int value = out[(y * kTargetSize.width + x) * 3 + c];
+        exact_diff = std::max(exact_diff, abs(value - (int)lround(exact[c])));
+        opencv_diff = std::max(opencv_diff, abs(value - padded.ptr<uint8_t>(y)[x * 3 + c]));
+      }
+      ++compared;
+    }
+  }
+  printf(
+    "nv12 %dx%d -> %dx%d: %d pixels with uniform chroma, max abs diff %d to exact BT.601, %d to "
+    "cvtColor + LetterBox()\n",
+    width, height, geometry.resized_size.width, geometry.resized_size.height, compared,
+    exact_diff, opencv_diff);
+  CHECK(compared > geometry.resized_size.area() / 2);
+  // the resized luma is within 1 of exact and the conversion scales it by 1.164, the Q20 shift
+  // then floors
+  CHECK(exact_diff <= 2);
+  // cvtColor floors at full resolution and cv::resize rounds after it, each side may be off by
+  // up to 2 from exact in opposite directions
+  CHECK(opencv_diff <= 3);
+}
+
+int main()
+{
+  CheckLetterBox(1280, 720);
+  CheckLetterBox(1920, 1080);
+  CheckLetterBox(3840, 2160);
+  CheckLetterBox(500, 375);
+  CheckLetterBox(300, 900);
+  CheckLetterBox(640, 640);
+  CheckLetterBox(320, 240);
+  CheckSingleChannel(1920, 1080, 0.3f);
+  CheckSingleChannel(320, 240, 2.5f);
+  CheckResizerCache();
+  CheckLetterBoxBuffer();
+  CheckLetterBoxBufferBorder();
+  CheckNv12(1920, 1080);
+  CheckNv12(1280, 720);
+  CheckNv12(3840, 2160);
+  CheckNv12(640, 480);
+  CheckNv12(300, 900);
+  return TestResult();
+}
@@ -0,0 +1,410 @@
+// RknnModel on the stub runtime, which is compiled in. rknn_set_io_mem and the per frame calls
+// are wrapped by the linker (-Wl,--wrap) to count them: with bound tensors every slot binds once
+// at init and never again, whatever the order the slots run in, and a bound tensor is synced
+// instead of being copied by rknn_inputs_set or rknn_outputs_get. The staged API is timed to
+// check that a frame is preprocessed and submitted while the one before it is still on the NPU.
+// The bound input tensors are kept to check that a warm-up at the stream size leaves the
+// letterbox of the first frame built: its border is not written again, and that NV12 frames
+// reach them converted. Through a RknnPool, InferResults come back in submission order with
+// their frame ids, a status and ordered stage timestamps.
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <vector>
+
+#include "rknn_model.hpp"
+#include "rknn_pool.hpp"
+#include "test_utils.hpp"
+
+using namespace det_rk3588;
+
+static const int kLatencyUs = 20000;
+static const int kFrameNum = 12;
+
+static int g_binds = 0;
+// input tensors bound since the last clear
+static std::vector<rknn_tensor_mem *> g_input_mems;
+// per frame runtime calls, copies and cache syncs
+static std::atomic<int> g_inputs_sets(0);
+static std::atomic<int> g_outputs_gets(0);
+static std::atomic<int> g_syncs_to_device(0);
+static std::atomic<int> g_syncs_from_device(0);
+
+extern "C" int __real_rknn_set_io_mem(
+  rknn_context ctx, rknn_tensor_mem * mem, rknn_tensor_attr * attr);
+extern "C" int __real_rknn_inputs_set(rknn_context ctx, uint32_t n_inputs, rknn_input inputs[]);
+extern "C" int __real_rknn_outputs_get(
+  rknn_context ctx, uint32_t n_outputs, rknn_output outputs[], rknn_output_extend * extend);
+extern "C" int __real_rknn_mem_sync(
+  rknn_context ctx, rknn_tensor_mem * mem, rknn_mem_sync_mode mode);
+
+extern "C" int __wrap_rknn_set_io_mem(
+  rknn_context ctx, rknn_tensor_mem * mem, rknn_tensor_attr * attr)
+{
+  ++g_binds;
+  if (attr->type == RKNN_TENSOR_UINT8) {
+    g_input_mems.push_back(mem);
+  }
+  return __real_rknn_set_io_mem(ctx, mem, attr);
+}
+
+extern "C" int __wrap_rknn_inputs_set(rknn_context ctx, uint32_t n_inputs, rknn_input inputs[])
+{
+  ++g_inputs_sets;
+  return __real_rknn_inputs_set(ctx, n_inputs, inputs);
+}
+
+extern "C" int __wrap_rknn_outputs_get(
+  rknn_context ctx, uint32_t n_outputs, rknn_output outputs[], rknn_output_extend * extend)
+{
+  ++g_outputs_gets;
+  return __real_rknn_outputs_get(ctx, n_outputs, outputs, extend);
+}
+
+extern "C" int __wrap_rknn_mem_sync(
+  rknn_context ctx, rknn_tensor_mem * mem, rknn_mem_sync_mode mode)
+{
+  ++(mode == RKNN_MEMORY_SYNC_TO_DEVICE ? g_syncs_to_device : g_syncs_from_device);
+  return __real_rknn_mem_sync(ctx, mem, mode);
+}
+
+static double NowMs()
+{
+  return std::chrono::duration<double, std::milli>(
+           std::chrono::steady_clock::now().time_since_epoch())
+    .count();
+}
+
+static std::string WriteModelFile()
+{
+  char path[] = "/tmp/rknn_model_test_XXXXXX";
+  int fd = mkstemp(path);
+  CHECK(fd >= 0);
+  std::vector<uint8_t> model(4096, 1);
+  CHECK_EQ(write(fd, model.data(), model.size()), (long long)model.size());
+  close(fd);
+  return path;
+}
+
+static cv::Mat MakeFrame(int width, int height)
+{
+  cv::Mat frame(height, width, CV_8UC3);
+  for (int y = 0; y < height; ++y) {
+    for (int x = 0; x < width * 3; ++x) {
+      frame.ptr(y)[x] = (uint8_t)(x * 7 + y * 3);
+    }
+  }
+  return frame;
+}
+
+// detections of kFrameNum frames, submitted two at a time so the slots alternate
+static int CheckBinds(
+  const std::string & model_path, OutputLayout layout, IoMode io_mode, const char * name)
+{
+  RknnModelOptions options;
+  options.output_layout = layout;
+  options.io_mode = io_mode;
+  options.labels_path = "";
+  RknnModel model(model_path, options);
+  g_binds = 0;
+  CHECK_EQ(model.Init(nullptr, false), 0);
+  bool bound = layout != OutputLayout::kNchw || io_mode == IoMode::kZeroCopy;
+  int per_slot = bound ? 3 + (io_mode == IoMode::kZeroCopy ? 1 : 0) : 0;
+  CHECK_EQ(g_binds, RknnModel::kSlotNum * per_slot);
+  int init_binds = g_binds;
+  CHECK_EQ(model.Warmup<cv::Mat>(), 0);
+
+  cv::Mat frame = MakeFrame(1280, 720);
+  int detections = 0;
+  DetectResultGroup group;
+  g_inputs_sets = 0;
+  g_outputs_gets = 0;
+  g_syncs_to_device = 0;
+  g_syncs_from_device = 0;
+  for (int i = 0; i < kFrameNum; i += 2) {
+    int first = model.Submit(frame);
+    int second = model.Submit(frame);
+    CHECK(first >= 0 && second >= 0 && first != second);
+    CHECK_EQ(model.Collect(first, &group), 0);
+    detections += group.count;
+    CHECK_EQ(model.Collect(second, &group), 0);
+    detections += group.count;
+  }
+  printf(
+    "%s: %d binds at init, %d after warm-up and %d frames, %d detections, per frame %.0f inputs "
+    "set, %.0f outputs get, %.0f syncs to and %.0f from the device\n",
+    name, init_binds, g_binds, kFrameNum, detections, g_inputs_sets.load() / (double)kFrameNum,
+    g_outputs_gets.load() / (double)kFrameNum, g_syncs_to_device.load() / (double)kFrameNum,
+    g_syncs_from_device.load() / (double)kFrameNum);
+  CHECK_EQ(g_binds, init_binds);
+  // a bound tensor is never copied by the runtime, it is synced instead
+  bool input_bound = io_mode == IoMode::kZeroCopy;
+  CHECK_EQ(g_inputs_sets.load(), input_bound ? 0 : kFrameNum);
+  CHECK_EQ(g_syncs_to_device.load(), input_bound ? kFrameNum : 0);
+  CHECK_EQ(g_outputs_gets.load(), bound ? 0 : kFrameNum);
+  CHECK_EQ(g_syncs_from_device.load(), bound ? kFrameNum * 3 : 0);
+  return detections;
+}
+
+static void CheckOverlap(const std::string & model_path)
+{
+  RknnModelOptions options;
+  options.io_mode = IoMode::kZeroCopy;
+  options.labels_path = "";
+  RknnModel model(model_path, options);
+  CHECK_EQ(model.Init(nullptr, false), 0);
+  cv::Mat frame = MakeFrame(1920, 1080);
+  CHECK_EQ(model.Warmup<cv::Mat>(frame.size()), 0);
+  DetectResultGroup group;
+
+  // one frame at a time, preprocessing and the run add up
+  double start = NowMs();
+  for (int i = 0; i < kFrameNum; ++i) {
+    CHECK_EQ(model.Collect(model.Submit(frame), &group), 0);
+  }
+  double sequential_ms = NowMs() - start;
+
+  // the next frame is submitted before the previous one is collected
+  start = NowMs();
+  int previous = model.Submit(frame);
+  double first_submitted = NowMs();
+  double second_submitted = 0;
+  for (int i = 1; i < kFrameNum; ++i) {
+    int slot = model.Submit(frame);
+    if (i == 1) {
+      second_submitted = NowMs();
+    }
+    CHECK_EQ(model.Collect(previous, &group), 0);
+    previous = slot;
+  }
+  CHECK_EQ(model.Collect(previous, &group), 0);
+  double pipelined_ms = NowMs() - start;
+
+  double submit_ms = second_submitted - first_submitted;
+  printf(
+    "%d frames of 1920x1080, %.1f ms runs: sequential %.1f ms, pipelined %.1f ms, second frame "
+    "submitted %.1f ms after the first\n",
+    kFrameNum, kLatencyUs / 1000.0, sequential_ms, pipelined_ms, submit_ms);
+  // frame 2 did not wait for the run of frame 1
+  CHECK(submit_ms < kLatencyUs / 1000.0);
+  // preprocessing hides behind the runs, the NPU time is the floor
+  CHECK(pipelined_ms >= kFrameNum * kLatencyUs / 1000.0);
+  CHECK(pipelined_ms < sequential_ms);
+}
+
+// Whether the first frames after a WarmupType warm-up at warmup_size rebuilt the letterbox
+// geometry. The
+// geometry fills the border once and Write() leaves it alone, so a marker put into the top
+// border row of every slot input after the warm-up survives unless the geometry changed.
+template <typename WarmupType, typename FrameType>
+static bool FirstFrameRebuilds(
+  const std::string & model_path, const FrameType & frame, const cv::Size & warmup_size)
+{
+  RknnModelOptions options;
+  options.io_mode = IoMode::kZeroCopy;
+  options.labels_path = "";
+  RknnModel model(model_path, options);
+  g_input_mems.clear();
+  CHECK_EQ(model.Init(nullptr, false), 0);
+  CHECK_EQ(g_input_mems.size(), RknnModel::kSlotNum);
+  CHECK_EQ(model.Warmup<WarmupType>(warmup_size), 0);
+  // 1920x1080 letterboxed into 640x640 leaves 140 border rows on top
+  for (rknn_tensor_mem * mem : g_input_mems) {
+    memset(mem->virt_addr, 0, 640 * 3);
+  }
+  DetectResultGroup group;
+  // one frame per slot, each slot has a letterbox buffer of its own
+  int first = model.Submit(frame);
+  int second = model.Submit(frame);
+  CHECK_EQ(model.Collect(first, &group), 0);
+  CHECK_EQ(model.Collect(second, &group), 0);
+  int rebuilt = 0;
+  for (rknn_tensor_mem * mem : g_input_mems) {
+    rebuilt += ((uint8_t *)mem->virt_addr)[0] == 128 ? 1 : 0;
+  }
+  // both slots agree
+  CHECK(rebuilt == 0 || rebuilt == RknnModel::kSlotNum);
+  return rebuilt > 0;
+}
+
+static void CheckWarmupSize(const std::string & model_path)
+{
+  cv::Mat frame = MakeFrame(1920, 1080);
+  cv::Mat nv12(1080 * 3 / 2, 1920, CV_8UC1, cv::Scalar(100));
+  Nv12Frame nv12_frame = WrapNv12(nv12);
+
+  // a model size warm-up leaves the geometry of the stream to its first frame
+  CHECK(FirstFrameRebuilds<cv::Mat>(model_path, frame, cv::Size()));
+  CHECK(FirstFrameRebuilds<Nv12Frame>(model_path, nv12_frame, cv::Size()));
+  CHECK(!FirstFrameRebuilds<cv::Mat>(model_path, frame, frame.size()));
+  CHECK(!FirstFrameRebuilds<Nv12Frame>(model_path, nv12_frame, frame.size()));
+  // FrameJob and TileJob carry BGR images
+  CHECK(!FirstFrameRebuilds<FrameJob>(model_path, frame, frame.size()));
+  CHECK(!FirstFrameRebuilds<TileJob>(model_path, frame, frame.size()));
+
+  // an odd size cannot be an NV12 frame
+  RknnModel model(model_path);
+  CHECK_EQ(model.Init(nullptr, false), 0);
+  CHECK_EQ(model.Warmup<Nv12Frame>(cv::Size(1919, 1080)), -1);
+}
+
+// random luma and chroma, a 3 / 2 rows high CV_8UC1 image
+static cv::Mat MakeNv12(int width, int height)
+{
+  cv::Mat nv12(height * 3 / 2, width, CV_8UC1);
+  for (int y = 0; y < nv12.rows; ++y) {
+    for (int x = 0; x < width; ++x) {
+      nv12.ptr(y)[x] = (uint8_t)((x * 13 + y * 29) ^ (x >> 3));
+    }
+  }
+  return nv12;
+}
+
+static bool SameGroup(const DetectResultGroup & a, const DetectResultGroup & b)
+{
+  return a.count == b.count && memcmp(a.results, b.results, a.count * sizeof(DetectResult)) == 0;
+}
+
+// NV12 frames go into the bound input tensor as LetterBoxBuffer converts them, their boxes are
+// mapped back like those of a BGR frame of the same size, and a RknnPool takes them as jobs
+static void CheckNv12Input(const std::string & model_path)
+{
+  const int width = 1920;
+  const int height = 1080;
+  cv::Mat nv12 = MakeNv12(width, height);
+  Nv12Frame frame = WrapNv12(nv12);
+  LetterBoxBuffer expected;
+  CHECK_EQ(expected.Init(cv::Size(640, 640)), 0);
+  CHECK_EQ(expected.Write(frame), 0);
+
+  RknnModelOptions options;
+  options.io_mode = IoMode::kZeroCopy;
+  options.labels_path = "";
+  RknnModel model(model_path, options);
+  g_input_mems.clear();
+  CHECK_EQ(model.Init(nullptr, false), 0);
+  CHECK_EQ(g_input_mems.size(), RknnModel::kSlotNum);
+  CHECK_EQ(model.Warmup<Nv12Frame>(cv::Size(width, height)), 0);
+
+  // an invalid frame fails alone and leaves its slot free
+  cv::Mat odd(1080 * 3 / 2, 1919, CV_8UC1, cv::Scalar(0));
+  Nv12Frame invalid = {odd.rowRange(0, 1080), cv::Mat()};
+  CHECK_EQ(model.Submit(invalid), -1);
+
+  DetectResultGroup groups[RknnModel::kSlotNum];
+  int slots[RknnModel::kSlotNum];
+  for (int i = 0; i < RknnModel::kSlotNum; ++i) {
+    slots[i] = model.Submit(frame);
+    CHECK(slots[i] >= 0);
+  }
+  for (int i = 0; i < RknnModel::kSlotNum; ++i) {
+    CHECK_EQ(model.Collect(slots[i], &groups[i]), 0);
+  }
+  int wrong_inputs = 0;
+  for (rknn_tensor_mem * mem : g_input_mems) {
+    wrong_inputs += memcmp(mem->virt_addr, expected.GetData(), 640 * 640 * 3) != 0 ? 1 : 0;
+  }
+  CHECK_EQ(wrong_inputs, 0);
+
+  cv::Mat bgr = MakeFrame(width, height);
+  DetectResultGroup bgr_group;
+  CHECK_EQ(model.Collect(model.Submit(bgr), &bgr_group), 0);
+  CHECK(bgr_group.count > 0);
+  CHECK(SameGroup(groups[0], bgr_group));
+  CHECK(SameGroup(groups[1], bgr_group));
+
+  RknnPool<RknnModel, Nv12Frame, DetectResultGroup> pool(model_path, 3, options, 3);
+  CHECK_EQ(pool.Init(cv::Size(width, height)), 0);
+  const int job_num = 6;
+  for (int i = 0; i < job_num; ++i) {
+    CHECK_EQ(pool.Put(frame), 0);
+  }
+  int results = 0;
+  DetectResultGroup group;
+  while (pool.Get(group) == 0) {
+    CHECK(SameGroup(group, bgr_group));
+    results++;
+  }
+  CHECK_EQ(results, job_num);
+  printf(
+    "nv12 %dx%d: model input as LetterBoxBuffer, %d detections as from BGR, %d pool results\n",
+    width, height, bgr_group.count, results);
+}
+
+// runs on 3 contexts with jitter, so the frames finish out of order
+static void CheckPoolResults(const std::string & model_path)
+{
+  setenv("RKNN_STUB_JITTER_US", "5000", 1);
+  RknnModelOptions options;
+  options.labels_path = "";
+  RknnPool<RknnModel, FrameJob, InferResult> pool(model_path, 6, options, 3);
+  cv::Mat frame = MakeFrame(1280, 720);
+  CHECK_EQ(pool.Init(frame.size()), 0);
+  cv::Mat original = frame.clone();
+
+  const int job_num = 24;
+  const long long failed_id = 1000 + 7;
+  int detections = -1;
+  long long expected_id = 1000;
+  InferResult result;
+  for (int i = 0; i < job_num; ++i) {
+    FrameJob job;
+    job.frame_id = 1000 + i;
+    // an empty frame fails alone and keeps its place
+    job.image = job.frame_id == failed_id ? cv::Mat() : frame;
+    CHECK_EQ(pool.Put(job), 0);
+  }
+  while (pool.Get(result) == 0) {
+    CHECK_EQ(result.frame_id, expected_id);
+    expected_id++;
+    CHECK(result.start_us <= result.submitted_us);
+    CHECK(result.submitted_us <= result.done_us);
+    if (result.frame_id == failed_id) {
+      CHECK_EQ(result.status, -1);
+      CHECK_EQ(result.group.count, 0);
+      continue;
+    }
+    CHECK_EQ(result.status, 0);
+    // the job image itself, shared and not drawn on
+    CHECK(result.image.data == frame.data);
+    if (detections < 0) {
+      detections = result.group.count;
+    }
+    CHECK_EQ(result.group.count, detections);
+  }
+  CHECK_EQ(expected_id, 1000 + job_num);
+  CHECK(detections > 0);
+  CHECK_EQ(memcmp(frame.data, original.data, frame.total() * frame.elemSize()), 0);
+  printf("%d pool results in frame order, %d detections each\n", job_num, detections);
+  setenv("RKNN_STUB_JITTER_US", "0", 1);
+}
+
+int main()
+{
+  setenv("RKNN_STUB_LATENCY_US", std::to_string(kLatencyUs).c_str(), 1);
+  setenv("RKNN_STUB_JITTER_US", "0", 1);
+  std::string model_path = WriteModelFile();
+
+  int detections = CheckBinds(model_path, OutputLayout::kNchw, IoMode::kCopy, "copy nchw");
+  CHECK(detections > 0);
+  CHECK_EQ(
+    CheckBinds(model_path, OutputLayout::kNchw, IoMode::kZeroCopy, "zero-copy nchw"), detections);
+  CHECK_EQ(
+    CheckBinds(model_path, OutputLayout::kNc1hwc2, IoMode::kCopy, "copy nc1hwc2"), detections);
+  CHECK_EQ(
+    CheckBinds(model_path, OutputLayout::kNc1hwc2, IoMode::kZeroCopy, "zero-copy nc1hwc2"),
+    detections);
+  CHECK_EQ(
+    CheckBinds(model_path, OutputLayout::kNhwc, IoMode::kZeroCopy, "zero-copy nhwc"), detections);
+  CheckOverlap(model_path);
+  CheckWarmupSize(model_path);
+  CheckNv12Input(model_path);
+  CheckPoolResults(model_path);
+
+  unlink(model_path.c_str());
+  return TestResult();
+}
@@ -0,0 +1,136 @@
+// The host stub of librknnrt behaves like the runtime where the pipeline depends on it: bad model
+// buffers are rejected, the attrs describe the YOLOv5 heads in every layout, runs take the
+// configured latency, non-blocking runs return at once and runs on one core queue up.
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <vector>
+
+#include "rknn_api.h"
+#include "test_utils.hpp"
+
+static const int kLatencyUs = 20000;
+
+static double NowMs()
+{
+  return std::chrono::duration<double, std::milli>(
+           std::chrono::steady_clock::now().time_since_epoch())
+    .count();
+}
+
+static void CheckInit()
+{
+  std::vector<uint8_t> model(100000, 1);
+  rknn_context ctx = 0;
+  CHECK_EQ(rknn_init(nullptr, model.data(), model.size(), 0, nullptr), RKNN_ERR_PARAM_INVALID);
+  CHECK_EQ(rknn_init(&ctx, nullptr, model.size(), 0, nullptr), RKNN_ERR_PARAM_INVALID);
+  CHECK_EQ(rknn_init(&ctx, model.data(), 0, 0, nullptr), RKNN_ERR_PARAM_INVALID);
+
+  // an unmapped range is an error code, not a fault
+  long page = sysconf(_SC_PAGESIZE);
+  void * unmapped = mmap(nullptr, page * 4, PROT_READ, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  CHECK(unmapped != MAP_FAILED);
+  munmap(unmapped, page * 4);
+  CHECK_EQ(rknn_init(&ctx, unmapped, page * 4, 0, nullptr), RKNN_ERR_MODEL_INVALID);
+  // so is one that runs past the end of a mapping
+  void * mapped = mmap(nullptr, page * 2, PROT_READ, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  munmap((uint8_t *)mapped + page, page);
+  CHECK_EQ(rknn_init(&ctx, mapped, page * 2, 0, nullptr), RKNN_ERR_MODEL_INVALID);
+  munmap(mapped, page);
+
+  CHECK_EQ(rknn_init(&ctx, model.data(), model.size(), 0, nullptr), RKNN_SUCC);
+  CHECK_EQ(rknn_destroy(ctx), RKNN_SUCC);
+}
+
+static void CheckAttrs(rknn_context ctx)
+{
+  rknn_input_output_num io_num;
+  CHECK_EQ(rknn_query(ctx, RKNN_QUERY_IN_OUT_NUM, &io_num, sizeof(io_num)), RKNN_SUCC);
+  CHECK_EQ(io_num.n_input, 1);
+  CHECK_EQ(io_num.n_output, 3);
+  for (uint32_t i = 0; i < io_num.n_output; ++i) {
+    int grid = 640 / (8 << i);
+    rknn_tensor_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.index = i;
+    CHECK_EQ(rknn_query(ctx, RKNN_QUERY_OUTPUT_ATTR, &attr, sizeof(attr)), RKNN_SUCC);
+    CHECK_EQ(attr.fmt, RKNN_TENSOR_NCHW);
+    CHECK_EQ(attr.dims[1], 255);
+    CHECK_EQ(attr.dims[2], grid);
+    CHECK_EQ(attr.n_elems, 255 * grid * grid);
+
+    CHECK_EQ(rknn_query(ctx, RKNN_QUERY_NATIVE_OUTPUT_ATTR, &attr, sizeof(attr)), RKNN_SUCC);
+    CHECK_EQ(attr.fmt, RKNN_TENSOR_NC1HWC2);
+    CHECK_EQ(attr.n_dims, 5);
+    CHECK_EQ(attr.dims[1], 16);
+    CHECK_EQ(attr.dims[4], 16);
+    CHECK_EQ(attr.n_elems, 256 * grid * grid);
+
+    CHECK_EQ(rknn_query(ctx, RKNN_QUERY_NATIVE_NHWC_OUTPUT_ATTR, &attr, sizeof(attr)), RKNN_SUCC);
+    CHECK_EQ(attr.fmt, RKNN_TENSOR_NHWC);
+    CHECK_EQ(attr.dims[3], 255);
+  }
+}
+
+static void CheckRuns(rknn_context ctx, rknn_context other)
+{
+  rknn_output outputs[3];
+  memset(outputs, 0, sizeof(outputs));
+  double start = NowMs();
+  CHECK_EQ(rknn_run(ctx, nullptr), RKNN_SUCC);
+  CHECK_EQ(rknn_outputs_get(ctx, 3, outputs, nullptr), RKNN_SUCC);
+  double blocking_ms = NowMs() - start;
+  CHECK(blocking_ms >= kLatencyUs / 1000.0);
+  CHECK_EQ(outputs[0].size, 255 * 80 * 80);
+  CHECK(outputs[0].buf != nullptr);
+  CHECK_EQ(rknn_outputs_release(ctx, 3, outputs), RKNN_SUCC);
+
+  // non-blocking runs return at once, two contexts on core 0 queue up, core 1 runs alongside
+  rknn_context ctx1 = 0;
+  CHECK_EQ(rknn_dup_context(&ctx, &ctx1), RKNN_SUCC);
+  CHECK_EQ(rknn_set_core_mask(ctx, RKNN_NPU_CORE_0), RKNN_SUCC);
+  CHECK_EQ(rknn_set_core_mask(ctx1, RKNN_NPU_CORE_0), RKNN_SUCC);
+  CHECK_EQ(rknn_set_core_mask(other, RKNN_NPU_CORE_1), RKNN_SUCC);
+  rknn_run_extend extend;
+  memset(&extend, 0, sizeof(extend));
+  extend.non_block = 1;
+  start = NowMs();
+  CHECK_EQ(rknn_run(ctx, &extend), RKNN_SUCC);
+  CHECK_EQ(rknn_run(ctx1, &extend), RKNN_SUCC);
+  CHECK_EQ(rknn_run(other, &extend), RKNN_SUCC);
+  double submit_ms = NowMs() - start;
+  CHECK_EQ(rknn_wait(other, nullptr), RKNN_SUCC);
+  double other_ms = NowMs() - start;
+  CHECK_EQ(rknn_wait(ctx, nullptr), RKNN_SUCC);
+  CHECK_EQ(rknn_wait(ctx1, nullptr), RKNN_SUCC);
+  double queued_ms = NowMs() - start;
+  printf(
+    "blocking run %.1f ms, 3 non-blocking submits %.2f ms, core 1 done after %.1f ms, two runs "
+    "on core 0 after %.1f ms\n",
+    blocking_ms, submit_ms, other_ms, queued_ms);
+  CHECK(submit_ms < kLatencyUs / 1000.0 / 2);
+  CHECK(other_ms < kLatencyUs / 1000.0 * 1.75);
+  CHECK(queued_ms >= kLatencyUs / 1000.0 * 2);
+  CHECK_EQ(rknn_destroy(ctx1), RKNN_SUCC);
+}
+
+int main()
+{
+  setenv("RKNN_STUB_LATENCY_US", "20000", 1);
+  setenv("RKNN_STUB_JITTER_US", "0", 1);
+  CheckInit();
+
+  std::vector<uint8_t> model(4096, 1);
+  rknn_context ctx = 0;
+  rknn_context other = 0;
+  CHECK_EQ(rknn_init(&ctx, model.data(), model.size(), 0, nullptr), RKNN_SUCC);
+  CHECK_EQ(rknn_init(&other, model.data(), model.size(), 0, nullptr), RKNN_SUCC);
+  CheckAttrs(ctx);
+  CheckRuns(ctx, other);
+  rknn_destroy(ctx);
+  rknn_destroy(other);
+  return det_rk3588::TestResult();
+}
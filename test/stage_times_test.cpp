@@ -0,0 +1,108 @@
+// What postprocess_benchmark reports: the median, p99 and mean of Summarize() on known samples,
+// and the stage times of PostProcessor::Run(), which are zero unless enabled, fit in the wall time
+// of the call when enabled and do not change the detections.
+#include <string.h>
+
+#include <vector>
+
+#include "benchmark/benchmark_utils.hpp"
+#include "postprocess.hpp"
+#include "synthetic_outputs.hpp"
+#include "test_utils.hpp"
+
+using namespace det_rk3588;
+
+static void CheckSummarize()
+{
+  TimingStats stats = Summarize(std::vector<double>());
+  CHECK(stats.median == 0.0 && stats.p99 == 0.0 && stats.mean == 0.0);
+
+  stats = Summarize(std::vector<double>{7.0});
+  CHECK(stats.median == 7.0 && stats.p99 == 7.0 && stats.mean == 7.0);
+
+  // 100 down to 1, unsorted on purpose
+  std::vector<double> samples;
+  for (int i = 100; i >= 1; --i) {
+    samples.push_back(i);
+  }
+  stats = Summarize(samples);
+  CHECK(stats.median == 50.5);
+  CHECK(stats.p99 == 99.0);
+  CHECK(stats.mean == 50.5);
+
+  // nearest rank: one outlier in 200 stays above p99, with 3 in 203 the 201st sample is p99
+  samples.assign(199, 1.0);
+  samples.push_back(1000.0);
+  stats = Summarize(samples);
+  CHECK(stats.median == 1.0);
+  CHECK(stats.p99 == 1.0);
+  samples.push_back(2.0);
+  samples.push_back(2000.0);
+  samples.push_back(3000.0);
+  stats = Summarize(samples);
+  CHECK(stats.median == 1.0);
+  CHECK(stats.p99 == 1000.0);
+}
+
+static bool SameStageTimes(const StageTimes & times, double value)
+{
+  return times.decode_us == value && times.sort_us == value && times.nms_us == value &&
+         times.map_us == value;
+}
+
+static void CheckStageTimes(int decode_threads)
+{
+  const int input_size = 640;
+  SyntheticOutputs outputs;
+  MakeSyntheticOutputs(input_size, 0.01f, 80, 640 * 7919 + 80, &outputs);
+  HeadConfig head;
+  CHECK_EQ(
+    LoadHeadConfig(
+      "", "", input_size, input_size, outputs.attrs, SyntheticOutputs::kHeadNum, &head),
+    0);
+  PostProcessor post_processor;
+  post_processor.SetDecodeThreads(decode_threads);
+  CHECK_EQ(
+    post_processor.Init(input_size, input_size, head, outputs.attrs, SyntheticOutputs::kHeadNum),
+    0);
+  BoxRect pads = {0, 0, (input_size - input_size * 1080 / 1920) / 2, 0};
+  float scale = (float)input_size / 1920;
+
+  // off by default
+  DetectResultGroup untimed;
+  CHECK_EQ(post_processor.Run(outputs.bufs, pads, scale, scale, &untimed), 0);
+  CHECK(untimed.count > 0);
+  CHECK(SameStageTimes(post_processor.GetStageTimes(), 0.0));
+
+  post_processor.EnableStageTimes(true);
+  DetectResultGroup timed;
+  for (int it = 0; it < 20; ++it) {
+    double start = NowUs();
+    CHECK_EQ(post_processor.Run(outputs.bufs, pads, scale, scale, &timed), 0);
+    double wall_us = NowUs() - start;
+    const StageTimes & times = post_processor.GetStageTimes();
+    CHECK(times.decode_us > 0.0);
+    CHECK(times.sort_us >= 0.0 && times.nms_us >= 0.0 && times.map_us >= 0.0);
+    CHECK(times.decode_us + times.sort_us + times.nms_us + times.map_us <= wall_us);
+    CHECK_EQ(timed.count, untimed.count);
+    CHECK(memcmp(timed.results, untimed.results, untimed.count * sizeof(DetectResult)) == 0);
+  }
+  const StageTimes & times = post_processor.GetStageTimes();
+  printf(
+    "decode threads %d, %d detections: decode %.1f us, sort %.1f us, nms %.1f us, map %.1f us\n",
+    decode_threads, timed.count, times.decode_us, times.sort_us, times.nms_us, times.map_us);
+
+  // disabling clears the times and Run() leaves them cleared
+  post_processor.EnableStageTimes(false);
+  CHECK(SameStageTimes(post_processor.GetStageTimes(), 0.0));
+  CHECK_EQ(post_processor.Run(outputs.bufs, pads, scale, scale, &timed), 0);
+  CHECK(SameStageTimes(post_processor.GetStageTimes(), 0.0));
+}
+
+int main()
+{
+  CheckSummarize();
+  CheckStageTimes(1);
+  CheckStageTimes(3);
+  return TestResult();
+}
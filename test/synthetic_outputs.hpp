@@ -0,0 +1,137 @@
+#ifndef DET_RK3588__SYNTHETIC_OUTPUTS_HPP_
+#define DET_RK3588__SYNTHETIC_OUTPUTS_HPP_
+
+#include <stdint.h>
+#include <string.h>
+
+#include <algorithm>
+#include <random>
+#include <vector>
+
+#include "postprocess.hpp"
+
+namespace det_rk3588
+{
+
+// int8 NCHW YOLOv5 heads of strides 8, 16, 32, shared by postprocess_benchmark and the tests
+struct SyntheticOutputs
+{
+  static constexpr int kHeadNum = 3;
+  static constexpr int kZp = -128;
+
+  rknn_tensor_attr attrs[kHeadNum];
+  std::vector<int8_t> data[kHeadNum];
+
+  int8_t * bufs[kHeadNum];
+};
+
+inline int8_t QuantizeSynthetic(float value)
+{
+  int q = (int)(value * 255.f + 0.5f) + SyntheticOutputs::kZp;
+  return (int8_t)std::max(-128, std::min(127, q));
+}
+
+// density is the fraction of cell anchors whose objectness and class pass BOX_THRESH
+inline void MakeSyntheticOutputs(
+  int input_size, float density, int class_num, unsigned seed, SyntheticOutputs * outputs)
+{
+  std::mt19937 rng(seed);
+  std::uniform_real_distribution<float> unit(0.f, 1.f);
+  std::uniform_real_distribution<float> low(0.f, BOX_THRESH * 0.8f);
+  std::uniform_real_distribution<float> high(BOX_THRESH + 0.05f, 1.f);
+  std::uniform_int_distribution<int> cls(0, class_num - 1);
+  int prop_box_size = 5 + class_num;
+
+  memset(outputs->attrs, 0, sizeof(outputs->attrs));
+  for (int i = 0; i < SyntheticOutputs::kHeadNum; ++i) {
+    int grid = input_size / (8 << i);
+    int grid_len = grid * grid;
+    rknn_tensor_attr & attr = outputs->attrs[i];
+    attr.index = i;
+    attr.n_dims = 4;
+    attr.dims[0] = 1;
+    attr.dims[1] = OBJ_ANCHOR_NUM * prop_box_size;
+    attr.dims[2] = grid;
+    attr.dims[3] = grid;
+    attr.n_elems = OBJ_ANCHOR_NUM * prop_box_size * grid_len;
+    attr.size = attr.n_elems;
+    attr.fmt = RKNN_TENSOR_NCHW;
+    attr.type = RKNN_TENSOR_INT8;
+    attr.qnt_type = RKNN_TENSOR_QNT_AFFINE_ASYMMETRIC;
+    attr.zp = SyntheticOutputs::kZp;
+    attr.scale = 1.f / 255.f;
+
+    std::vector<int8_t> & data = outputs->data[i];
+    data.resize(attr.n_elems);
+    for (int a = 0; a < OBJ_ANCHOR_NUM; ++a) {
+      int8_t * anchor = data.data() + a * prop_box_size * grid_len;
+      for (int cell = 0; cell < grid_len; ++cell) {
+        bool positive = unit(rng) < density;
+        int best = cls(rng);
+        for (int k = 0; k < 4; ++k) {
+          anchor[k * grid_len + cell] = QuantizeSynthetic(unit(rng));
+        }
+        anchor[4 * grid_len + cell] = QuantizeSynthetic(positive ? high(rng) : low(rng));
+        for (int k = 0; k < class_num; ++k) {
+          float prob = positive && k == best ? high(rng) : low(rng);
+          anchor[(5 + k) * grid_len + cell] = QuantizeSynthetic(prob);
+        }
+      }
+    }
+    outputs->bufs[i] = data.data();
+  }
+}
+
+// the same tensors in the native NHWC layout
+inline void ToNhwc(const SyntheticOutputs & src, SyntheticOutputs * dst)
+{
+  for (int i = 0; i < SyntheticOutputs::kHeadNum; ++i) {
+    const rknn_tensor_attr & attr = src.attrs[i];
+    int channel = attr.dims[1];
+    int cells = attr.dims[2] * attr.dims[3];
+    dst->attrs[i] = attr;
+    dst->attrs[i].fmt = RKNN_TENSOR_NHWC;
+    dst->attrs[i].dims[1] = attr.dims[2];
+    dst->attrs[i].dims[2] = attr.dims[3];
+    dst->attrs[i].dims[3] = channel;
+    dst->data[i].resize(src.data[i].size());
+    for (int k = 0; k < channel; ++k) {
+      for (int cell = 0; cell < cells; ++cell) {
+        dst->data[i][cell * channel + k] = src.data[i][k * cells + cell];
+      }
+    }
+    dst->bufs[i] = dst->data[i].data();
+  }
+}
+
+// the same tensors in the native NC1HWC2 layout, the padding channels of the last C2 block are
+// filled with 127, which passes every threshold if a decoder ever reads it
+inline void ToNc1hwc2(const SyntheticOutputs & src, int c2, SyntheticOutputs * dst)
+{
+  for (int i = 0; i < SyntheticOutputs::kHeadNum; ++i) {
+    const rknn_tensor_attr & attr = src.attrs[i];
+    int channel = attr.dims[1];
+    int c1 = (channel + c2 - 1) / c2;
+    int cells = attr.dims[2] * attr.dims[3];
+    dst->attrs[i] = attr;
+    dst->attrs[i].fmt = RKNN_TENSOR_NC1HWC2;
+    dst->attrs[i].n_dims = 5;
+    dst->attrs[i].dims[1] = c1;
+    dst->attrs[i].dims[2] = attr.dims[2];
+    dst->attrs[i].dims[3] = attr.dims[3];
+    dst->attrs[i].dims[4] = c2;
+    dst->attrs[i].n_elems = c1 * cells * c2;
+    dst->attrs[i].size = dst->attrs[i].n_elems;
+    dst->data[i].assign(c1 * cells * c2, 127);
+    for (int k = 0; k < channel; ++k) {
+      for (int cell = 0; cell < cells; ++cell) {
+        dst->data[i][(k / c2) * cells * c2 + cell * c2 + k % c2] = src.data[i][k * cells + cell];
+      }
+    }
+    dst->bufs[i] = dst->data[i].data();
+  }
+}
+
+}  // namespace det_rk3588
+
+#endif  // DET_RK3588__SYNTHETIC_OUTPUTS_HPP_
@@ -0,0 +1,49 @@
+#ifndef DET_RK3588__TEST_UTILS_HPP_
+#define DET_RK3588__TEST_UTILS_HPP_
+
+#include <stdio.h>
+
+namespace det_rk3588
+{
+
+// failed checks of the running test
+inline int & TestFailures()
+{
+  static int failures = 0;
+  return failures;
+}
+
+// exit code of a test main
+inline int TestResult()
+{
+  if (TestFailures() > 0) {
+    printf("%d checks failed\n", TestFailures());
+    return 1;
+  }
+  printf("all checks passed\n");
+  return 0;
+}
+
+}  // namespace det_rk3588
+
+#define CHECK(cond)                                                      \
+  do {                                                                   \
+    if (!(cond)) {                                                       \
+      printf("%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond);   \
+      ++::det_rk3588::TestFailures();                                    \
+    }                                                                    \
+  } while (0)
+
+#define CHECK_EQ(a, b)                                                                         \
+  do {                                                                                         \
+    long long check_a = (long long)(a);                                                        \
+    long long check_b = (long long)(b);                                                        \
+    if (check_a != check_b) {                                                                  \
+      printf(                                                                                  \
+        "%s:%d: check failed: %s == %s (%lld vs %lld)\n", __FILE__, __LINE__, #a, #b, check_a, \
+        check_b);                                                                              \
+      ++::det_rk3588::TestFailures();                                                          \
+    }                                                                                          \
+  } while (0)
+
+#endif  // DET_RK3588__TEST_UTILS_HPP_
@@ -0,0 +1,187 @@
+// MakeTiles() coverage and TileMerger: duplicates from overlapping tiles are removed, objects cut
+// by a seam come back as one box, and distinct objects or classes next to a seam stay apart. In a
+// busy frame the pieces are merged before the result is cut to OBJ_NUMB_MAX_SIZE.
+#include <string.h>
+
+#include <vector>
+
+#include "test_utils.hpp"
+#include "tiling.hpp"
+
+using namespace det_rk3588;
+
+static const cv::Size kFrameSize(1920, 1080);
+static const cv::Size kTileSize(640, 640);
+static const int kOverlap = 64;
+
+static void CheckTiles()
+{
+  std::vector<cv::Rect> tiles;
+  CHECK_EQ(MakeTiles(kFrameSize, kTileSize, kOverlap, &tiles), 0);
+  // 4 columns and 2 rows
+  CHECK_EQ(tiles.size(), 8);
+  std::vector<int> covered(kFrameSize.area(), 0);
+  for (const cv::Rect & rect : tiles) {
+    CHECK(rect.size() == kTileSize);
+    CHECK(rect.x >= 0 && rect.y >= 0);
+    CHECK(rect.x + rect.width <= kFrameSize.width && rect.y + rect.height <= kFrameSize.height);
+    for (int y = rect.y; y < rect.y + rect.height; ++y) {
+      for (int x = rect.x; x < rect.x + rect.width; ++x) {
+        covered[y * kFrameSize.width + x] = 1;
+      }
+    }
+  }
+  int uncovered = 0;
+  for (int c : covered) {
+    uncovered += c == 0;
+  }
+  CHECK_EQ(uncovered, 0);
+  // neighbours in a row share at least the overlap
+  for (size_t i = 1; i < 4; ++i) {
+    CHECK(tiles[i - 1].x + tiles[i - 1].width - tiles[i].x >= kOverlap);
+  }
+  CHECK_EQ(MakeTiles(kFrameSize, kTileSize, kTileSize.width, &tiles), -1);
+}
+
+static void AddBox(TileResult * result, int class_id, float prop, BoxRect frame_box)
+{
+  DetectResult & detection = result->group.results[result->group.count++];
+  memset(&detection, 0, sizeof(DetectResult));
+  detection.class_id = class_id;
+  detection.prop = prop;
+  // tile coordinates, clamped to the tile like PostProcessor does
+  detection.box.left = std::max(frame_box.left - result->rect.x, 0);
+  detection.box.right = std::min(frame_box.right - result->rect.x, result->rect.width - 1);
+  detection.box.top = std::max(frame_box.top - result->rect.y, 0);
+  detection.box.bottom = std::min(frame_box.bottom - result->rect.y, result->rect.height - 1);
+}
+
+struct Frame
+{
+  std::vector<TileResult> results;
+
+  Frame()
+  {
+    std::vector<cv::Rect> tiles;
+    MakeTiles(kFrameSize, kTileSize, kOverlap, &tiles);
+    results.resize(tiles.size());
+    for (size_t i = 0; i < tiles.size(); ++i) {
+      results[i].frame_id = 5000000000LL;
+      results[i].tile_id = i;
+      results[i].rect = tiles[i];
+      results[i].group.count = 0;
+    }
+  }
+
+  // the part of an object each tile would see, every tile gets a slightly different score
+  void AddObject(int class_id, BoxRect frame_box)
+  {
+    for (size_t i = 0; i < results.size(); ++i) {
+      const cv::Rect & rect = results[i].rect;
+      if (
+        frame_box.right < rect.x || frame_box.left >= rect.x + rect.width ||
+        frame_box.bottom < rect.y || frame_box.top >= rect.y + rect.height) {
+        continue;
+      }
+      AddBox(&results[i], class_id, 0.9f - 0.01f * i, frame_box);
+    }
+  }
+};
+
+static int Merge(TileMerger * merger, Frame & frame, DetectResultGroup * merged)
+{
+  CHECK_EQ(
+    merger->Merge(frame.results.data(), frame.results.size(), kFrameSize, NMS_THRESH, merged), 0);
+  return merged->count;
+}
+
+static bool SameBox(const BoxRect & a, const BoxRect & b)
+{
+  return a.left == b.left && a.right == b.right && a.top == b.top && a.bottom == b.bottom;
+}
+
+// more pieces than OBJ_NUMB_MAX_SIZE: 34 objects cut by the first seam, then 40 small ones seen
+// by the last tile only with a lower score
+static void CheckBusyFrame(TileMerger * merger)
+{
+  const int wide_num = 34;
+  Frame busy;
+  for (int i = 0; i < wide_num; ++i) {
+    busy.AddObject(0, BoxRect{250, 850, i * 12, i * 12 + 9});
+  }
+  for (int i = 0; i < 40; ++i) {
+    int x = 1500 + (i % 20) * 12;
+    int y = 700 + (i / 20) * 12;
+    busy.AddObject(0, BoxRect{x, x + 7, y, y + 7});
+  }
+  CHECK_EQ(busy.results[0].group.count + busy.results[1].group.count, 2 * wide_num);
+  DetectResultGroup merged;
+  CHECK_EQ(Merge(merger, busy, &merged), OBJ_NUMB_MAX_SIZE);
+  int whole = 0;
+  for (int i = 0; i < wide_num; ++i) {
+    whole += SameBox(merged.results[i].box, BoxRect{250, 850, i * 12, i * 12 + 9});
+  }
+  CHECK_EQ(whole, wide_num);
+  CHECK_EQ(merged.results[wide_num].box.left, 1500);
+}
+
+int main()
+{
+  CheckTiles();
+  std::vector<cv::Rect> tiles;
+  MakeTiles(kFrameSize, kTileSize, kOverlap, &tiles);
+  printf("tiles: %zu, first seam at x %d\n", tiles.size(), tiles[1].x);
+
+  TileMerger merger;
+  DetectResultGroup merged;
+
+  // inside one tile only
+  Frame single;
+  single.AddObject(0, BoxRect{100, 300, 100, 300});
+  CHECK_EQ(Merge(&merger, single, &merged), 1);
+  CHECK(SameBox(merged.results[0].box, BoxRect{100, 300, 100, 300}));
+
+  // a wide object across the first vertical seam: two pieces, IoU far below NMS_THRESH
+  BoxRect wide = {300, 1000, 100, 300};
+  Frame cut;
+  cut.AddObject(2, wide);
+  CHECK_EQ(cut.results[0].group.count + cut.results[1].group.count, 2);
+  CHECK_EQ(Merge(&merger, cut, &merged), 1);
+  CHECK_EQ(merged.results[0].class_id, 2);
+  CHECK(SameBox(merged.results[0].box, wide));
+
+  // a small object inside the overlap band, seen whole by tile 0 and cut by tile 1
+  BoxRect small = {560, 620, 400, 460};
+  Frame band;
+  band.AddObject(1, small);
+  CHECK_EQ(Merge(&merger, band, &merged), 1);
+  CHECK(SameBox(merged.results[0].box, small));
+
+  // a large object on the corner of four tiles
+  BoxRect corner = {400, 900, 300, 800};
+  Frame four;
+  four.AddObject(3, corner);
+  CHECK_EQ(Merge(&merger, four, &merged), 1);
+  CHECK(SameBox(merged.results[0].box, corner));
+
+  // the same wide object with a different class next to it stays two objects, as do two
+  // objects of one class meeting at the seam with no vertical agreement
+  Frame apart;
+  apart.AddObject(2, wide);
+  apart.AddObject(4, BoxRect{600, 700, 120, 280});
+  apart.AddObject(5, BoxRect{400, 630, 500, 560});
+  apart.AddObject(5, BoxRect{620, 800, 570, 620});
+  CHECK_EQ(Merge(&merger, apart, &merged), 4);
+
+  CheckBusyFrame(&merger);
+
+  // another frame size
+  Frame again;
+  again.AddObject(2, wide);
+  CHECK_EQ(merger.Merge(again.results.data(), 2, cv::Size(1216, 640), NMS_THRESH, &merged), 0);
+  CHECK_EQ(merged.count, 1);
+  printf(
+    "merged wide object: %d %d %d %d\n", merged.results[0].box.left, merged.results[0].box.right,
+    merged.results[0].box.top, merged.results[0].box.bottom);
+  return TestResult();
+}